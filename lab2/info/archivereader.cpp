@@ -0,0 +1,410 @@
+#include "archivereader.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSet>
+#include <QtEndian>
+#include <algorithm>
+#include <memory>
+#ifdef HAVE_SYSTEM_ZLIB
+#include <zlib.h>
+#else
+#include <QtZlib/zlib.h>
+#endif
+
+namespace {
+
+const quint32 kZipLocalHeader = 0x04034b50;
+const quint32 kZipCentralHeader = 0x02014b50;
+const quint32 kZipEndOfDirectory = 0x06054b50;
+const quint32 kZip64EndOfDirectory = 0x06064b50;
+const quint32 kZip64Locator = 0x07064b50;
+const qint64 kZipMaxComment = 0xFFFF;
+
+const qint64 kTarBlock = 512;
+const qint64 kInflateChunk = 16 * 1024;   // порция сжатых данных за один вызов inflate
+const qint64 kFirstProbe = 4 * 1024;      // первая попытка разобрать заголовок
+const qint64 kMaxProbe = 1 << 20;         // дальше заголовок не ищем
+
+template <typename T>
+T le(const uchar *p)
+{
+    return qFromLittleEndian<T>(p);
+}
+
+bool isImageName(const QString &name)
+{
+    static const QSet<QString> suffixes = []() {
+        QSet<QString> s;
+        for (const QString &filter : supportedImageNameFilters()) s.insert(filter.mid(2));  // "*.jpg" -> "jpg"
+        return s;
+    }();
+    int dot = name.lastIndexOf('.');
+    return dot >= 0 && suffixes.contains(name.mid(dot + 1).toLower());
+}
+
+// Число из заголовка TAR: восьмеричное ASCII или base-256 (GNU) для больших размеров
+qint64 parseTarNumber(const uchar *p, int length)
+{
+    if (p[0] & 0x80) {
+        qint64 value = p[0] & 0x7F;
+        for (int i = 1; i < length; ++i) value = (value << 8) | p[i];
+        return value;
+    }
+    qint64 value = 0;
+    for (int i = 0; i < length; ++i) {
+        if (p[i] == ' ' || p[i] == 0) {
+            if (value > 0) break;
+            continue;
+        }
+        if (p[i] < '0' || p[i] > '7') return -1;
+        value = value * 8 + (p[i] - '0');
+    }
+    return value;
+}
+
+QString tarString(const uchar *p, int length)
+{
+    int n = 0;
+    while (n < length && p[n]) ++n;
+    return QString::fromUtf8(reinterpret_cast<const char *>(p), n);
+}
+
+bool isTarHeader(const uchar *h)
+{
+    // Контрольная сумма считается с пробелами вместо поля самой суммы
+    qint64 stored = parseTarNumber(h + 148, 8);
+    qint64 sum = 0;
+    for (int i = 0; i < kTarBlock; ++i) sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    return stored == sum;
+}
+
+// Значение "path" из расширенного заголовка pax ("<длина> ключ=значение\n")
+QString paxPath(const QByteArray &records)
+{
+    int pos = 0;
+    while (pos < records.size()) {
+        int space = records.indexOf(' ', pos);
+        if (space < 0) break;
+        int length = records.mid(pos, space - pos).toInt();
+        if (length <= 0 || pos + length > records.size()) break;
+        QByteArray record = records.mid(space + 1, pos + length - space - 2);  // без '\n'
+        if (record.startsWith("path=")) return QString::fromUtf8(record.mid(5));
+        pos += length;
+    }
+    return QString();
+}
+
+}
+
+QStringList archiveNameFilters()
+{
+    return {"*.zip", "*.tar"};
+}
+
+bool isArchiveFile(const QString &filePath)
+{
+    return filePath.endsWith(".zip", Qt::CaseInsensitive) || filePath.endsWith(".tar", Qt::CaseInsensitive);
+}
+
+QString archiveMemberPath(const QString &archivePath, const QString &memberName)
+{
+    return archivePath + "!/" + memberName;
+}
+
+bool splitArchivePath(const QString &path, QString *archivePath, QString *memberName)
+{
+    int from = 0;
+    while (true) {
+        int mark = path.indexOf("!/", from);
+        if (mark < 0) return false;
+        QString archive = path.left(mark);
+        if (isArchiveFile(archive)) {
+            if (archivePath) *archivePath = archive;
+            if (memberName) *memberName = path.mid(mark + 2);
+            return true;
+        }
+        from = mark + 2;
+    }
+}
+
+ArchiveReader::ArchiveReader(const QString &archivePath)
+    : view(archivePath)
+{
+    if (!view.isOpen()) return;
+    if (archivePath.endsWith(".zip", Qt::CaseInsensitive)) {
+        if (readZipDirectory()) archiveType = Zip;
+    } else if (readTarHeaders()) {
+        archiveType = Tar;
+    }
+    if (archiveType == None) entries.clear();
+}
+
+int ArchiveReader::indexOf(const QString &memberName) const
+{
+    if (nameIndex.isEmpty() && !entries.isEmpty()) {
+        nameIndex.reserve(entries.size());
+        for (int i = 0; i < entries.size(); ++i) nameIndex.insert(entries[i].name, i);
+    }
+    return nameIndex.value(memberName, -1);
+}
+
+bool ArchiveReader::readZipDirectory()
+{
+    // Конец центрального каталога - в последних 22 + 65535 байтах (после него может идти комментарий)
+    qint64 tailLength = qMin(view.size(), 22 + kZipMaxComment);
+    qint64 tailOffset = view.size() - tailLength;
+    const uchar *tail = view.data(tailOffset, tailLength);
+    if (!tail || tailLength < 22) return false;
+
+    qint64 eocd = -1;
+    for (qint64 i = tailLength - 22; i >= 0; --i) {
+        if (le<quint32>(tail + i) == kZipEndOfDirectory) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) return false;
+
+    quint64 count = le<quint16>(tail + eocd + 10);
+    quint64 directorySize = le<quint32>(tail + eocd + 12);
+    quint64 directoryOffset = le<quint32>(tail + eocd + 16);
+    qint64 eocdOffset = tailOffset + eocd;
+
+    if (count == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        const uchar *locator = eocdOffset >= 20 ? view.data(eocdOffset - 20, 20) : nullptr;
+        if (!locator || le<quint32>(locator) != kZip64Locator) return false;
+        qint64 zip64Offset = static_cast<qint64>(le<quint64>(locator + 8));
+        const uchar *zip64 = view.data(zip64Offset, 56);
+        if (!zip64 || le<quint32>(zip64) != kZip64EndOfDirectory) return false;
+        count = le<quint64>(zip64 + 32);
+        directorySize = le<quint64>(zip64 + 40);
+        directoryOffset = le<quint64>(zip64 + 48);
+    }
+
+    const uchar *dir = view.data(static_cast<qint64>(directoryOffset), static_cast<qint64>(directorySize));
+    if (!dir) return false;
+
+    quint64 pos = 0;
+    for (quint64 n = 0; n < count; ++n) {
+        if (pos + 46 > directorySize || le<quint32>(dir + pos) != kZipCentralHeader) return false;
+        const uchar *h = dir + pos;
+        quint16 flags = le<quint16>(h + 8);
+        quint16 method = le<quint16>(h + 10);
+        quint64 compressed = le<quint32>(h + 20);
+        quint64 size = le<quint32>(h + 24);
+        quint16 nameLength = le<quint16>(h + 28);
+        quint16 extraLength = le<quint16>(h + 30);
+        quint16 commentLength = le<quint16>(h + 32);
+        quint64 localOffset = le<quint32>(h + 42);
+        if (pos + 46 + nameLength + extraLength + commentLength > directorySize) return false;
+
+        // В ZIP64 настоящие значения лежат в дополнительном поле 0x0001 - только те, что равны 0xFFFFFFFF
+        const uchar *extra = h + 46 + nameLength;
+        for (int e = 0; e + 4 <= extraLength;) {
+            quint16 id = le<quint16>(extra + e);
+            quint16 length = le<quint16>(extra + e + 2);
+            if (id == 0x0001) {
+                const uchar *field = extra + e + 4;
+                const uchar *fieldEnd = field + length;
+                if (size == 0xFFFFFFFF && field + 8 <= fieldEnd) { size = le<quint64>(field); field += 8; }
+                if (compressed == 0xFFFFFFFF && field + 8 <= fieldEnd) { compressed = le<quint64>(field); field += 8; }
+                if (localOffset == 0xFFFFFFFF && field + 8 <= fieldEnd) localOffset = le<quint64>(field);
+                break;
+            }
+            e += 4 + length;
+        }
+
+        const char *rawName = reinterpret_cast<const char *>(h + 46);
+        // Бит 11 - имя в UTF-8; иначе кодировка не определена, берём Latin-1
+        QString name = (flags & 0x0800) ? QString::fromUtf8(rawName, nameLength)
+                                        : QString::fromLatin1(rawName, nameLength);
+        bool encrypted = flags & 0x0001;
+        if (!encrypted && !name.endsWith('/')) {
+            ArchiveMember member;
+            member.name = name;
+            member.size = static_cast<qint64>(size);
+            member.compressedSize = static_cast<qint64>(compressed);
+            member.offset = static_cast<qint64>(localOffset);
+            member.method = method;
+            entries.append(member);
+        }
+        pos += 46 + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+bool ArchiveReader::readTarHeaders()
+{
+    QString longName;  // из записи GNU 'L' или pax 'x' - относится к следующему члену
+    qint64 offset = 0;
+    while (offset + kTarBlock <= view.size()) {
+        const uchar *h = view.data(offset, kTarBlock);
+        if (!h) return false;
+        if (std::all_of(h, h + kTarBlock, [](uchar c) { return c == 0; })) break;  // конец архива
+        if (!isTarHeader(h)) return offset > 0;
+
+        qint64 size = parseTarNumber(h + 124, 12);
+        if (size < 0) return offset > 0;
+        char type = static_cast<char>(h[156]);
+        QString name = tarString(h, 100);
+        if (std::equal(h + 257, h + 262, "ustar")) {
+            QString prefix = tarString(h + 345, 155);
+            if (!prefix.isEmpty()) name = prefix + "/" + name;
+        }
+        qint64 dataOffset = offset + kTarBlock;
+
+        if (type == 'L' || type == 'x') {
+            const uchar *data = view.data(dataOffset, size);
+            if (!data) return false;
+            QByteArray bytes(reinterpret_cast<const char *>(data), static_cast<int>(size));
+            QString path = type == 'L' ? QString::fromUtf8(bytes.constData()) : paxPath(bytes);
+            if (!path.isEmpty()) longName = path;
+        } else {
+            if (type == '0' || type == '\0' || type == '7') {
+                ArchiveMember member;
+                member.name = longName.isEmpty() ? name : longName;
+                member.size = size;
+                member.compressedSize = size;
+                member.offset = dataOffset;
+                entries.append(member);
+            }
+            longName.clear();
+        }
+        offset = dataOffset + ((size + kTarBlock - 1) / kTarBlock) * kTarBlock;
+    }
+    return true;
+}
+
+qint64 ArchiveReader::zipDataOffset(const ArchiveMember &member)
+{
+    // Длина имени и доп. поля в локальном заголовке может отличаться от центрального каталога
+    const uchar *h = view.data(member.offset, 30);
+    if (!h || le<quint32>(h) != kZipLocalHeader) return -1;
+    return member.offset + 30 + le<quint16>(h + 26) + le<quint16>(h + 28);
+}
+
+QByteArray ArchiveReader::readHead(const ArchiveMember &member, qint64 length, qint64 *consumed)
+{
+    if (consumed) *consumed = 0;
+    length = qMin(length, member.size);
+    if (length <= 0) return QByteArray();
+
+    qint64 dataOffset = archiveType == Zip ? zipDataOffset(member) : member.offset;
+    if (dataOffset < 0) return QByteArray();
+
+    if (member.method == 0) {
+        const uchar *data = view.data(dataOffset, length);
+        if (!data) return QByteArray();
+        if (consumed) *consumed = length;
+        return QByteArray(reinterpret_cast<const char *>(data), static_cast<int>(length));
+    }
+    if (member.method != 8) return QByteArray();
+
+    // Сырой deflate без заголовка zlib; останавливаемся, как только набрали length байт
+    z_stream zs = {};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) return QByteArray();
+
+    QByteArray out(static_cast<int>(length), Qt::Uninitialized);
+    zs.next_out = reinterpret_cast<Bytef *>(out.data());
+    zs.avail_out = static_cast<uInt>(length);
+
+    qint64 offset = dataOffset;
+    qint64 remaining = member.compressedSize;
+    while (zs.avail_out > 0 && remaining > 0) {
+        qint64 chunk = qMin(kInflateChunk, remaining);
+        const uchar *in = view.data(offset, chunk);
+        if (!in) break;
+        zs.next_in = const_cast<Bytef *>(in);
+        zs.avail_in = static_cast<uInt>(chunk);
+
+        int rc = inflate(&zs, Z_NO_FLUSH);
+        qint64 used = chunk - zs.avail_in;
+        offset += used;
+        remaining -= used;
+        if (rc == Z_STREAM_END) break;
+        if (rc != Z_OK || used == 0) break;  // повреждённые данные или нет продвижения
+    }
+
+    if (consumed) *consumed = offset - dataOffset;
+    out.resize(static_cast<int>(length - zs.avail_out));
+    inflateEnd(&zs);
+    return out;
+}
+
+ImageInfo getArchiveMemberInfo(ArchiveReader &reader, const ArchiveMember &member, StageTimings *timings)
+{
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    QElapsedTimer readTimer;
+
+    ImageInfo info;
+    qint64 want = qMin(kFirstProbe, member.size);
+    qint64 consumed = 0;
+    while (true) {
+        readTimer.start();
+        QByteArray head = reader.readHead(member, want, &consumed);
+        t[ScanStage::Open] += readTimer.nsecsElapsed();
+        if (getImageInfoFromBytes(head, member.size, info, &t)) break;
+        if (head.size() < want || want >= qMin(member.size, kMaxProbe)) break;
+        want = qMin(want * 4, qMin(member.size, kMaxProbe));
+    }
+
+    info.fileName = member.name.mid(member.name.lastIndexOf('/') + 1);
+    info.fileSize = member.size;
+    info.headerBytesRead = consumed;
+    return info;
+}
+
+ImageInfo getArchiveMemberInfo(const QString &virtualPath, StageTimings *timings)
+{
+    QString archivePath;
+    QString memberName;
+    ImageInfo info;
+    info.fileName = virtualPath.mid(virtualPath.lastIndexOf('/') + 1);
+    if (!splitArchivePath(virtualPath, &archivePath, &memberName)) return info;
+
+    // Члены одного архива обычно запрашиваются подряд: оглавление разбираем один раз на поток,
+    // пока архив не сменился и не изменился на диске
+    struct CachedReader {
+        QString path;
+        qint64 size = -1;
+        QDateTime modified;
+        std::unique_ptr<ArchiveReader> reader;
+    };
+    thread_local CachedReader cached;
+    QFileInfo fi(archivePath);
+    if (!cached.reader || cached.path != archivePath || cached.size != fi.size()
+        || cached.modified != fi.lastModified()) {
+        cached.reader = std::make_unique<ArchiveReader>(archivePath);
+        cached.path = archivePath;
+        cached.size = fi.size();
+        cached.modified = fi.lastModified();
+    }
+
+    ArchiveReader &reader = *cached.reader;
+    int index = reader.indexOf(memberName);
+    if (index < 0) return info;
+    return getArchiveMemberInfo(reader, reader.members()[index], timings);
+}
+
+int scanArchiveImages(const QString &archivePath, const ArchiveImageCallback &callback)
+{
+    QElapsedTimer openTimer;
+    openTimer.start();
+    ArchiveReader reader(archivePath);
+    if (!reader.isOpen()) return -1;
+    qint64 openNs = openTimer.nsecsElapsed();
+
+    int found = 0;
+    for (const ArchiveMember &member : reader.members()) {
+        if (!isImageName(member.name)) continue;
+        StageTimings timings;
+        // Чтение оглавления относим к первому изображению архива
+        if (found == 0) timings[ScanStage::Open] = openNs;
+        ImageInfo info = getArchiveMemberInfo(reader, member, &timings);
+        callback(archiveMemberPath(archivePath, member.name), info, timings);
+        ++found;
+    }
+    return found;
+}
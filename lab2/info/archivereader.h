@@ -0,0 +1,67 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <functional>
+#include "fileview.h"
+#include "imageinfo.h"
+
+// Изображения внутри архивов адресуются виртуальным путём "архив!/имя/внутри/архива"
+
+QStringList archiveNameFilters();
+bool isArchiveFile(const QString &filePath);
+QString archiveMemberPath(const QString &archivePath, const QString &memberName);
+// true, если путь указывает внутрь архива; archivePath и memberName можно не передавать
+bool splitArchivePath(const QString &path, QString *archivePath = nullptr, QString *memberName = nullptr);
+
+// Обычный файл внутри архива
+struct ArchiveMember {
+    QString name;              // путь внутри архива
+    qint64 size = 0;           // после распаковки
+    qint64 compressedSize = 0;
+    qint64 offset = 0;         // ZIP - локальный заголовок, TAR - начало данных
+    quint16 method = 0;        // 0 - без сжатия, 8 - deflate
+};
+
+// Оглавление ZIP (по центральному каталогу) или TAR (ustar, GNU, pax) без распаковки.
+// Содержимое членов читается через FileView только в нужном объёме.
+class ArchiveReader {
+public:
+    enum Type { None, Zip, Tar };
+
+    explicit ArchiveReader(const QString &archivePath);
+
+    bool isOpen() const { return archiveType != None; }
+    Type type() const { return archiveType; }
+    const QVector<ArchiveMember> &members() const { return entries; }
+    int indexOf(const QString &memberName) const;
+
+    // Первые length байт распакованного члена (меньше - если член короче или данные повреждены).
+    // deflate распаковывается только до нужной длины; consumed - сколько байт архива прочитано
+    QByteArray readHead(const ArchiveMember &member, qint64 length, qint64 *consumed = nullptr);
+
+private:
+    bool readZipDirectory();
+    bool readTarHeaders();
+    qint64 zipDataOffset(const ArchiveMember &member);
+
+    FileView view;
+    Type archiveType = None;
+    QVector<ArchiveMember> entries;
+    mutable QHash<QString, int> nameIndex;   // имя -> номер в entries, строится при первом поиске
+};
+
+// Разбор одного члена: начало распаковывается порциями, пока заголовок изображения не разберётся
+ImageInfo getArchiveMemberInfo(ArchiveReader &reader, const ArchiveMember &member, StageTimings *timings = nullptr);
+ImageInfo getArchiveMemberInfo(const QString &virtualPath, StageTimings *timings = nullptr);
+
+// Разбирает все изображения архива, открывая его один раз.
+// Возвращает число найденных изображений или -1, если файл не архив
+using ArchiveImageCallback = std::function<void(const QString &virtualPath, ImageInfo &info, StageTimings &timings)>;
+int scanArchiveImages(const QString &archivePath, const ArchiveImageCallback &callback);
+
+#endif // ARCHIVEREADER_H
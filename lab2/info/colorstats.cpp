@@ -0,0 +1,135 @@
+#include "colorstats.h"
+#include <QImage>
+#include <QImageReader>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+const int kBinBits = 3;                         // бит на канал в гистограмме цветов
+const int kBinCount = 1 << (3 * kBinBits);
+const int kMinDominantShare = 5;                // %, меньшие доли - не основной цвет
+
+quint32 packColor(int r, int g, int b)
+{
+    return (quint32(r) << 16) | (quint32(g) << 8) | quint32(b);
+}
+
+// Наименьшее значение, до которого включительно набирается доля p всех отсчётов
+int percentile(const std::array<quint32, 256> &histogram, quint32 total, double p)
+{
+    quint32 rank = qMax<quint32>(1, static_cast<quint32>(p * total + 0.5));
+    quint32 seen = 0;
+    for (int value = 0; value < 256; ++value) {
+        seen += histogram[value];
+        if (seen >= rank) return value;
+    }
+    return 255;
+}
+
+}
+
+bool computeColorStats(const QString &filePath, ColorStats &stats)
+{
+    QImageReader reader(filePath);
+    QSize full = reader.size();
+    if (full.isValid() && (full.width() > kColorStatsSize || full.height() > kColorStatsSize))
+        reader.setScaledSize(full.scaled(kColorStatsSize, kColorStatsSize, Qt::KeepAspectRatio));
+    QImage image = reader.read();
+    if (image.isNull()) return false;
+    if (image.width() > kColorStatsSize || image.height() > kColorStatsSize)
+        image = image.scaled(kColorStatsSize, kColorStatsSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return computeColorStats(image, stats);
+}
+
+bool computeColorStats(const QImage &source, ColorStats &stats)
+{
+    stats = ColorStats();
+    if (source.isNull()) return false;
+    const QImage image = source.format() == QImage::Format_ARGB32 || source.format() == QImage::Format_RGB32
+                             ? source : source.convertToFormat(QImage::Format_ARGB32);
+    const bool alpha = image.hasAlphaChannel();
+
+    std::array<std::array<quint32, 256>, 3> channels{};
+    std::array<quint32, 256> luma{};
+    struct Bin {
+        quint32 count = 0;
+        quint64 r = 0, g = 0, b = 0;
+    };
+    std::array<Bin, kBinCount> bins{};
+    quint64 sumR = 0, sumG = 0, sumB = 0;
+    quint32 total = 0;
+
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            QRgb pixel = line[x];
+            if (alpha && qAlpha(pixel) < 128) continue;
+            int r = qRed(pixel), g = qGreen(pixel), b = qBlue(pixel);
+            sumR += r;
+            sumG += g;
+            sumB += b;
+            ++channels[0][r];
+            ++channels[1][g];
+            ++channels[2][b];
+            ++luma[(54 * r + 183 * g + 19 * b) >> 8];  // коэффициенты BT.709 в 1/256
+            Bin &bin = bins[((r >> (8 - kBinBits)) << (2 * kBinBits)) | ((g >> (8 - kBinBits)) << kBinBits)
+                            | (b >> (8 - kBinBits))];
+            ++bin.count;
+            bin.r += r;
+            bin.g += g;
+            bin.b += b;
+            ++total;
+        }
+    }
+    if (total == 0) return false;
+
+    stats.samples = total;
+    stats.mean = packColor(int(sumR / total), int(sumG / total), int(sumB / total));
+    stats.median = packColor(percentile(channels[0], total, 0.5), percentile(channels[1], total, 0.5),
+                             percentile(channels[2], total, 0.5));
+    stats.luma = {static_cast<quint8>(percentile(luma, total, 0.05)),
+                  static_cast<quint8>(percentile(luma, total, 0.50)),
+                  static_cast<quint8>(percentile(luma, total, 0.95))};
+
+    // Основные цвета - самые населённые ячейки, цвет ячейки - среднее её пикселей
+    std::array<int, kBinCount> order;
+    for (int i = 0; i < kBinCount; ++i) order[i] = i;
+    std::partial_sort(order.begin(), order.begin() + 3, order.end(),
+                      [&bins](int a, int b) { return bins[a].count > bins[b].count; });
+    for (int k = 0; k < 3; ++k) {
+        const Bin &bin = bins[order[k]];
+        int share = static_cast<int>(quint64(bin.count) * 100 / total);
+        if (bin.count == 0 || share < kMinDominantShare) break;
+        stats.dominant[k] = packColor(int(bin.r / bin.count), int(bin.g / bin.count), int(bin.b / bin.count));
+        stats.dominantShare[k] = static_cast<quint8>(share);
+        stats.dominantCount = static_cast<quint8>(k + 1);
+    }
+    return true;
+}
+
+QString formatColor(quint32 rgb)
+{
+    return QString("#%1").arg(rgb & 0xFFFFFF, 6, 16, QChar('0')).toUpper();
+}
+
+QString formatMeanColor(const ColorStats &stats)
+{
+    if (!stats.isValid()) return QString();
+    return QString("%1, медиана %2").arg(formatColor(stats.mean), formatColor(stats.median));
+}
+
+QString formatDominantColors(const ColorStats &stats)
+{
+    if (!stats.isValid()) return QString();
+    QStringList parts;
+    for (int k = 0; k < stats.dominantCount; ++k)
+        parts.append(QString("%1 %2%").arg(formatColor(stats.dominant[k])).arg(stats.dominantShare[k]));
+    return parts.isEmpty() ? QString("пёстрое") : parts.join(", ");
+}
+
+QString formatLuminance(const ColorStats &stats)
+{
+    if (!stats.isValid()) return QString();
+    return QString("%1 / %2 / %3").arg(stats.luma[0]).arg(stats.luma[1]).arg(stats.luma[2]);
+}
@@ -0,0 +1,38 @@
+#ifndef COLORSTATS_H
+#define COLORSTATS_H
+
+#include <QString>
+#include <array>
+
+class QImage;
+
+// Цветовая статистика изображения по уменьшенному декодированию.
+// Цвета хранятся как 0xRRGGBB
+struct ColorStats {
+    quint32 mean = 0;
+    quint32 median = 0;                      // медиана каждого канала отдельно
+    std::array<quint32, 3> dominant{};       // основные цвета по убыванию доли
+    std::array<quint8, 3> dominantShare{};   // доля каждого, %
+    quint8 dominantCount = 0;
+    std::array<quint8, 3> luma{};            // перцентили яркости (BT.709) p5, p50, p95
+    quint32 samples = 0;                     // учтённых пикселей; 0 - не считалась
+
+    bool isValid() const { return samples > 0; }
+};
+
+// Длинная сторона уменьшенного изображения: JPEG декодер сразу масштабирует через DCT,
+// остальные форматы декодируются целиком и уменьшаются
+const int kColorStatsSize = 64;
+
+// Один проход по строкам: суммы, гистограммы каналов и яркости и грубая (3 бита
+// на канал) гистограмма цветов. Прозрачные (alpha < 128) пиксели не учитываются
+bool computeColorStats(const QString &filePath, ColorStats &stats);
+bool computeColorStats(const QImage &image, ColorStats &stats);
+
+// Подписи для таблицы; статистика не посчитана - пустая строка
+QString formatColor(quint32 rgb);                 // "#RRGGBB"
+QString formatMeanColor(const ColorStats &stats); // "#RRGGBB, медиана #RRGGBB"
+QString formatDominantColors(const ColorStats &stats);  // "#RRGGBB 41%, ..."
+QString formatLuminance(const ColorStats &stats); // "12 / 118 / 240"
+
+#endif // COLORSTATS_H
@@ -0,0 +1,195 @@
+#include "corpusstats.h"
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+const int kBarWidth = 30;
+const int kDpiEdges[] = {1, 72, 96, 150, 300, 600};  // нижние границы корзин после "нет данных"
+
+QString bar(qint64 count, qint64 maxCount)
+{
+    int width = maxCount > 0 ? static_cast<int>((count * kBarWidth + maxCount - 1) / maxCount) : 0;
+    return QString(width, QChar(0x2588));
+}
+
+QString megabytes(qint64 bytes)
+{
+    return QString("%1 МБ").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+// Строки гистограммы; пустые корзины по краям не печатаются
+template <typename Labels>
+QString histogramText(const QString &title, const qint64 *counts, int size, Labels label)
+{
+    int first = 0;
+    int last = size - 1;
+    while (first < size && counts[first] == 0) ++first;
+    while (last >= first && counts[last] == 0) --last;
+    if (first > last) return QString();
+
+    qint64 maxCount = *std::max_element(counts + first, counts + last + 1);
+    QString text = title + ":\n";
+    for (int i = first; i <= last; ++i)
+        text += QString("  %1 %2 %3\n").arg(label(i), -12).arg(bar(counts[i], maxCount), -kBarWidth).arg(counts[i]);
+    return text + "\n";
+}
+
+}
+
+void CorpusStats::add(const QString &filePath, const ImageInfo &info)
+{
+    ++files;
+    bytes += qMax<qint64>(info.fileSize, 0);
+    FormatTotals &totals = byFormat[info.format.isEmpty() ? QStringLiteral("?") : info.format];
+    totals.files++;
+    totals.bytes += qMax<qint64>(info.fileSize, 0);
+
+    int side = qMax(info.width, info.height);
+    if (side > 0) {
+        int bucket = 0;
+        while (bucket < kSideBuckets - 1 && (1 << bucket) < side) ++bucket;
+        sideBuckets[bucket]++;
+    }
+
+    int dpi = qMax(info.dpiX, info.dpiY);
+    int dpiBucket = 0;
+    for (int edge : kDpiEdges)
+        if (dpi >= edge) ++dpiBucket;
+    dpiBuckets[dpiBucket]++;
+
+    if (info.colorDepth > 0) depthCounts[info.colorDepth]++;
+
+    // Глубина известна уже по заголовку (формат пикселей), декодирования не ждём
+    qint64 uncompressed = static_cast<qint64>(qMax(info.width, 0)) * qMax(info.height, 0) * (info.colorDepth / 8);
+    if (uncompressed <= 0 || info.fileSize <= 0 || info.format == "BMP") {
+        ratioBuckets[0]++;
+    } else if (info.fileSize > uncompressed) {
+        ratioBuckets[1]++;
+    } else {
+        int saved = static_cast<int>((uncompressed - info.fileSize) * 10 / uncompressed);
+        ratioBuckets[2 + qMin(saved, 9)]++;
+    }
+
+    if (info.fileSize > 0) addLarge({info.fileSize, filePath});
+
+    if (info.recompress.isValid() && info.fileSize > 0) {
+        ++recompressFiles;
+        recompressCurrent += info.fileSize;
+        recompressQuality = info.recompress.jpegQuality;
+        for (int target = 0; target < RecompressTargetCount; ++target) {
+            if (info.recompress.bytes[target] < 0) continue;
+            recompressCurrentFor[target] += info.fileSize;
+            recompressTotals[target] += info.recompress.bytes[target];
+        }
+        // Лучший вариант - и "оставить как есть", если пересжатие не выгодно
+        qint64 best = info.recompress.best();
+        recompressBest += best >= 0 ? qMin(best, info.fileSize) : info.fileSize;
+    }
+}
+
+void CorpusStats::addLarge(LargeFile &&file)
+{
+    if (static_cast<int>(largest.size()) < kTopFiles) {
+        largest.push_back(std::move(file));
+        std::push_heap(largest.begin(), largest.end(), std::greater<LargeFile>());
+    } else if (file.size > largest.front().size) {
+        std::pop_heap(largest.begin(), largest.end(), std::greater<LargeFile>());
+        largest.back() = std::move(file);
+        std::push_heap(largest.begin(), largest.end(), std::greater<LargeFile>());
+    }
+}
+
+void CorpusStats::merge(const CorpusStats &other)
+{
+    files += other.files;
+    bytes += other.bytes;
+    for (auto it = other.byFormat.constBegin(); it != other.byFormat.constEnd(); ++it) {
+        FormatTotals &totals = byFormat[it.key()];
+        totals.files += it->files;
+        totals.bytes += it->bytes;
+    }
+    for (int i = 0; i < kSideBuckets; ++i) sideBuckets[i] += other.sideBuckets[i];
+    for (int i = 0; i < kDpiBuckets; ++i) dpiBuckets[i] += other.dpiBuckets[i];
+    for (auto it = other.depthCounts.constBegin(); it != other.depthCounts.constEnd(); ++it)
+        depthCounts[it.key()] += it.value();
+    for (int i = 0; i < kRatioBuckets; ++i) ratioBuckets[i] += other.ratioBuckets[i];
+    for (const LargeFile &file : other.largest) addLarge(LargeFile(file));
+    recompressFiles += other.recompressFiles;
+    recompressCurrent += other.recompressCurrent;
+    for (int target = 0; target < RecompressTargetCount; ++target) {
+        recompressCurrentFor[target] += other.recompressCurrentFor[target];
+        recompressTotals[target] += other.recompressTotals[target];
+    }
+    recompressBest += other.recompressBest;
+    if (other.recompressQuality > 0) recompressQuality = other.recompressQuality;
+}
+
+QString CorpusStats::toText() const
+{
+    if (files == 0) return "Сводка появится во время сканирования";
+
+    QString text = QString("Файлов: %1, объём: %2\n\n").arg(files).arg(megabytes(bytes));
+
+    // Форматы - по убыванию занятого места
+    QVector<QString> formats(byFormat.keyBegin(), byFormat.keyEnd());
+    std::sort(formats.begin(), formats.end(), [this](const QString &a, const QString &b) {
+        return byFormat.value(a).bytes > byFormat.value(b).bytes;
+    });
+    text += "Форматы:\n";
+    for (const QString &format : formats) {
+        const FormatTotals totals = byFormat.value(format);
+        text += QString("  %1 %2 файлов (%3%), %4\n")
+                    .arg(format, -6).arg(totals.files, 9)
+                    .arg(totals.files * 100.0 / files, 0, 'f', 1)
+                    .arg(megabytes(totals.bytes));
+    }
+    text += "\n";
+
+    text += histogramText("Длинная сторона, пиксели", sideBuckets.data(), kSideBuckets, [](int i) {
+        return i == kSideBuckets - 1 ? QString("> %1").arg(1 << (i - 1)) : QString("≤ %1").arg(1 << i);
+    });
+    text += histogramText("DPI", dpiBuckets.data(), kDpiBuckets, [](int i) {
+        if (i == 0) return QString("нет данных");
+        if (i == kDpiBuckets - 1) return QString("%1+").arg(kDpiEdges[i - 1]);
+        return QString("%1-%2").arg(kDpiEdges[i - 1]).arg(kDpiEdges[i] - 1);
+    });
+
+    QVector<qint64> depths;
+    QStringList depthLabels;
+    for (auto it = depthCounts.constBegin(); it != depthCounts.constEnd(); ++it) {
+        depths.append(it.value());
+        depthLabels.append(QString("%1 бит").arg(it.key()));
+    }
+    text += histogramText("Глубина цвета", depths.constData(), depths.size(),
+                          [&depthLabels](int i) { return depthLabels[i]; });
+
+    text += histogramText("Экономия против несжатого", ratioBuckets.data(), kRatioBuckets, [](int i) {
+        if (i == 0) return QString("нет данных");
+        if (i == 1) return QString("< 0%");
+        return QString("%1-%2%").arg((i - 2) * 10).arg((i - 1) * 10);
+    });
+
+    if (recompressFiles > 0) {
+        text += QString("Пересжатие (оценка по выборке плиток), файлов: %1, сейчас %2\n")
+                    .arg(recompressFiles).arg(megabytes(recompressCurrent));
+        for (int target = 0; target < RecompressTargetCount; ++target) {
+            if (recompressCurrentFor[target] <= 0) continue;
+            text += QString("  %1 %2 (%3% от текущего)\n")
+                        .arg(recompressTargetName(static_cast<RecompressTarget>(target), recompressQuality), -10)
+                        .arg(megabytes(recompressTotals[target]), 12)
+                        .arg(recompressTotals[target] * 100.0 / recompressCurrentFor[target], 0, 'f', 1);
+        }
+        text += QString("  %1 %2 (%3% от текущего)\n\n")
+                    .arg("лучшее", -10).arg(megabytes(recompressBest), 12)
+                    .arg(recompressBest * 100.0 / recompressCurrent, 0, 'f', 1);
+    }
+
+    std::vector<LargeFile> top = largest;
+    std::sort(top.begin(), top.end(), std::greater<LargeFile>());
+    text += QString("Самые большие файлы:\n");
+    for (const LargeFile &file : top) text += QString("  %1  %2\n").arg(megabytes(file.size), 10).arg(file.filePath);
+    return text;
+}
@@ -0,0 +1,61 @@
+#ifndef CORPUSSTATS_H
+#define CORPUSSTATS_H
+
+#include <QString>
+#include <QMap>
+#include <array>
+#include <vector>
+#include "imageinfo.h"
+
+// Сводка по набору изображений: число и объём файлов по форматам,
+// гистограммы размеров, DPI, глубины цвета и степени сжатия, самые большие
+// файлы, итоги оценки пересжатия. Память фиксирована при любом числе файлов. Воркеры копят частичные
+// сводки, поток интерфейса периодически сливает их через merge()
+class CorpusStats {
+public:
+    static const int kTopFiles = 20;
+
+    void add(const QString &filePath, const ImageInfo &info);
+    void merge(const CorpusStats &other);
+    void clear() { *this = CorpusStats(); }
+    bool isEmpty() const { return files == 0; }
+    qint64 fileCount() const { return files; }
+
+    QString toText() const;
+
+private:
+    struct FormatTotals {
+        qint64 files = 0;
+        qint64 bytes = 0;
+    };
+    struct LargeFile {
+        qint64 size;
+        QString filePath;
+        bool operator>(const LargeFile &other) const { return size > other.size; }
+    };
+
+    static const int kSideBuckets = 17;   // длинная сторона до 2^k пикселей
+    static const int kDpiBuckets = 7;     // нет данных и диапазоны от 72 до 600+
+    static const int kRatioBuckets = 12;  // нет данных, больше несжатого, по 10% экономии
+
+    void addLarge(LargeFile &&file);
+
+    QMap<QString, FormatTotals> byFormat;
+    std::array<qint64, kSideBuckets> sideBuckets{};
+    std::array<qint64, kDpiBuckets> dpiBuckets{};
+    QMap<int, qint64> depthCounts;
+    std::array<qint64, kRatioBuckets> ratioBuckets{};
+    std::vector<LargeFile> largest;  // куча с наименьшим из kTopFiles наверху
+    // Оценка пересжатия: сколько файлов оценено, их текущий объём и объём после пересжатия
+    // в каждый формат (по файлам, где формат оценён), а также при выборе лучшего для каждого файла
+    qint64 recompressFiles = 0;
+    qint64 recompressCurrent = 0;
+    std::array<qint64, RecompressTargetCount> recompressCurrentFor{};
+    std::array<qint64, RecompressTargetCount> recompressTotals{};
+    qint64 recompressBest = 0;
+    int recompressQuality = 0;
+    qint64 files = 0;
+    qint64 bytes = 0;
+};
+
+#endif // CORPUSSTATS_H
@@ -0,0 +1,158 @@
+#include "crc32.h"
+#include <QtEndian>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32_HAVE_PCLMUL
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const quint32 kPolynomial = 0xEDB88320u;
+const qint64 kMinFoldBytes = 64;  // короче - свёртка не окупает подготовку
+
+// Восемь таблиц: tables[k][b] - CRC байта b, за которым идут k нулевых байт
+struct SliceTables {
+    quint32 t[8][256];
+
+    SliceTables()
+    {
+        for (quint32 b = 0; b < 256; ++b) {
+            quint32 crc = b;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+            t[0][b] = crc;
+        }
+        for (int k = 1; k < 8; ++k)
+            for (int b = 0; b < 256; ++b) t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+    }
+};
+
+const SliceTables &sliceTables()
+{
+    static const SliceTables tables;
+    return tables;
+}
+
+// crc здесь и ниже - внутреннее (инвертированное) состояние
+quint32 crcSlice8(quint32 crc, const uchar *p, qint64 size)
+{
+    const auto &t = sliceTables().t;
+    while (size >= 8) {
+        quint32 one = qFromLittleEndian<quint32>(p) ^ crc;
+        quint32 two = qFromLittleEndian<quint32>(p + 4);
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24]
+              ^ t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+
+// acc * k (обе половины) + next - один шаг свёртки на 128 бит вперёд
+__attribute__((target("pclmul,sse4.1")))
+inline __m128i fold(__m128i acc, __m128i k, __m128i next)
+{
+    __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+inline __m128i load(const uchar *at)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(at));
+}
+
+// Свёртка по 64 байта четырьмя 128-битными аккумуляторами, затем до 128 бит,
+// до 64 и редукция Барретта до 32 (Intel, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ"). size >= 64 и кратен 16
+__attribute__((target("pclmul,sse4.1")))
+quint32 crcFold(quint32 crc, const uchar *p, qint64 size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x2 = load(p + 16);
+    __m128i x3 = load(p + 32);
+    __m128i x4 = load(p + 48);
+    p += 64;
+    size -= 64;
+
+    while (size >= 64) {
+        x1 = fold(x1, k1k2, load(p));
+        x2 = fold(x2, k1k2, load(p + 16));
+        x3 = fold(x3, k1k2, load(p + 32));
+        x4 = fold(x4, k1k2, load(p + 48));
+        p += 64;
+        size -= 64;
+    }
+
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+    while (size >= 16) {
+        x1 = fold(x1, k3k4, load(p));
+        p += 16;
+        size -= 16;
+    }
+
+    // 128 -> 64 бита
+    __m128i x2r = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2r);
+    x2r = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00), x2r);
+
+    // Редукция Барретта
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, t);
+    return static_cast<quint32>(_mm_extract_epi32(x1, 1));
+}
+
+bool detectPclmul()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+#else
+
+bool detectPclmul()
+{
+    return false;
+}
+
+#endif
+
+bool hasPclmul()
+{
+    static const bool value = detectPclmul();
+    return value;
+}
+
+}
+
+quint32 crc32Update(quint32 crc, const uchar *data, qint64 size)
+{
+    quint32 state = ~crc;
+#ifdef CRC32_HAVE_PCLMUL
+    if (size >= kMinFoldBytes && hasPclmul()) {
+        qint64 folded = size & ~qint64(15);
+        state = crcFold(state, data, folded);
+        data += folded;
+        size -= folded;
+    }
+#endif
+    return ~crcSlice8(state, data, size);
+}
+
+QString crc32Implementation()
+{
+    return hasPclmul() ? QStringLiteral("pclmul") : QStringLiteral("slice-by-8");
+}
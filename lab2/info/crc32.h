@@ -0,0 +1,15 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <QtGlobal>
+#include <QString>
+
+// CRC-32 (многочлен 0xEDB88320, как crc32() из zlib и в PNG). crc - результат по предыдущим
+// байтам, 0 для начала. На x86-64 с PCLMULQDQ длинные блоки сворачиваются
+// умножением без переносов, остальное - таблицами slice-by-8; выбор при первом вызове
+quint32 crc32Update(quint32 crc, const uchar *data, qint64 size);
+
+// "pclmul" или "slice-by-8" - для статистики и отладки
+QString crc32Implementation();
+
+#endif // CRC32_H
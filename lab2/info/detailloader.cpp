@@ -0,0 +1,90 @@
+#include "detailloader.h"
+#include "probeworker.h"
+#include <QThread>
+#include <memory>
+
+namespace {
+
+const int kMaxPending = 512;  // дальше - запросы для строк, давно ушедших с экрана
+
+}
+
+DetailLoader::DetailLoader(QObject *parent)
+    : QObject(parent)
+{
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+DetailLoader::~DetailLoader()
+{
+    stopping.store(true);
+    pool.clear();
+    pool.waitForDone();
+}
+
+void DetailLoader::clear()
+{
+    stack.clear();
+    queued.clear();
+}
+
+void DetailLoader::request(const QString &filePath, const QString &format, bool urgent)
+{
+    if (queued.contains(filePath)) {
+        if (!urgent) return;
+        // Уже ждёт в стеке - поднимаем наверх
+        for (int i = 0; i < stack.size(); ++i) {
+            if (stack[i].filePath == filePath) {
+                stack.append(stack.takeAt(i));
+                break;
+            }
+        }
+        return;
+    }
+
+    queued.insert(filePath);
+    stack.append({filePath, format});
+    if (stack.size() > kMaxPending) {
+        queued.remove(stack.first().filePath);
+        stack.removeFirst();
+    }
+    pump();
+}
+
+void DetailLoader::pump()
+{
+    while (!stack.isEmpty() && inFlight < pool.maxThreadCount()) {
+        Request request = stack.takeLast();
+        ++inFlight;
+        const int isolation = isolationTimeoutMs;
+        pool.start([this, request, isolation]() {
+            ImageInfo info;
+            info.format = request.format;
+            QString failure;
+            ProbeProcess::Outcome outcome = ProbeProcess::Unavailable;
+            if (isolation > 0) {
+                // Процесс-воркер - свой у каждого потока пула; с новым тайм-аутом - новый процесс
+                thread_local std::unique_ptr<ProbeProcess> process;
+                if (!process || process->timeout() != isolation)
+                    process = std::make_unique<ProbeProcess>(isolation, &stopping);
+                ProbeRequest probe;
+                probe.filePath = request.filePath;
+                probe.tasks = ProbeDetails;
+                probe.format = request.format;
+                StageTimings timings;
+                outcome = process->run(probe, info, timings);
+                if (outcome == ProbeProcess::Crashed || outcome == ProbeProcess::TimedOut) {
+                    markProbeFailure(request.filePath, info, outcome);
+                    failure = probeOutcomeName(outcome);
+                }
+            }
+            if (outcome == ProbeProcess::Unavailable) getImageDetails(request.filePath, info);
+            QMetaObject::invokeMethod(this, [this, path = request.filePath, info, failure]() {
+                --inFlight;
+                if (queued.remove(path)) emit detailsReady(path, info);
+                if (!failure.isEmpty()) emit probeFailed(path, failure);
+                pump();
+            }, Qt::QueuedConnection);
+        });
+    }
+}
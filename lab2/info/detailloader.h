@@ -0,0 +1,52 @@
+#ifndef DETAILLOADER_H
+#define DETAILLOADER_H
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QThreadPool>
+#include <atomic>
+#include "imageinfo.h"
+
+// Поля второго уровня (getImageDetails) для строк, которые видны или выбраны.
+// Как и миниатюры, запросы обслуживаются в порядке LIFO: последние запрошенные -
+// строки на экране. Готовые детали сохраняются в ScanResults, поэтому каждый
+// файл декодируется не больше одного раза.
+class DetailLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DetailLoader(QObject *parent = nullptr);
+    ~DetailLoader();
+
+    // Не блокирует; повторный запрос уже ожидающего файла ничего не делает,
+    // urgent - поставить файл первым (например, выбранная строка)
+    void request(const QString &filePath, const QString &format, bool urgent = false);
+    void clear();
+
+    // timeoutMs > 0 - декодировать в процессах-воркерах (см. ProbeProcess)
+    void setIsolation(int timeoutMs) { isolationTimeoutMs = timeoutMs; }
+
+signals:
+    // Файл, уронивший воркер, тоже приходит сюда - с ImageCorrupt (см. markProbeFailure)
+    void detailsReady(const QString &filePath, const ImageInfo &info);
+    void probeFailed(const QString &filePath, const QString &reason);
+
+private:
+    struct Request {
+        QString filePath;
+        QString format;
+    };
+
+    void pump();
+
+    QVector<Request> stack;  // вершина - самый свежий запрос
+    QSet<QString> queued;    // в стеке или в работе
+    int inFlight = 0;
+    int isolationTimeoutMs = 0;
+    std::atomic<bool> stopping{false};  // останавливает воркеры при уничтожении; живёт дольше пула
+    QThreadPool pool;
+};
+
+#endif // DETAILLOADER_H
@@ -0,0 +1,136 @@
+#include "dirwalker.h"
+#include "scanstats.h"
+#include <QElapsedTimer>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+DirWalker::DirWalker(const QStringList &nameFilters, int threadCount)
+    : threadCount(qMax(1, threadCount))
+{
+    for (const QString &filter : nameFilters) {
+        int dot = filter.lastIndexOf('.');
+        if (dot >= 0) suffixes.insert(filter.mid(dot + 1).toLower());
+    }
+}
+
+bool DirWalker::matches(const QString &fileName) const
+{
+    int dot = fileName.lastIndexOf('.');
+    return dot >= 0 && suffixes.contains(fileName.mid(dot + 1).toLower());
+}
+
+void DirWalker::walk(const QString &root, const FileCallback &onFile)
+{
+    stopped.store(false);
+    // После отмены в счётчике остаются каталоги, которые так и не обошли
+    pending.store(0);
+    visitedDirs.store(0);
+    foundFiles.store(0);
+
+    queues.clear();
+    for (int i = 0; i < threadCount; ++i) queues.push_back(std::make_unique<WorkQueue>());
+    push(0, root);
+
+    std::vector<QThread *> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        QThread *thread = QThread::create([this, i, &onFile]() { workerLoop(i, onFile); });
+        thread->start();
+        threads.push_back(thread);
+    }
+    workerLoop(0, onFile);  // вызывающий поток тоже работает
+
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void DirWalker::cancel()
+{
+    stopped.store(true);
+    QMutexLocker locker(&idleMutex);
+    workAvailable.wakeAll();
+}
+
+void DirWalker::push(int self, const QString &dir)
+{
+    pending.fetch_add(1);
+    {
+        QMutexLocker locker(&queues[self]->mutex);
+        queues[self]->dirs.push_back(dir);
+    }
+    QMutexLocker locker(&idleMutex);
+    if (idleThreads > 0) workAvailable.wakeOne();
+}
+
+bool DirWalker::takeWork(int self, QString &dir)
+{
+    {
+        QMutexLocker locker(&queues[self]->mutex);
+        if (!queues[self]->dirs.empty()) {
+            dir = queues[self]->dirs.back();
+            queues[self]->dirs.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < threadCount; ++i) {
+        WorkQueue &victim = *queues[(self + i) % threadCount];
+        QMutexLocker locker(&victim.mutex);
+        if (!victim.dirs.empty()) {
+            dir = victim.dirs.front();
+            victim.dirs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirWalker::workerLoop(int self, const FileCallback &onFile)
+{
+    while (!stopped.load() && pending.load() > 0) {
+        QString dir;
+        if (!takeWork(self, dir)) {
+            // Работы нет, но другие потоки ещё могут её породить. Очереди проверяются
+            // повторно под idleMutex: push() будит под ним же, пробуждение не теряется
+            QMutexLocker locker(&idleMutex);
+            if (stopped.load() || pending.load() == 0) break;
+            if (!takeWork(self, dir)) {
+                ++idleThreads;
+                workAvailable.wait(&idleMutex);
+                --idleThreads;
+                continue;
+            }
+        }
+
+        QElapsedTimer listTimer;
+        listTimer.start();
+        qint64 callbackNs = 0;
+
+        // Только текущий каталог: подкаталоги уходят в очередь и могут быть перехвачены
+        QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it.hasNext() && !stopped.load()) {
+            it.next();
+            QFileInfo fi = it.fileInfo();
+            if (fi.isDir()) {
+                if (!fi.isSymLink()) push(self, fi.filePath());
+            } else if (matches(fi.fileName())) {
+                foundFiles.fetch_add(1);
+                qint64 before = listTimer.nsecsElapsed();
+                if (!onFile(fi.filePath())) cancel();  // будит и уснувшие потоки
+                callbackNs += listTimer.nsecsElapsed() - before;
+            }
+        }
+
+        if (stats) stats->addSample(ScanStage::Enumerate, QString(), listTimer.nsecsElapsed() - callbackNs);
+
+        visitedDirs.fetch_add(1);
+        if (pending.fetch_sub(1) == 1) {
+            // Последний каталог - ждущие потоки больше ничего не получат
+            QMutexLocker locker(&idleMutex);
+            workAvailable.wakeAll();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef DIRWALKER_H
+#define DIRWALKER_H
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ScanStats;
+
+// Параллельный обход дерева каталогов с перехватом работы (work stealing).
+// Каждый поток берёт подкаталоги из своей очереди с конца (в глубину),
+// а когда она пуста - забирает самые старые (крупные) поддеревья у соседей.
+// Найденные файлы сразу передаются в обработчик, не дожидаясь конца обхода.
+class DirWalker {
+public:
+    // Вызывается из рабочих потоков; false - прекратить обход
+    using FileCallback = std::function<bool(const QString &filePath)>;
+
+    DirWalker(const QStringList &nameFilters, int threadCount);
+
+    // Блокирует вызывающий поток до завершения обхода
+    void walk(const QString &root, const FileCallback &onFile);
+    void cancel();
+
+    // Замеры перечисления каталогов (без времени обработчика файлов)
+    void setStats(ScanStats *value) { stats = value; }
+
+    qint64 directoriesVisited() const { return visitedDirs.load(); }
+    qint64 filesFound() const { return foundFiles.load(); }
+
+private:
+    struct WorkQueue {
+        QMutex mutex;
+        std::deque<QString> dirs;
+    };
+
+    void workerLoop(int self, const FileCallback &onFile);
+    bool takeWork(int self, QString &dir);
+    void push(int self, const QString &dir);
+    bool matches(const QString &fileName) const;
+
+    QSet<QString> suffixes;  // расширения из масок вида "*.jpg"
+    ScanStats *stats = nullptr;
+    int threadCount;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<qint64> pending{0};  // каталогов в очередях и в обработке
+    QMutex idleMutex;
+    QWaitCondition workAvailable;    // потоки без работы ждут новый каталог или конец обхода
+    int idleThreads = 0;             // под idleMutex
+    std::atomic<bool> stopped{false};
+    std::atomic<qint64> visitedDirs{0};
+    std::atomic<qint64> foundFiles{0};
+};
+
+#endif // DIRWALKER_H
@@ -0,0 +1,149 @@
+#include "diskorder.h"
+#include "imageinfo.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+// Физическое смещение первого экстента; false - ФС не умеет FIEMAP или у файла нет экстентов
+bool firstExtentOffset(int fd, quint64 &offset)
+{
+    // Заголовок запроса и место под один экстент; FIEMAP_FLAG_SYNC не ставим - он сбрасывает кеш записи
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    struct fiemap *map = reinterpret_cast<struct fiemap *>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (::ioctl(fd, FS_IOC_FIEMAP, map) < 0) return false;
+    if (map->fm_mapped_extents == 0) return false;
+    const struct fiemap_extent &first = map->fm_extents[0];
+    // Данные внутри inode или ещё не размещённые на диске - смещения нет
+    if (first.fe_flags & (FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC))
+        return false;
+    offset = first.fe_physical;
+    return true;
+}
+#endif
+
+}
+
+ScanOrder scanOrderFromString(const QString &name, bool *ok)
+{
+    const QString value = name.trimmed().toLower();
+    if (ok) *ok = true;
+    if (value == "walk") return ScanOrder::Walk;
+    if (value == "inode") return ScanOrder::Inode;
+    if (value == "extent" || value == "fiemap") return ScanOrder::Extent;
+    if (ok) *ok = false;
+    return ScanOrder::Walk;
+}
+
+QString scanOrderName(ScanOrder order)
+{
+    switch (order) {
+    case ScanOrder::Walk: return "walk";
+    case ScanOrder::Inode: return "inode";
+    case ScanOrder::Extent: return "extent";
+    }
+    return QString();
+}
+
+bool DiskOrderKey::operator<(const DiskOrderKey &other) const
+{
+    if (device != other.device) return device < other.device;
+    if (mapped != other.mapped) return mapped;
+    return position < other.position;
+}
+
+DiskOrderKey diskOrderKey(const QString &filePath, ScanOrder order)
+{
+    DiskOrderKey key;
+    if (order == ScanOrder::Walk) return key;
+#ifdef Q_OS_UNIX
+    const QByteArray path = QFile::encodeName(filePath);
+#ifdef Q_OS_LINUX
+    if (order == ScanOrder::Extent) {
+        int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0) {
+                key.device = static_cast<quint64>(st.st_dev);
+                key.position = static_cast<quint64>(st.st_ino);
+                key.mapped = firstExtentOffset(fd, key.position);  // при неудаче остаётся inode
+            }
+            ::close(fd);
+            return key;
+        }
+    }
+#endif
+    struct stat st;
+    if (::stat(path.constData(), &st) == 0) {
+        key.device = static_cast<quint64>(st.st_dev);
+        key.position = static_cast<quint64>(st.st_ino);
+    }
+#else
+    Q_UNUSED(filePath);
+#endif
+    return key;
+}
+
+QVector<int> diskOrderPermutation(const QVector<DiskOrderKey> &keys)
+{
+    QVector<int> order(keys.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+void sortByDiskOrder(QStringList &filePaths, ScanOrder order)
+{
+    if (order == ScanOrder::Walk) return;
+    QVector<DiskOrderKey> keys(filePaths.size());
+    for (int i = 0; i < filePaths.size(); ++i) keys[i] = diskOrderKey(filePaths[i], order);
+    QStringList sorted;
+    sorted.reserve(filePaths.size());
+    for (int i : diskOrderPermutation(keys)) sorted.append(filePaths[i]);
+    filePaths.swap(sorted);
+}
+
+void evictFromPageCache(const QString &filePath)
+{
+#ifdef Q_OS_UNIX
+    int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+#ifdef POSIX_FADV_DONTNEED
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+#else
+    Q_UNUSED(filePath);
+#endif
+}
+
+qint64 measureColdHeaderScan(const QStringList &filePaths, int threads)
+{
+    for (const QString &filePath : filePaths) evictFromPageCache(filePath);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, threads));
+    QElapsedTimer timer;
+    timer.start();
+    // Пул берёт задачи в порядке постановки - чтения идут в порядке списка
+    for (const QString &filePath : filePaths)
+        pool.start([filePath]() { getImageHeaderInfo(filePath); });
+    pool.waitForDone();
+    return timer.elapsed();
+}
@@ -0,0 +1,42 @@
+#ifndef DISKORDER_H
+#define DISKORDER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Порядок разбора найденных файлов
+enum class ScanOrder {
+    Walk,    // как нашёл обход каталогов
+    Inode,   // по номеру inode: на ext4/XFS он близок к положению на диске
+    Extent   // по физическому смещению первого экстента (Linux FIEMAP), иначе по inode
+};
+
+ScanOrder scanOrderFromString(const QString &name, bool *ok = nullptr);
+QString scanOrderName(ScanOrder order);
+
+// Положение файла на носителе для сортировки. Файлы без экстента (FIEMAP не
+// поддерживается, данные внутри inode) идут после размеченных, по inode
+struct DiskOrderKey {
+    quint64 device = 0;
+    quint64 position = 0;  // смещение первого экстента, байт, или номер inode
+    bool mapped = false;   // position - смещение экстента
+
+    bool operator<(const DiskOrderKey &other) const;
+};
+
+// Один stat (для Extent - ещё open и ioctl): вызывать из рабочих потоков
+DiskOrderKey diskOrderKey(const QString &filePath, ScanOrder order);
+// Номера ключей по возрастанию положения; равные сохраняют исходный порядок
+QVector<int> diskOrderPermutation(const QVector<DiskOrderKey> &keys);
+void sortByDiskOrder(QStringList &filePaths, ScanOrder order);
+
+// Выбросить файл из страничного кеша (posix_fadvise DONTNEED), чтобы следующий
+// разбор читал его с носителя. Кеш каталогов и inode при этом остаётся
+void evictFromPageCache(const QString &filePath);
+
+// Время холодного разбора заголовков в заданном порядке, мс: файлы сначала
+// вытесняются из кеша, затем разбираются threads потоками по очереди списка
+qint64 measureColdHeaderScan(const QStringList &filePaths, int threads);
+
+#endif // DISKORDER_H
@@ -0,0 +1,178 @@
+#include "fileview.h"
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <atomic>
+
+namespace {
+
+const qint64 kPageSize = 4096;
+const qint64 kMinRead = 4096;        // минимальная порция чтения
+const qint64 kMaxReadStep = 1 << 20; // максимальный прирост окна за одно чтение
+const qint64 kMaxWindow = 4 << 20;   // больше - начинаем новое окно, а не растим старое
+
+std::atomic<int> currentMode{static_cast<int>(FileAccessMode::Auto)};
+
+// Сетевые ФС, на которых mmap даёт непредсказуемые задержки при промахах страниц
+bool isNetworkFileSystem(const QString &filePath)
+{
+    static const QSet<QByteArray> networkTypes = {
+        "nfs", "nfs4", "cifs", "smb", "smb2", "smbfs", "smb3",
+        "fuse.sshfs", "9p", "afs", "ncpfs", "davfs", "fuse.rclone"
+    };
+    static QMutex cacheMutex;
+    static QHash<QString, bool> cache;  // каталог -> сетевая ли ФС
+
+    QString dir = QFileInfo(filePath).absolutePath();
+    {
+        QMutexLocker locker(&cacheMutex);
+        auto it = cache.constFind(dir);
+        if (it != cache.constEnd()) return it.value();
+    }
+
+    QStorageInfo storage(dir);
+    bool network = storage.isValid() && networkTypes.contains(storage.fileSystemType().toLower());
+
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(dir, network);
+    return network;
+}
+
+}
+
+void setFileAccessMode(FileAccessMode mode)
+{
+    currentMode.store(static_cast<int>(mode));
+}
+
+FileAccessMode fileAccessMode()
+{
+    return static_cast<FileAccessMode>(currentMode.load());
+}
+
+FileAccessMode fileAccessModeFromString(const QString &name, bool *ok)
+{
+    QString n = name.trimmed().toLower();
+    if (ok) *ok = true;
+    if (n == "mmap") return FileAccessMode::Mmap;
+    if (n == "pread") return FileAccessMode::Pread;
+    if (ok) *ok = (n == "auto");
+    return FileAccessMode::Auto;
+}
+
+QString fileAccessModeName(FileAccessMode mode)
+{
+    switch (mode) {
+    case FileAccessMode::Mmap: return "mmap";
+    case FileAccessMode::Pread: return "pread";
+    default: return "auto";
+    }
+}
+
+FileView::FileView(const QString &filePath, FileAccessMode mode)
+    : file(filePath)
+{
+    // Без буфера QIODevice каждое чтение идёт прямо в ОС и учитывается точно
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) return;
+
+    opened = true;
+    fileSize = file.size();
+
+    if (mode == FileAccessMode::Auto)
+        mode = isNetworkFileSystem(filePath) ? FileAccessMode::Pread : FileAccessMode::Mmap;
+
+    if (mode == FileAccessMode::Mmap && fileSize > 0) {
+        mapped = file.map(0, fileSize);
+        if (mapped) {
+            touchedPages.resize(static_cast<int>((fileSize + kPageSize - 1) / kPageSize));
+            activeMode = FileAccessMode::Mmap;
+            return;
+        }
+    }
+
+    // Отображение недоступно - переходим на чтение порциями
+    activeMode = FileAccessMode::Pread;
+}
+
+FileView::FileView(const QByteArray &bytes)
+    : opened(true), fileSize(bytes.size()), window(bytes), readBytes(bytes.size())
+{
+}
+
+FileView::~FileView()
+{
+    if (mapped) file.unmap(mapped);
+}
+
+const uchar *FileView::data(qint64 offset, qint64 length)
+{
+    if (!opened || offset < 0 || length < 0 || offset + length > fileSize) return nullptr;
+
+    if (mapped) {
+        touchPages(offset, length);
+        return mapped + offset;
+    }
+    return readWindow(offset, length);
+}
+
+qint64 FileView::bytesRead() const
+{
+    if (mapped) return qMin(touchedPageCount * kPageSize, fileSize);
+    return readBytes;
+}
+
+void FileView::touchPages(qint64 offset, qint64 length)
+{
+    if (length == 0) return;
+    int first = static_cast<int>(offset / kPageSize);
+    int last = static_cast<int>((offset + length - 1) / kPageSize);
+    for (int page = first; page <= last; ++page) {
+        if (!touchedPages.testBit(page)) {
+            touchedPages.setBit(page);
+            ++touchedPageCount;
+        }
+    }
+}
+
+const uchar *FileView::readWindow(qint64 offset, qint64 length)
+{
+    qint64 windowEnd = windowOffset + window.size();
+    if (offset >= windowOffset && offset + length <= windowEnd)
+        return reinterpret_cast<const uchar *>(window.constData()) + (offset - windowOffset);
+
+    if (!window.isEmpty() && offset >= windowOffset && offset <= windowEnd
+        && offset + length - windowOffset <= kMaxWindow) {
+        // Последовательный разбор: дочитываем окно, удваивая порцию
+        qint64 step = qBound(kMinRead, qMax<qint64>(window.size(), offset + length - windowEnd), kMaxReadStep);
+        step = qMax(step, offset + length - windowEnd);
+        step = qMin(step, fileSize - windowEnd);
+
+        if (!file.seek(windowEnd)) return nullptr;  // окно не тронуто
+        qint64 oldSize = window.size();
+        window.resize(oldSize + step);
+        qint64 got = file.read(window.data() + oldSize, step);
+        if (got < 0) got = 0;
+        readBytes += got;
+        window.resize(oldSize + got);
+    } else {
+        // Произвольный доступ: начинаем новое окно. Старое сбрасывается до чтения,
+        // чтобы при ошибке не осталось байт, приписанных чужому смещению
+        window.clear();
+        windowOffset = 0;
+        qint64 step = qMin(qMax(length, kMinRead), fileSize - offset);
+        if (step <= 0 || !file.seek(offset)) return nullptr;
+        QByteArray fresh(step, Qt::Uninitialized);
+        qint64 got = file.read(fresh.data(), step);
+        if (got <= 0) return nullptr;
+        readBytes += got;
+        fresh.resize(got);
+        window.swap(fresh);
+        windowOffset = offset;
+    }
+
+    if (offset + length > windowOffset + window.size()) return nullptr;
+    return reinterpret_cast<const uchar *>(window.constData()) + (offset - windowOffset);
+}
@@ -0,0 +1,63 @@
+#ifndef FILEVIEW_H
+#define FILEVIEW_H
+
+#include <QString>
+#include <QFile>
+#include <QBitArray>
+#include <QByteArray>
+
+// Способ доступа к файлу при разборе заголовков
+enum class FileAccessMode {
+    Auto,   // mmap, а для сетевых ФС - чтение небольшими порциями
+    Mmap,   // отображение файла в память только для чтения
+    Pread   // чтение небольшими порциями с произвольной позиции
+};
+
+void setFileAccessMode(FileAccessMode mode);
+FileAccessMode fileAccessMode();
+FileAccessMode fileAccessModeFromString(const QString &name, bool *ok = nullptr);
+QString fileAccessModeName(FileAccessMode mode);
+
+// Окно на содержимое файла без копирования всего файла в память.
+// Указатель, возвращённый data(), действителен до следующего вызова data().
+class FileView {
+public:
+    explicit FileView(const QString &filePath, FileAccessMode mode = fileAccessMode());
+    // Представление уже прочитанного начала файла (например, из HeaderPrefetcher):
+    // данные за пределами bytes недоступны
+    explicit FileView(const QByteArray &bytes);
+    ~FileView();
+
+    FileView(const FileView &) = delete;
+    FileView &operator=(const FileView &) = delete;
+
+    bool isOpen() const { return opened; }
+    qint64 size() const { return fileSize; }
+    FileAccessMode mode() const { return activeMode; }
+
+    // Возвращает указатель на байты [offset, offset + length) или nullptr,
+    // если диапазон выходит за пределы файла
+    const uchar *data(qint64 offset, qint64 length);
+
+    // Сколько байт реально прочитано с носителя (для mmap - затронутые страницы)
+    qint64 bytesRead() const;
+
+private:
+    const uchar *readWindow(qint64 offset, qint64 length);
+    void touchPages(qint64 offset, qint64 length);
+
+    QFile file;
+    bool opened = false;
+    qint64 fileSize = 0;
+    FileAccessMode activeMode = FileAccessMode::Pread;
+
+    uchar *mapped = nullptr;
+    QBitArray touchedPages;
+    qint64 touchedPageCount = 0;
+
+    QByteArray window;
+    qint64 windowOffset = 0;
+    qint64 readBytes = 0;
+};
+
+#endif // FILEVIEW_H
@@ -0,0 +1,276 @@
+#include "headerprefetch.h"
+#include <QFile>
+#include <QThread>
+#include <QMutexLocker>
+#include <QVector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+PrefetchBackend prefetchBackendFromString(const QString &name, bool *ok)
+{
+    QString n = name.trimmed().toLower();
+    if (ok) *ok = true;
+    if (n == "uring" || n == "io_uring") return PrefetchBackend::Uring;
+    if (n == "pool") return PrefetchBackend::ThreadPool;
+    if (ok) *ok = (n == "auto");
+    return PrefetchBackend::Auto;
+}
+
+QString prefetchBackendName(PrefetchBackend backend)
+{
+    switch (backend) {
+    case PrefetchBackend::Uring: return "uring";
+    case PrefetchBackend::ThreadPool: return "pool";
+    default: return "auto";
+    }
+}
+
+bool prefetchBackendAvailable(PrefetchBackend backend)
+{
+#ifdef HAVE_LIBURING
+    if (backend == PrefetchBackend::Uring) {
+        // Ядро может не поддерживать io_uring или запрещать его (sysctl, seccomp)
+        io_uring probe;
+        if (io_uring_queue_init(4, &probe, 0) < 0) return false;
+        bool sparse = io_uring_register_files_sparse(&probe, 1) == 0;
+        io_uring_queue_exit(&probe);
+        return sparse;
+    }
+#else
+    if (backend == PrefetchBackend::Uring) return false;
+#endif
+    return true;
+}
+
+#ifdef HAVE_LIBURING
+
+// Каждый файл - четыре операции в одной очереди: openat в слот таблицы
+// зарегистрированных файлов, связанное с ним чтение начала файла, закрытие
+// слота (выполняется даже после ошибки чтения) и независимый statx для размера
+struct HeaderPrefetcher::Ring {
+    enum Op { OpOpen, OpRead, OpClose, OpStat, OpCount };
+
+    struct Slot {
+        QString filePath;
+        QByteArray pathBytes;  // должен жить до завершения openat/statx
+        QByteArray buffer;
+        struct statx stx;
+        qint64 submitted = 0;
+        int readResult = 0;
+        bool statOk = false;
+        int pending = 0;       // незавершённых операций слота
+    };
+
+    io_uring ring;
+    QVector<Slot> slots_;
+    QVector<int> freeSlots;
+};
+
+#else
+
+struct HeaderPrefetcher::Ring {};
+
+#endif
+
+HeaderPrefetcher::HeaderPrefetcher(PrefetchBackend backend, Callback callback, int depth, qint64 bytes)
+    : onReady(std::move(callback)), queueDepth(qMax(1, depth)), headerBytes(qMax<qint64>(1, bytes))
+{
+    clock.start();
+
+#ifdef HAVE_LIBURING
+    if (backend != PrefetchBackend::ThreadPool) {
+        auto state = std::make_unique<Ring>();
+        unsigned entries = static_cast<unsigned>(queueDepth) * Ring::OpCount;
+        if (io_uring_queue_init(entries, &state->ring, 0) == 0) {
+            if (io_uring_register_files_sparse(&state->ring, static_cast<unsigned>(queueDepth)) == 0) {
+                state->slots_.resize(queueDepth);
+                for (int i = queueDepth - 1; i >= 0; --i) state->freeSlots.append(i);
+                ring = std::move(state);
+                activeBackend = PrefetchBackend::Uring;
+                ringThread = QThread::create([this]() { runRing(); });
+                ringThread->start();
+                return;
+            }
+            io_uring_queue_exit(&state->ring);
+        }
+    }
+#else
+    Q_UNUSED(backend);
+#endif
+
+    // Глубину очереди к устройству в переносимом варианте дают потоки
+    activeBackend = PrefetchBackend::ThreadPool;
+    pool.setMaxThreadCount(qMin(queueDepth, 64));
+}
+
+HeaderPrefetcher::~HeaderPrefetcher()
+{
+    finish();
+#ifdef HAVE_LIBURING
+    if (ring) io_uring_queue_exit(&ring->ring);
+#endif
+}
+
+void HeaderPrefetcher::submit(const QString &filePath)
+{
+    qint64 submitted = clock.nsecsElapsed();
+    if (activeBackend == PrefetchBackend::ThreadPool) {
+        pool.start([this, filePath, submitted]() { readWithPool(filePath, submitted); });
+        return;
+    }
+
+    QMutexLocker locker(&queueMutex);
+    queue.append({filePath, submitted});
+    queueReady.wakeOne();
+}
+
+void HeaderPrefetcher::finish()
+{
+    if (ringThread) {
+        {
+            QMutexLocker locker(&queueMutex);
+            finishing = true;
+            queueReady.wakeAll();
+        }
+        ringThread->wait();
+        delete ringThread;
+        ringThread = nullptr;
+    }
+    pool.waitForDone();
+}
+
+void HeaderPrefetcher::readWithPool(const QString &filePath, qint64 submitted)
+{
+    PrefetchedHeader header;
+    header.filePath = filePath;
+
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        header.fileSize = file.size();
+        header.data.resize(static_cast<int>(qMin(headerBytes, qMax<qint64>(header.fileSize, 0))));
+        qint64 got = header.data.isEmpty() ? 0 : file.read(header.data.data(), header.data.size());
+        header.ok = got >= 0;
+        header.data.resize(static_cast<int>(qMax<qint64>(got, 0)));
+    }
+    header.latencyNs = clock.nsecsElapsed() - submitted;
+    onReady(std::move(header));
+}
+
+void HeaderPrefetcher::runRing()
+{
+#ifdef HAVE_LIBURING
+    Ring &r = *ring;
+    int inFlight = 0;
+
+    // Очередь SQE рассчитана на все слоты, но цепочку из OpCount записей нельзя
+    // рвать посередине: если места не хватает, сначала отправляем накопленное,
+    // а при неудаче файл уходит в пул потоков
+    auto enqueue = [&](int index, const QString &filePath, qint64 submitted) {
+        if (io_uring_sq_space_left(&r.ring) < Ring::OpCount) io_uring_submit(&r.ring);
+        if (io_uring_sq_space_left(&r.ring) < Ring::OpCount) return false;
+        Ring::Slot &slot = r.slots_[index];
+        slot.filePath = filePath;
+        slot.pathBytes = QFile::encodeName(filePath);
+        slot.buffer.resize(static_cast<int>(headerBytes));
+        slot.submitted = submitted;
+        slot.readResult = 0;
+        slot.statOk = false;
+        slot.pending = Ring::OpCount;
+        quint64 tag = static_cast<quint64>(index) << 2;
+
+        io_uring_sqe *sqe = io_uring_get_sqe(&r.ring);
+        io_uring_prep_openat_direct(sqe, AT_FDCWD, slot.pathBytes.constData(), O_RDONLY | O_CLOEXEC, 0, index);
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_sqe_set_data64(sqe, tag | Ring::OpOpen);
+
+        sqe = io_uring_get_sqe(&r.ring);
+        io_uring_prep_read(sqe, index, slot.buffer.data(), static_cast<unsigned>(headerBytes), 0);
+        sqe->flags |= IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        io_uring_sqe_set_data64(sqe, tag | Ring::OpRead);
+
+        sqe = io_uring_get_sqe(&r.ring);
+        io_uring_prep_close_direct(sqe, index);
+        io_uring_sqe_set_data64(sqe, tag | Ring::OpClose);
+
+        sqe = io_uring_get_sqe(&r.ring);
+        io_uring_prep_statx(sqe, AT_FDCWD, slot.pathBytes.constData(), 0, STATX_SIZE, &slot.stx);
+        io_uring_sqe_set_data64(sqe, tag | Ring::OpStat);
+        return true;
+    };
+
+    auto complete = [&](io_uring_cqe *cqe) {
+        quint64 tag = io_uring_cqe_get_data64(cqe);
+        int index = static_cast<int>(tag >> 2);
+        Ring::Slot &slot = r.slots_[index];
+        switch (tag & 3) {
+        case Ring::OpOpen:
+            if (cqe->res < 0) slot.readResult = cqe->res;
+            break;
+        case Ring::OpRead:
+            if (slot.readResult >= 0) slot.readResult = cqe->res;
+            break;
+        case Ring::OpStat:
+            slot.statOk = cqe->res == 0;
+            break;
+        }
+        if (--slot.pending > 0) return;
+
+        PrefetchedHeader header;
+        header.filePath = std::move(slot.filePath);
+        header.ok = slot.readResult >= 0;
+        header.fileSize = slot.statOk ? static_cast<qint64>(slot.stx.stx_size) : -1;
+        slot.buffer.resize(qMax(slot.readResult, 0));
+        header.data = std::move(slot.buffer);
+        header.latencyNs = clock.nsecsElapsed() - slot.submitted;
+        slot.buffer = QByteArray();
+        r.freeSlots.append(index);
+        --inFlight;
+        onReady(std::move(header));
+    };
+
+    while (true) {
+        // Занимаем свободные слоты путями из очереди и отправляем одним вызовом
+        bool added = false;
+        {
+            QMutexLocker locker(&queueMutex);
+            while (inFlight == 0 && queue.isEmpty() && !finishing) queueReady.wait(&queueMutex);
+            if (inFlight == 0 && queue.isEmpty() && finishing) break;
+            while (!queue.isEmpty() && !r.freeSlots.isEmpty()) {
+                auto next = queue.takeFirst();
+                int index = r.freeSlots.takeLast();
+                if (!enqueue(index, next.first, next.second)) {
+                    r.freeSlots.append(index);
+                    pool.start([this, next]() { readWithPool(next.first, next.second); });
+                    continue;
+                }
+                ++inFlight;
+                added = true;
+            }
+        }
+        if (added) io_uring_submit(&r.ring);
+
+        // Пока есть свободные слоты, ждём недолго, чтобы подхватывать новые пути
+        io_uring_cqe *cqe = nullptr;
+        int rc;
+        if (r.freeSlots.isEmpty()) {
+            rc = io_uring_wait_cqe(&r.ring, &cqe);
+        } else {
+            __kernel_timespec timeout{0, 1000000};
+            rc = io_uring_wait_cqe_timeout(&r.ring, &cqe, &timeout);
+        }
+        if (rc < 0) continue;  // -ETIME или -EINTR
+
+        unsigned head;
+        unsigned seen = 0;
+        io_uring_for_each_cqe(&r.ring, head, cqe) {
+            complete(cqe);
+            ++seen;
+        }
+        io_uring_cq_advance(&r.ring, seen);
+    }
+#endif
+}
@@ -0,0 +1,83 @@
+#ifndef HEADERPREFETCH_H
+#define HEADERPREFETCH_H
+
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+
+class QThread;
+
+// Чем читать начало файлов перед разбором заголовков
+enum class PrefetchBackend {
+    Auto,        // io_uring, если доступен, иначе пул потоков
+    Uring,       // Linux io_uring: открытие и чтение сотен файлов одной очередью
+    ThreadPool   // переносимый вариант: open + read в пуле потоков
+};
+
+PrefetchBackend prefetchBackendFromString(const QString &name, bool *ok = nullptr);
+QString prefetchBackendName(PrefetchBackend backend);
+bool prefetchBackendAvailable(PrefetchBackend backend);
+
+const qint64 kDefaultHeaderBytes = 64 * 1024;
+
+// Начало файла, прочитанное заранее
+struct PrefetchedHeader {
+    QString filePath;
+    QByteArray data;       // не больше headerBytes; меньше - значит, файл прочитан целиком
+    qint64 fileSize = -1;  // -1 - не удалось узнать
+    bool ok = false;       // файл открыт и прочитан без ошибок
+    qint64 latencyNs = 0;  // от submit() до готовности
+};
+
+// Предварительное чтение первых headerBytes байт множества файлов.
+// Пути добавляются submit() из любого потока, готовые заголовки передаются
+// в onReady в порядке завершения чтения. onReady вызывается из внутренних
+// потоков и должен быстро отдавать работу дальше (например, в свой пул),
+// иначе он задерживает следующие чтения.
+class HeaderPrefetcher {
+public:
+    using Callback = std::function<void(PrefetchedHeader &&header)>;
+
+    HeaderPrefetcher(PrefetchBackend backend, Callback onReady,
+                     int queueDepth = 256, qint64 headerBytes = kDefaultHeaderBytes);
+    ~HeaderPrefetcher();
+
+    HeaderPrefetcher(const HeaderPrefetcher &) = delete;
+    HeaderPrefetcher &operator=(const HeaderPrefetcher &) = delete;
+
+    // Фактически используемый способ (Auto и недоступный Uring разрешаются здесь)
+    PrefetchBackend backend() const { return activeBackend; }
+
+    void submit(const QString &filePath);
+    // Новых путей не будет: ждём, пока все отправленные файлы не будут переданы в onReady
+    void finish();
+
+private:
+    struct Ring;
+
+    void readWithPool(const QString &filePath, qint64 submitted);
+    void runRing();
+
+    Callback onReady;
+    int queueDepth;
+    qint64 headerBytes;
+    PrefetchBackend activeBackend = PrefetchBackend::ThreadPool;
+    QElapsedTimer clock;  // общая шкала времени для latencyNs
+
+    QThreadPool pool;
+
+    std::unique_ptr<Ring> ring;
+    QThread *ringThread = nullptr;
+    QMutex queueMutex;
+    QWaitCondition queueReady;
+    QList<QPair<QString, qint64>> queue;  // путь и момент submit()
+    bool finishing = false;
+};
+
+#endif // HEADERPREFETCH_H
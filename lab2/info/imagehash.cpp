@@ -0,0 +1,200 @@
+#include "imagehash.h"
+#include "imageinfo.h"
+#include "fileview.h"
+#include <QCryptographicHash>
+#include <QImageReader>
+#include <QImage>
+#include <QHash>
+#include <QThreadPool>
+#include <numeric>
+#include <algorithm>
+
+bool computePerceptualHash(const QString &filePath, quint64 &hash)
+{
+    QImageReader reader(filePath);
+    reader.setScaledSize(QSize(9, 8));
+    QImage small = reader.read();
+    if (small.isNull()) return false;
+
+    small = small.convertToFormat(QImage::Format_Grayscale8);
+    if (small.size() != QSize(9, 8)) small = small.scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    // Бит = 1, если яркость растёт слева направо
+    hash = 0;
+    for (int y = 0; y < 8; ++y) {
+        const uchar *line = small.constScanLine(y);
+        for (int x = 0; x < 8; ++x)
+            hash = (hash << 1) | (line[x] < line[x + 1] ? 1 : 0);
+    }
+    return true;
+}
+
+bool computeContentHash(const QString &filePath, quint64 &hash)
+{
+    FileView view(filePath);
+    if (!view.isOpen()) return false;
+
+    const qint64 chunk = 1 << 20;
+    QCryptographicHash sha1(QCryptographicHash::Sha1);
+    for (qint64 offset = 0; offset < view.size(); offset += chunk) {
+        qint64 length = qMin(chunk, view.size() - offset);
+        const uchar *data = view.data(offset, length);
+        if (!data) return false;
+        sha1.addData(QByteArrayView(data, length));
+    }
+
+    QByteArray digest = sha1.result();
+    hash = 0;
+    for (int i = 0; i < 8; ++i) hash = (hash << 8) | static_cast<uchar>(digest[i]);
+    return true;
+}
+
+void computeImageHashes(const QString &filePath, ImageInfo &info)
+{
+    if (computePerceptualHash(filePath, info.perceptualHash) && computeContentHash(filePath, info.contentHash))
+        info.flags |= ImageHashed;
+}
+
+void BkTree::insert(quint64 hash, int id)
+{
+    if (nodes.empty()) {
+        nodes.push_back({hash, id, {}});
+        return;
+    }
+
+    int current = 0;
+    while (true) {
+        int d = hammingDistance(hash, nodes[current].hash);
+        auto &children = nodes[current].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [d](const std::pair<quint8, int> &c) { return c.first == d; });
+        if (it == children.end()) {
+            children.emplace_back(static_cast<quint8>(d), static_cast<int>(nodes.size()));
+            nodes.push_back({hash, id, {}});
+            return;
+        }
+        current = it->second;
+    }
+}
+
+void BkTree::query(quint64 hash, int radius, QVector<int> &result) const
+{
+    if (nodes.empty()) return;
+
+    std::vector<int> stack = {0};
+    while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        int d = hammingDistance(hash, node.hash);
+        if (d <= radius) result.append(node.id);
+
+        // Неравенство треугольника: нужные узлы лежат в поддеревьях [d - r, d + r]
+        for (const auto &child : node.children)
+            if (child.first >= d - radius && child.first <= d + radius) stack.push_back(child.second);
+    }
+}
+
+namespace {
+
+int findRoot(std::vector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+void unite(std::vector<int> &parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a != b) parent[std::max(a, b)] = std::min(a, b);
+}
+
+}
+
+QVector<DuplicateGroup> findDuplicateGroups(const QVector<quint64> &perceptual,
+                                            const QVector<quint64> &content,
+                                            const QVector<bool> &hashed,
+                                            int maxDistance, int threads)
+{
+    const int n = perceptual.size();
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+
+    // Точные дубликаты: одинаковый хеш содержимого. В дерево попадает
+    // только первый файл каждой группы - остальные ему идентичны.
+    QHash<quint64, int> firstByContent;
+    QVector<int> representatives;
+    for (int i = 0; i < n; ++i) {
+        if (!hashed[i]) continue;
+        auto it = firstByContent.constFind(content[i]);
+        if (it != firstByContent.constEnd()) {
+            unite(parent, it.value(), i);
+        } else {
+            firstByContent.insert(content[i], i);
+            representatives.append(i);
+        }
+    }
+
+    BkTree tree;
+    for (int i : std::as_const(representatives)) tree.insert(perceptual[i], i);
+
+    // Запросы параллельно по кускам; пары объединяем уже в одном потоке
+    const int chunkCount = qMax(1, threads * 4);
+    const int chunkSize = (representatives.size() + chunkCount - 1) / chunkCount;
+    const QVector<int> &reps = representatives;
+    std::vector<std::vector<std::pair<int, int>>> pairs(chunkCount);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, threads));
+    for (int c = 0; c < chunkCount; ++c) {
+        pool.start([&, c]() {
+            QVector<int> found;
+            int end = qMin<int>(reps.size(), (c + 1) * chunkSize);
+            for (int k = c * chunkSize; k < end; ++k) {
+                int i = reps[k];
+                found.clear();
+                tree.query(perceptual[i], maxDistance, found);
+                for (int j : std::as_const(found))
+                    if (j > i) pairs[c].emplace_back(i, j);
+            }
+        });
+    }
+    pool.waitForDone();
+
+    for (const auto &chunk : pairs)
+        for (const auto &p : chunk) unite(parent, p.first, p.second);
+
+    QHash<int, int> groupOfRoot;
+    QVector<DuplicateGroup> groups;
+    for (int i = 0; i < n; ++i) {
+        if (!hashed[i]) continue;
+        int root = findRoot(parent, i);
+        auto it = groupOfRoot.constFind(root);
+        if (it == groupOfRoot.constEnd()) {
+            it = groupOfRoot.insert(root, groups.size());
+            groups.append(DuplicateGroup());
+        }
+        groups[it.value()].members.append(i);
+    }
+
+    QVector<DuplicateGroup> result;
+    for (DuplicateGroup &g : groups) {
+        if (g.members.size() < 2) continue;
+        g.exact = true;
+        for (int k = 1; k < g.members.size(); ++k) {
+            if (content[g.members[k]] != content[g.members[0]]) g.exact = false;
+            g.maxDistance = qMax(g.maxDistance, hammingDistance(perceptual[g.members[k]], perceptual[g.members[0]]));
+        }
+        result.append(g);
+    }
+
+    // Крупные группы - первыми
+    std::sort(result.begin(), result.end(), [](const DuplicateGroup &a, const DuplicateGroup &b) {
+        return a.members.size() > b.members.size();
+    });
+    return result;
+}
@@ -0,0 +1,57 @@
+#ifndef IMAGEHASH_H
+#define IMAGEHASH_H
+
+#include <QString>
+#include <QVector>
+#include <QtAlgorithms>
+#include <vector>
+
+struct ImageInfo;
+
+// Перцептивный хеш (dHash, 64 бита) по уменьшенному декодированию 9x8.
+// Для JPEG декодер сам масштабирует в 1/8 через DCT, полное изображение не строится.
+bool computePerceptualHash(const QString &filePath, quint64 &hash);
+
+// Хеш содержимого файла (первые 64 бита SHA-1) для точных дубликатов
+bool computeContentHash(const QString &filePath, quint64 &hash);
+
+// Заполняет perceptualHash/contentHash в info и выставляет флаг ImageHashed
+void computeImageHashes(const QString &filePath, ImageInfo &info);
+
+inline int hammingDistance(quint64 a, quint64 b)
+{
+    return qPopulationCount(a ^ b);
+}
+
+// BK-дерево по расстоянию Хэмминга: поиск всех хешей в радиусе r
+// без полного перебора. После построения только читается - запросы
+// можно выполнять из нескольких потоков одновременно.
+class BkTree {
+public:
+    void insert(quint64 hash, int id);
+    void query(quint64 hash, int radius, QVector<int> &result) const;
+    int size() const { return static_cast<int>(nodes.size()); }
+
+private:
+    struct Node {
+        quint64 hash;
+        int id;
+        std::vector<std::pair<quint8, int>> children;  // расстояние -> номер узла
+    };
+    std::vector<Node> nodes;
+};
+
+struct DuplicateGroup {
+    QVector<int> members;  // номера строк
+    bool exact = false;    // все файлы побайтно одинаковы
+    int maxDistance = 0;   // наибольшее расстояние dHash внутри группы
+};
+
+// Группирует точные (по содержимому) и почти-дубликаты (dHash в радиусе maxDistance).
+// hashed[i] == false - строка не участвует. Запросы к дереву идут в threads потоках.
+QVector<DuplicateGroup> findDuplicateGroups(const QVector<quint64> &perceptual,
+                                            const QVector<quint64> &content,
+                                            const QVector<bool> &hashed,
+                                            int maxDistance, int threads);
+
+#endif // IMAGEHASH_H
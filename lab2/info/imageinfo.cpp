@@ -1,9 +1,18 @@
 #include "imageinfo.h"
+#include "fileview.h"
+#include "headerprefetch.h"
+#include "archivereader.h"
+#include "imagemetadata.h"
+#include "quanttables.h"
 #include <QElapsedTimer>
 #include <QFileInfo>
 #include <QImageReader>
+#include <QBuffer>
+#include <QPixelFormat>
 #include <QFile>
 #include <cmath>
+#include <numeric>
+#include <algorithm>
 
 QString getCompressionInfo(const QString &format)
 {
@@ -17,36 +26,57 @@ QString getCompressionInfo(const QString &format)
     return "Неизвестно";
 }
 
-QString getAdditionalInfo(const QString &format, const QImage &image)
+QString getColorSpaceInfo(const QString &format)
 {
-    QStringList details;
     QString f = format.toUpper();
+    if (f == "JPG" || f == "JPEG") return "YCbCr";
+    if (f == "PNG" || f == "BMP") return "RGB";
+    if (f == "GIF") return "Indexed";
+    return "неизвестно";
+}
+
+QString formatPixelSize(int width, int height)
+{
+    if (width < 0 || height < 0) return "Некорректный размер";
+    return QString("%1 x %2").arg(width).arg(height);
+}
+
+QString formatResolution(int dpiX, int dpiY)
+{
+    return QString("%1 x %2").arg(dpiX).arg(dpiY);
+}
+
+QString formatColorDepth(int colorDepth)
+{
+    return colorDepth <= 0 ? "Неизвестно" : QString("%1 бит").arg(colorDepth);
+}
+
+QString formatFileSize(qint64 bytes)
+{
+    return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+}
+
+QString formatAdditionalInfo(const QString &colorSpace, int width, int height, quint8 flags)
+{
+    QStringList details;
 
     // Цветовое пространство
-    if (f == "JPG" || f == "JPEG") {
-        details << "YCbCr";
-    } else if (f == "PNG" || f == "BMP") {
-        details << "RGB";
-    } else if (f == "GIF") {
-        details << "Indexed";
-    } else {
-        details << "неизвестно";
-    }
+    details << colorSpace;
 
     // Тип изображения
-    if (image.isGrayscale()) {
+    if (flags & ImageGrayscale) {
         details << "Grayscale";
-    } else if (image.colorCount() > 0) {
+    } else if (flags & ImageIndexed) {
         details << "Indexed";
     } else {
         details << "Truecolor";
     }
 
     // Каналы
-    if (!image.isNull()) {
-        if (image.isGrayscale()) {
+    if (flags & ImageDecoded) {
+        if (flags & ImageGrayscale) {
             details << "1 канал";
-        } else if (image.hasAlphaChannel()) {
+        } else if (flags & ImageAlpha) {
             details << "4 канала (RGBA)";
             details << "Прозрачность есть";
         } else {
@@ -58,29 +88,22 @@ QString getAdditionalInfo(const QString &format, const QImage &image)
     }
 
     // Соотношение сторон
-    int w = image.width();
-    int h = image.height();
-    if (w > 0 && h > 0) {
-        int gcd = std::gcd(w, h);
-        details << QString("Соотношение: %1:%2").arg(w / gcd).arg(h / gcd);
+    if ((flags & ImageDecoded) && width > 0 && height > 0) {
+        int gcd = std::gcd(width, height);
+        details << QString("Соотношение: %1:%2").arg(width / gcd).arg(height / gcd);
     }
 
     return details.join(", ");
 }
 
 // Функция для расчёта степени сжатия
-QString calculateCompressionRatio(const QString &filePath, const QImage &image, const QString &format)
+QString formatCompressionRatio(const QString &format, qint64 fileSize, int width, int height, int colorDepth, quint8 flags)
 {
-    if (image.isNull()) return "N/A";
-
-    QFileInfo fi(filePath);
-    qint64 actualSize = fi.size();
+    if (!(flags & ImageDecoded)) return "N/A";
 
     // Расчёт несжатого размера
-    int width = image.width();
-    int height = image.height();
-    int bytesPerPixel = image.depth() / 8;
-    qint64 uncompressedSize = static_cast<qint64>(width) * height * bytesPerPixel;
+    int bytesPerPixel = colorDepth / 8;
+    qint64 uncompressedSize = static_cast<qint64>(qMax(width, 0)) * qMax(height, 0) * bytesPerPixel;
 
     QString f = format.toUpper();
     if (f == "BMP") {
@@ -88,9 +111,9 @@ QString calculateCompressionRatio(const QString &filePath, const QImage &image,
         return "-";
     }
 
-    if (actualSize > 0 && uncompressedSize > 0) {
-        double savedMB = (uncompressedSize - actualSize) / (1024.0 * 1024.0);
-        double savedPercent = ((uncompressedSize - actualSize) * 100.0) / uncompressedSize;
+    if (fileSize > 0 && uncompressedSize > 0) {
+        double savedMB = (uncompressedSize - fileSize) / (1024.0 * 1024.0);
+        double savedPercent = ((uncompressedSize - fileSize) * 100.0) / uncompressedSize;
 
         return QString("-%1 МБ, -%2%")
             .arg(savedMB, 0, 'f', 2)
@@ -100,95 +123,202 @@ QString calculateCompressionRatio(const QString &filePath, const QImage &image,
     return "N/A";
 }
 
-// Функция для извлечения матрицы квантования из JPEG
-QVector<QVector<int>> extractQuantizationMatrix(const QString &filePath)
+QStringList supportedImageNameFilters()
 {
-    QVector<QVector<int>> matrix;
-    QFile file(filePath);
+    return {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.gif", "*.tif", "*.tiff", "*.pcx"};
+}
 
-    if (!file.open(QIODevice::ReadOnly)) {
-        return matrix;
+namespace {
+
+// Поля, которые есть только у декодированного изображения
+void fillFromImage(ImageInfo &info, const QImage &image)
+{
+    if (info.width < 0 && !image.isNull()) {
+        info.width = image.width();
+        info.height = image.height();
     }
 
-    QByteArray data = file.readAll();
-    file.close();
+    // DPI из метаданных не перекрываем: без них Qt подставляет 72
+    if (info.dpiX <= 0 && info.dpiY <= 0) {
+        info.dpiX = static_cast<int>(image.dotsPerMeterX() * 0.0254 + 0.5);
+        info.dpiY = static_cast<int>(image.dotsPerMeterY() * 0.0254 + 0.5);
+    }
 
-    // Поиск маркера DQT (Define Quantization Table) - 0xFFDB
-    for (int i = 0; i < data.size() - 1; i++) {
-        if (static_cast<unsigned char>(data[i]) == 0xFF &&
-            static_cast<unsigned char>(data[i + 1]) == 0xDB) {
+    if (!image.isNull()) {
+        info.flags |= ImageDecoded;
+        info.colorDepth = image.depth();
+        if (image.hasAlphaChannel()) info.flags |= ImageAlpha;
+    }
+    if (image.isGrayscale()) info.flags |= ImageGrayscale;
+    if (image.colorCount() > 0) info.flags |= ImageIndexed;
+}
 
-            // Найден маркер DQT
-            if (i + 4 >= data.size()) break;
+// То же по формату пикселей из заголовка, без декодирования
+void fillFromPixelFormat(ImageInfo &info, QImage::Format format)
+{
+    if (format == QImage::Format_Invalid) return;
+    QPixelFormat pixelFormat = QImage::toPixelFormat(format);
+    info.colorDepth = pixelFormat.bitsPerPixel();
+    if (pixelFormat.alphaUsage() == QPixelFormat::UsesAlpha) info.flags |= ImageAlpha;
+    if (format == QImage::Format_Grayscale8 || format == QImage::Format_Grayscale16) info.flags |= ImageGrayscale;
+    if (format == QImage::Format_Indexed8 || format == QImage::Format_Mono || format == QImage::Format_MonoLSB)
+        info.flags |= ImageIndexed;
+}
 
-            int length = (static_cast<unsigned char>(data[i + 2]) << 8) |
-                         static_cast<unsigned char>(data[i + 3]);
+bool isJpeg(const QString &format)
+{
+    return format == "JPG" || format == "JPEG";
+}
 
-            if (i + 4 + length - 2 > data.size()) break;
+// DPI из EXIF, JFIF или pHYs и программа-кодировщик - без декодирования.
+// Без Software/CreatorTool кодировщиком считается камера
+void fillFromMetadata(FileView &view, ImageInfo &info)
+{
+    ImageMetadata meta;
+    if (!readImageMetadata(view, meta)) return;
+    info.dpiX = meta.dpiX;
+    info.dpiY = meta.dpiY;
+    info.encoder = !meta.software.isEmpty() ? meta.software : QStringList({meta.make, meta.model}).join(' ').trimmed();
+}
 
-            int offset = i + 4;
+// Таблицы квантования лежат в заголовке рядом с метаданными - читаем тем же view.
+// Возвращает длительность для ScanStage::QuantTable
+qint64 fillQuantTables(FileView &view, ImageInfo &info)
+{
+    QElapsedTimer timer;
+    timer.start();
+    info.quantTables = extractQuantizationTables(view);
+    return timer.nsecsElapsed();
+}
 
-            // Читаем информацию о таблице
-            unsigned char tableInfo = static_cast<unsigned char>(data[offset]);
-            int precision = (tableInfo >> 4) & 0x0F;  // 0 = 8 бит, 1 = 16 бит
-            int tableId = tableInfo & 0x0F;
+}
 
-            offset++;
+ImageInfo getImageInfo(const QString &filePath, StageTimings *timings)
+{
+    ImageInfo info = getImageHeaderInfo(filePath, timings);
+    getImageDetails(filePath, info, timings);
+    return info;
+}
 
-            // Читаем 8x8 матрицу
-            if (precision == 0 && offset + 64 <= data.size()) {
-                matrix.resize(8);
-                for (int row = 0; row < 8; row++) {
-                    matrix[row].resize(8);
-                    for (int col = 0; col < 8; col++) {
-                        // JPEG использует зигзаг-порядок, но для простоты читаем последовательно
-                        matrix[row][col] = static_cast<unsigned char>(data[offset++]);
-                    }
-                }
-                break;  // Берём первую найденную таблицу
-            }
-        }
+ImageInfo getImageHeaderInfo(const QString &filePath, StageTimings *timings)
+{
+    if (splitArchivePath(filePath)) {
+        // Член архива разбирается за одно чтение, второго уровня у него нет
+        ImageInfo info = getArchiveMemberInfo(filePath, timings);
+        info.flags |= ImageDetailed;
+        return info;
     }
 
-    return matrix;
-}
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    QElapsedTimer stageTimer;
+    stageTimer.start();
 
-ImageInfo getImageInfo(const QString &filePath)
-{
     ImageInfo info;
     QFileInfo fi(filePath);
     QImageReader reader(filePath);
-    QImage image(filePath);
 
     info.fileName = fi.fileName();
-    info.fileSize = QString("%1 KB").arg(fi.size() / 1024.0, 0, 'f', 1);
+    info.fileSize = fi.size();
     info.format = reader.format().toUpper();
+    t[ScanStage::Open] = stageTimer.nsecsElapsed();
 
+    stageTimer.restart();
     QSize size = reader.size();
     if (size.isValid()) {
-        info.size = QString("%1 x %2").arg(size.width()).arg(size.height());
-    } else {
-        info.size = image.isNull() ? "Некорректный размер" : QString("%1 x %2").arg(image.width()).arg(image.height());
+        info.width = size.width();
+        info.height = size.height();
+    }
+    fillFromPixelFormat(info, reader.imageFormat());
+    if (isJpeg(info.format) || info.format == "PNG") {
+        FileView view(filePath);
+        fillFromMetadata(view, info);
+        if (isJpeg(info.format)) t[ScanStage::QuantTable] = fillQuantTables(view, info);
+        info.headerBytesRead = view.bytesRead();
     }
+    t[ScanStage::Header] = stageTimer.nsecsElapsed() - t[ScanStage::QuantTable];
 
-    int dpiX = static_cast<int>(image.dotsPerMeterX() * 0.0254 + 0.5);
-    int dpiY = static_cast<int>(image.dotsPerMeterY() * 0.0254 + 0.5);
+    return info;
+}
 
-    info.resolution = QString("%1 x %2").arg(dpiX).arg(dpiY);
-    info.colorDepth = image.isNull() ? "Неизвестно" : QString("%1 бит").arg(image.depth());
-    info.compression = getCompressionInfo(info.format);
-    info.additionalInfo = getAdditionalInfo(info.format, image);
+void getImageDetails(const QString &filePath, ImageInfo &info, StageTimings *timings)
+{
+    if (info.flags & ImageDetailed) return;
+    info.flags |= ImageDetailed;
+    if (splitArchivePath(filePath)) return;
+
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    // DetailLoader приходит только с форматом - DPI берём из метаданных заново
+    if (info.dpiX <= 0 && info.dpiY <= 0 && (isJpeg(info.format) || info.format == "PNG")) {
+        FileView view(filePath);
+        fillFromMetadata(view, info);
+    }
+
+    QImage image(filePath);
+    t[ScanStage::Decode] = stageTimer.nsecsElapsed();
+    if (!image.isNull()) {
+        // Декодированное изображение точнее оценки по формату пикселей
+        info.flags &= ~(ImageAlpha | ImageGrayscale | ImageIndexed);
+    }
+    fillFromImage(info, image);
+}
 
-    // Расчёт степени сжатия
-    info.compressionRatio = calculateCompressionRatio(filePath, image, info.format);
+bool getImageInfoFromBytes(const QByteArray &data, qint64 fileSize, ImageInfo &info, StageTimings *timings)
+{
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    info.format = reader.format().toUpper();
+    QSize size = reader.size();
+    QImage::Format pixelFormat = reader.imageFormat();
+    t[ScanStage::Header] = stageTimer.nsecsElapsed();
+
+    if (!size.isValid()) return false;
+    info.width = size.width();
+    info.height = size.height();
+    if (isJpeg(info.format) || info.format == "PNG") {
+        FileView view(data);
+        fillFromMetadata(view, info);
+        if (isJpeg(info.format)) t[ScanStage::QuantTable] = fillQuantTables(view, info);
+    }
 
-    // Извлечение матрицы квантования для JPEG
-    info.hasQuantMatrix = false;
-    QString f = info.format.toUpper();
-    if (f == "JPG" || f == "JPEG") {
-        info.quantizationMatrix = extractQuantizationMatrix(filePath);
-        info.hasQuantMatrix = !info.quantizationMatrix.isEmpty();
+    if (data.size() >= fileSize) {
+        // Файл прочитан целиком - декодируем из памяти, как и обычный путь
+        stageTimer.restart();
+        fillFromImage(info, QImage::fromData(data));
+        info.flags |= ImageDetailed;
+        t[ScanStage::Decode] = stageTimer.nsecsElapsed();
+    } else {
+        fillFromPixelFormat(info, pixelFormat);
     }
+    return true;
+}
+
+ImageInfo getImageInfoFromHeader(const PrefetchedHeader &header, StageTimings *timings)
+{
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    t[ScanStage::Open] = header.latencyNs;
+    if (!header.ok || header.fileSize < 0) return getImageInfo(header.filePath, timings);
 
+    ImageInfo info;
+    info.fileName = QFileInfo(header.filePath).fileName();
+    info.fileSize = header.fileSize;
+    info.headerBytesRead = header.data.size();
+
+    // Размер не поместился в прочитанное начало (например, большой EXIF перед SOF) -
+    // разбираем файл обычным путём
+    if (!getImageInfoFromBytes(header.data, header.fileSize, info, &t))
+        return getImageInfo(header.filePath, timings);
     return info;
 }
@@ -2,26 +2,82 @@
 #define IMAGEINFO_H
 
 #include <QString>
+#include <QStringList>
 #include <QImage>
-#include <QVector>
-#include <QMetaType>
+#include <QByteArray>
+#include "colorstats.h"
+#include "recompress.h"
+#include "scanstats.h"
 
+// Флаги, полученные при декодировании изображения
+enum ImageFlag : quint8 {
+    ImageDecoded   = 0x01,  // изображение удалось декодировать
+    ImageGrayscale = 0x02,
+    ImageIndexed   = 0x04,  // есть палитра
+    ImageAlpha     = 0x08,
+    ImageHashed    = 0x10,  // посчитаны perceptualHash и contentHash
+    ImageDetailed  = 0x20,  // посчитаны поля второго уровня (см. getImageDetails)
+    ImagePending   = 0x40,  // строка заведена при обходе, заголовок ещё не разобран
+    ImageCorrupt   = 0x80   // проверка целостности нашла повреждение (см. integritycheck.h)
+};
+
+// Результат разбора одного файла. Все поля хранятся в исходном (числовом) виде,
+// текст для таблицы и отчётов формируется только при отображении.
 struct ImageInfo {
     QString fileName;
-    QString size;
-    QString resolution;
-    QString colorDepth;
-    QString compression;
-    QString format;
-    QString fileSize;
-    QString additionalInfo;
-    QString compressionRatio;
-    QVector<QVector<int>> quantizationMatrix;  // Матрица квантования для JPEG
-    bool hasQuantMatrix;  // Флаг наличия матрицы квантования
+    QString format;             // "JPEG", "PNG", ... (как у QImageReader)
+    int width = -1;             // -1 - размер не определён
+    int height = -1;
+    int dpiX = 0;
+    int dpiY = 0;
+    int colorDepth = 0;         // бит на пиксель, 0 - неизвестно
+    quint8 flags = 0;           // ImageFlag
+    qint64 fileSize = 0;        // байт
+    QByteArray quantTables;     // все таблицы квантования JPEG (см. quanttables.h), пусто - нет
+    QString encoder;            // программа или камера из EXIF/XMP, пусто - не указана
+    qint64 headerBytesRead = 0;  // Сколько байт прочитано при разборе заголовка
+    quint64 perceptualHash = 0;  // dHash для поиска похожих изображений
+    quint64 contentHash = 0;     // хеш содержимого для точных дубликатов
+    quint8 integrity = 0;        // IntegrityStatus, 0 - не проверялся
+    ColorStats colors;           // по уменьшенному декодированию (computeColorStats), если просили
+    RecompressEstimate recompress;  // оценка размера после пересжатия (estimateRecompression), если просили
 };
 
-Q_DECLARE_METATYPE(QVector<ImageInfo>)
+// Маски имён файлов поддерживаемых форматов для обхода каталогов
+QStringList supportedImageNameFilters();
+
+struct PrefetchedHeader;
+
+// timings (необязательно) - куда записать длительности этапов разбора.
+// Путь вида "архив.zip!/член" разбирается внутри архива (см. archivereader.h)
+ImageInfo getImageInfo(const QString &filePath, StageTimings *timings = nullptr);
+
+// Разбор в два уровня. Заголовок - формат, размеры, размер файла, глубина и флаги
+// по формату пикселей, DPI и программа из метаданных (EXIF, JFIF, pHYs), таблицы квантования
+// JPEG - без декодирования. Детали - декодирование (DPI, точная глубина, палитра, прозрачность);
+// ставят ImageDetailed.
+// getImageInfo() - это оба уровня сразу.
+ImageInfo getImageHeaderInfo(const QString &filePath, StageTimings *timings = nullptr);
+void getImageDetails(const QString &filePath, ImageInfo &info, StageTimings *timings = nullptr);
+
+// Разбор по заранее прочитанному началу файла без повторного обращения к диску.
+// Если файл не поместился в буфер целиком, он не декодируется: глубина и флаги
+// берутся из формата пикселей заголовка, DPI - только из метаданных.
+// Если заголовок не разобрался по буферу, используется getImageInfo().
+ImageInfo getImageInfoFromHeader(const PrefetchedHeader &header, StageTimings *timings = nullptr);
+
+// Разбор по байтам начала файла полного размера fileSize (заполняет формат, размеры,
+// глубину и таблицу квантования). false - размер изображения по этим байтам не определить
+bool getImageInfoFromBytes(const QByteArray &data, qint64 fileSize, ImageInfo &info, StageTimings *timings = nullptr);
 
-ImageInfo getImageInfo(const QString &filePath);
+// Подписи и форматирование для отображения
+QString getCompressionInfo(const QString &format);
+QString getColorSpaceInfo(const QString &format);
+QString formatPixelSize(int width, int height);
+QString formatResolution(int dpiX, int dpiY);
+QString formatColorDepth(int colorDepth);
+QString formatFileSize(qint64 bytes);
+QString formatCompressionRatio(const QString &format, qint64 fileSize, int width, int height, int colorDepth, quint8 flags);
+QString formatAdditionalInfo(const QString &colorSpace, int width, int height, quint8 flags);
 
 #endif // IMAGEINFO_H
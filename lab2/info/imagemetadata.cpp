@@ -0,0 +1,400 @@
+#include "imagemetadata.h"
+#include "fileview.h"
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#ifdef HAVE_SYSTEM_ZLIB
+#include <zlib.h>
+#else
+#include <QtZlib/zlib.h>
+#endif
+
+namespace {
+
+const qint64 kMaxChunk = 4 << 20;            // больше - уже не метаданные
+const size_t kMaxIccInflated = 1 << 20;
+const size_t kInflateStep = 64 * 1024;
+const char kXmpSignature[] = "http://ns.adobe.com/xap/1.0/";  // с завершающим нулём - 29 байт
+const char kXmpKeyword[] = "XML:com.adobe.xmp";               // ключ iTXt в PNG
+
+quint16 be16(const uchar *p)
+{
+    return static_cast<quint16>((p[0] << 8) | p[1]);
+}
+
+quint32 be32(const uchar *p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3];
+}
+
+bool startsWith(const uchar *data, qint64 size, const char *prefix, qint64 prefixSize)
+{
+    return size >= prefixSize && std::memcmp(data, prefix, prefixSize) == 0;
+}
+
+// Текст до первого нуля, без пробелов в конце (так камеры дополняют поля EXIF)
+QString asciiValue(const uchar *data, qint64 size)
+{
+    const char *text = reinterpret_cast<const char *>(data);
+    qint64 length = static_cast<qint64>(qstrnlen(text, static_cast<size_t>(size)));
+    while (length > 0 && text[length - 1] == ' ') --length;
+    return QString::fromLatin1(text, length);
+}
+
+// TIFF-структура блока EXIF, разбираемая прямо по байтам сегмента
+class TiffReader {
+public:
+    TiffReader(const uchar *data, qint64 size) : data(data), size(size) {}
+    bool parse(ImageMetadata &meta);
+
+private:
+    struct IfdValues {
+        double xResolution = 0;
+        double yResolution = 0;
+        int resolutionUnit = 2;  // 2 - дюймы, 3 - сантиметры
+        qint64 exifIfd = 0;
+        QString dateTime;
+    };
+
+    bool has(qint64 offset, qint64 length) const { return offset >= 0 && length >= 0 && offset + length <= size; }
+    quint16 u16(qint64 offset) const
+    {
+        const uchar *p = data + offset;
+        return little ? static_cast<quint16>(p[0] | (p[1] << 8)) : be16(p);
+    }
+    quint32 u32(qint64 offset) const
+    {
+        const uchar *p = data + offset;
+        return little ? (quint32(p[3]) << 24) | (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | p[0] : be32(p);
+    }
+    double rational(qint64 offset) const
+    {
+        quint32 denominator = u32(offset + 4);
+        return denominator ? double(u32(offset)) / denominator : 0;
+    }
+    static int typeSize(int type);
+    void readIfd(qint64 offset, ImageMetadata &meta, IfdValues &values) const;
+
+    const uchar *data;
+    qint64 size;
+    bool little = false;
+};
+
+int TiffReader::typeSize(int type)
+{
+    switch (type) {
+    case 1: case 2: case 6: case 7: return 1;  // BYTE, ASCII, SBYTE, UNDEFINED
+    case 3: case 8: return 2;                  // SHORT, SSHORT
+    case 4: case 9: case 11: case 13: return 4; // LONG, SLONG, FLOAT, IFD
+    case 5: case 10: case 12: return 8;        // RATIONAL, SRATIONAL, DOUBLE
+    default: return 0;
+    }
+}
+
+void TiffReader::readIfd(qint64 offset, ImageMetadata &meta, IfdValues &values) const
+{
+    if (!has(offset, 2)) return;
+    int count = u16(offset);
+    for (int i = 0; i < count; ++i) {
+        qint64 entry = offset + 2 + qint64(i) * 12;
+        if (!has(entry, 12)) return;
+        quint16 tag = u16(entry);
+        quint16 type = u16(entry + 2);
+        qint64 length = qint64(u32(entry + 4)) * typeSize(type);
+        if (length <= 0) continue;
+        // Значения до 4 байт лежат прямо в записи, длинные - по смещению
+        qint64 value = length <= 4 ? entry + 8 : u32(entry + 8);
+        if (!has(value, length)) continue;
+
+        switch (tag) {
+        case 0x010F: if (type == 2) meta.make = asciiValue(data + value, length); break;
+        case 0x0110: if (type == 2) meta.model = asciiValue(data + value, length); break;
+        case 0x0131: if (type == 2) meta.software = asciiValue(data + value, length); break;
+        case 0x0132: if (type == 2) values.dateTime = asciiValue(data + value, length); break;
+        case 0x9003: if (type == 2) meta.captureTime = asciiValue(data + value, length); break;
+        case 0x0112:
+            if (type == 3 && u16(value) >= 1 && u16(value) <= 8) meta.orientation = u16(value);
+            break;
+        case 0x011A: if (type == 5) values.xResolution = rational(value); break;
+        case 0x011B: if (type == 5) values.yResolution = rational(value); break;
+        case 0x0128: if (type == 3) values.resolutionUnit = u16(value); break;
+        case 0x8769: if (type == 4 || type == 13) values.exifIfd = u32(value); break;
+        default: break;
+        }
+    }
+}
+
+bool TiffReader::parse(ImageMetadata &meta)
+{
+    if (!has(0, 8)) return false;
+    if (data[0] == 'I' && data[1] == 'I') little = true;
+    else if (data[0] != 'M' || data[1] != 'M') return false;
+    if (u16(2) != 42) return false;
+
+    IfdValues ifd0;
+    qint64 ifd0Offset = u32(4);
+    readIfd(ifd0Offset, meta, ifd0);
+    if (ifd0.exifIfd > 0 && ifd0.exifIfd != ifd0Offset) {
+        IfdValues exif;
+        readIfd(ifd0.exifIfd, meta, exif);
+    }
+    if (meta.captureTime.isEmpty()) meta.captureTime = ifd0.dateTime;
+
+    double perInch = ifd0.resolutionUnit == 3 ? 2.54 : (ifd0.resolutionUnit == 2 ? 1.0 : 0.0);
+    if (ifd0.xResolution > 0) meta.dpiX = static_cast<int>(ifd0.xResolution * perInch + 0.5);
+    if (ifd0.yResolution > 0) meta.dpiY = static_cast<int>(ifd0.yResolution * perInch + 0.5);
+    return true;
+}
+
+// Описание ICC-профиля: тег 'desc' (v2 textDescription или v4 mluc)
+QString iccDescription(const uchar *profile, qint64 size)
+{
+    if (size < 132 || std::memcmp(profile + 36, "acsp", 4) != 0) return QString();
+    quint32 tagCount = be32(profile + 128);
+    for (quint32 i = 0; i < tagCount && 132 + qint64(i + 1) * 12 <= size; ++i) {
+        const uchar *entry = profile + 132 + qint64(i) * 12;
+        if (std::memcmp(entry, "desc", 4) != 0) continue;
+
+        qint64 offset = be32(entry + 4);
+        qint64 length = be32(entry + 8);
+        if (length < 12 || offset + length > size) return QString();
+        const uchar *tag = profile + offset;
+
+        if (std::memcmp(tag, "desc", 4) == 0) {
+            qint64 count = qMin<qint64>(be32(tag + 8), length - 12);
+            return asciiValue(tag + 12, count);
+        }
+        if (std::memcmp(tag, "mluc", 4) == 0 && length >= 28 && be32(tag + 8) > 0) {
+            // Первая запись: строка UTF-16BE
+            qint64 textLength = be32(tag + 20);
+            qint64 textOffset = be32(tag + 24);
+            if (textOffset + textLength > length) return QString();
+            QString text;
+            text.reserve(static_cast<int>(textLength / 2));
+            for (qint64 k = 0; k + 1 < textLength; k += 2) {
+                quint16 unit = be16(tag + textOffset + k);
+                if (unit == 0) break;
+                text.append(QChar(unit));
+            }
+            return text.trimmed();
+        }
+        return QString();
+    }
+    return QString();
+}
+
+// Значение простого свойства XMP: атрибут name="..." или элемент <name>...</name>
+QString xmpProperty(const char *packet, qint64 size, const char *name)
+{
+    const char *end = packet + size;
+    const qint64 nameLength = static_cast<qint64>(std::strlen(name));
+    const char *it = packet;
+    while ((it = std::search(it, end, name, name + nameLength)) != end) {
+        const char *after = it + nameLength;
+        if (end - after > 2 && after[0] == '=' && (after[1] == '"' || after[1] == '\'')) {
+            const char *value = after + 2;
+            const char *close = std::find(value, end, after[1]);
+            if (close != end) return QString::fromUtf8(value, close - value).trimmed();
+        } else if (after < end && *after == '>' && it > packet && it[-1] == '<') {
+            const char *value = after + 1;
+            const char *close = std::find(value, end, '<');
+            if (close != end) return QString::fromUtf8(value, close - value).trimmed();
+        }
+        it = after;
+    }
+    return QString();
+}
+
+void readXmp(const uchar *data, qint64 size, ImageMetadata &meta)
+{
+    const char *packet = reinterpret_cast<const char *>(data);
+    meta.xmpBytes += size;
+    if (meta.software.isEmpty()) meta.software = xmpProperty(packet, size, "xmp:CreatorTool");
+    if (meta.captureTime.isEmpty()) meta.captureTime = xmpProperty(packet, size, "xmp:CreateDate");
+    if (meta.orientation == 0) {
+        int orientation = xmpProperty(packet, size, "tiff:Orientation").toInt();
+        if (orientation >= 1 && orientation <= 8) meta.orientation = orientation;
+    }
+}
+
+// Сжатый профиль iCCP - единственное, что приходится распаковывать в буфер
+std::vector<uchar> inflateProfile(const uchar *data, qint64 size)
+{
+    std::vector<uchar> out;
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) return out;
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+
+    int status = Z_OK;
+    while (status == Z_OK && out.size() < kMaxIccInflated) {
+        size_t used = out.size();
+        out.resize(used + kInflateStep);
+        stream.next_out = out.data() + used;
+        stream.avail_out = static_cast<uInt>(kInflateStep);
+        status = inflate(&stream, Z_NO_FLUSH);
+        out.resize(used + kInflateStep - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return out;
+}
+
+bool readJpegMetadata(FileView &view, ImageMetadata &meta)
+{
+    int jfifX = 0;
+    int jfifY = 0;
+    qint64 pos = 2;
+    while (pos + 4 <= view.size()) {
+        const uchar *marker = view.data(pos, 4);
+        if (!marker || marker[0] != 0xFF) break;
+
+        uchar code = marker[1];
+        if (code == 0xFF) {  // байт-заполнитель
+            pos++;
+            continue;
+        }
+        if (code == 0x01 || (code >= 0xD0 && code <= 0xD7)) {  // маркеры без длины
+            pos += 2;
+            continue;
+        }
+        if (code == 0xDA || code == 0xD9) break;  // начало скана или конец файла
+
+        int length = be16(marker + 2);
+        if (length < 2) break;
+
+        if (code >= 0xE0 && code <= 0xE2) {
+            // Указатель на сегмент целиком: до следующего data() его хватает на разбор
+            qint64 size = length - 2;
+            const uchar *segment = view.data(pos + 4, size);
+            if (!segment) break;
+
+            if (code == 0xE0 && startsWith(segment, size, "JFIF\0", 5) && size >= 12) {
+                int units = segment[7];
+                double perInch = units == 1 ? 1.0 : (units == 2 ? 2.54 : 0.0);
+                jfifX = static_cast<int>(be16(segment + 8) * perInch + 0.5);
+                jfifY = static_cast<int>(be16(segment + 10) * perInch + 0.5);
+            } else if (code == 0xE1 && startsWith(segment, size, "Exif\0\0", 6)) {
+                if (TiffReader(segment + 6, size - 6).parse(meta)) meta.exifBytes = size - 6;
+            } else if (code == 0xE1 && startsWith(segment, size, kXmpSignature, sizeof(kXmpSignature))) {
+                readXmp(segment + sizeof(kXmpSignature), size - qint64(sizeof(kXmpSignature)), meta);
+            } else if (code == 0xE2 && startsWith(segment, size, "ICC_PROFILE\0", 12) && size > 14) {
+                // Профиль режется на куски по 64 КБ; заголовок и таблица тегов - в первом
+                meta.iccBytes += size - 14;
+                if (segment[12] == 1) meta.iccDescription = iccDescription(segment + 14, size - 14);
+            }
+        }
+        pos += 2 + length;
+    }
+
+    if (meta.dpiX == 0 && meta.dpiY == 0) {
+        meta.dpiX = jfifX;
+        meta.dpiY = jfifY;
+    }
+    return !meta.isEmpty();
+}
+
+bool readPngMetadata(FileView &view, ImageMetadata &meta)
+{
+    qint64 pos = 8;
+    while (pos + 8 <= view.size()) {
+        const uchar *header = view.data(pos, 8);
+        if (!header) break;
+        qint64 length = be32(header);
+        char type[4];
+        std::memcpy(type, header + 4, 4);  // header станет недействительным после следующего data()
+        if (std::memcmp(type, "IDAT", 4) == 0 || std::memcmp(type, "IEND", 4) == 0) break;
+
+        bool wanted = std::memcmp(type, "pHYs", 4) == 0 || std::memcmp(type, "eXIf", 4) == 0
+                      || std::memcmp(type, "iTXt", 4) == 0 || std::memcmp(type, "iCCP", 4) == 0;
+        if (wanted && length <= kMaxChunk) {
+            const uchar *chunk = view.data(pos + 8, length);
+            if (!chunk) break;
+
+            if (std::memcmp(type, "pHYs", 4) == 0 && length >= 9 && chunk[8] == 1) {
+                // Точек на метр
+                meta.dpiX = static_cast<int>(be32(chunk) * 0.0254 + 0.5);
+                meta.dpiY = static_cast<int>(be32(chunk + 4) * 0.0254 + 0.5);
+            } else if (std::memcmp(type, "eXIf", 4) == 0) {
+                // Разрешение из EXIF не перекрывает pHYs: оно относится к исходной съёмке
+                int dpiX = meta.dpiX;
+                int dpiY = meta.dpiY;
+                if (TiffReader(chunk, length).parse(meta)) meta.exifBytes = length;
+                if (dpiX || dpiY) {
+                    meta.dpiX = dpiX;
+                    meta.dpiY = dpiY;
+                }
+            } else if (std::memcmp(type, "iTXt", 4) == 0
+                       && startsWith(chunk, length, kXmpKeyword, sizeof(kXmpKeyword)) ) {
+                // Ключ, флаг сжатия, метод, язык\0, переведённый ключ\0, текст
+                qint64 at = sizeof(kXmpKeyword);
+                bool compressed = at < length && chunk[at] != 0;
+                at += 2;
+                for (int skip = 0; skip < 2 && at < length; ++skip) {
+                    const uchar *zero = static_cast<const uchar *>(std::memchr(chunk + at, 0, length - at));
+                    at = zero ? zero - chunk + 1 : length;
+                }
+                if (compressed) meta.xmpBytes += length - at;
+                else if (at < length) readXmp(chunk + at, length - at, meta);
+            } else if (std::memcmp(type, "iCCP", 4) == 0) {
+                const uchar *zero = static_cast<const uchar *>(std::memchr(chunk, 0, qMin<qint64>(length, 80)));
+                if (zero && zero + 2 <= chunk + length) {
+                    std::vector<uchar> profile = inflateProfile(zero + 2, chunk + length - (zero + 2));
+                    meta.iccBytes = static_cast<qint64>(profile.size());
+                    meta.iccDescription = iccDescription(profile.data(), meta.iccBytes);
+                    // Без описания в профиле остаётся имя из самого чанка
+                    if (meta.iccDescription.isEmpty()) meta.iccDescription = asciiValue(chunk, zero - chunk);
+                }
+            }
+        }
+        pos += 8 + length + 4;  // данные и CRC
+    }
+    return !meta.isEmpty();
+}
+
+}
+
+bool readImageMetadata(FileView &view, ImageMetadata &meta)
+{
+    const uchar *signature = view.data(0, 8);
+    if (signature && std::memcmp(signature, "\x89PNG\r\n\x1a\n", 8) == 0) return readPngMetadata(view, meta);
+    signature = view.data(0, 2);
+    if (signature && signature[0] == 0xFF && signature[1] == 0xD8) return readJpegMetadata(view, meta);
+    return false;
+}
+
+QString orientationName(int orientation)
+{
+    switch (orientation) {
+    case 1: return "обычная";
+    case 2: return "отражено по горизонтали";
+    case 3: return "повёрнуто на 180°";
+    case 4: return "отражено по вертикали";
+    case 5: return "отражено и повёрнуто на 90° против часовой";
+    case 6: return "повёрнуто на 90° по часовой";
+    case 7: return "отражено и повёрнуто на 90° по часовой";
+    case 8: return "повёрнуто на 90° против часовой";
+    default: return "не указана";
+    }
+}
+
+QString formatMetadata(const ImageMetadata &meta)
+{
+    if (meta.isEmpty()) return "Метаданных нет";
+
+    QStringList lines;
+    if (!meta.make.isEmpty() || !meta.model.isEmpty())
+        lines << "Камера: " + QStringList({meta.make, meta.model}).join(' ').trimmed();
+    if (!meta.captureTime.isEmpty()) lines << "Дата съёмки: " + meta.captureTime;
+    if (!meta.software.isEmpty()) lines << "Программа: " + meta.software;
+    lines << "Ориентация: " + orientationName(meta.orientation);
+    if (meta.dpiX || meta.dpiY) lines << QString("Разрешение: %1 x %2 DPI").arg(meta.dpiX).arg(meta.dpiY);
+    if (meta.iccBytes) {
+        lines << QString("ICC-профиль: %1 (%2 байт)")
+                     .arg(meta.iccDescription.isEmpty() ? "без описания" : meta.iccDescription)
+                     .arg(meta.iccBytes);
+    }
+    if (meta.exifBytes) lines << QString("EXIF: %1 байт").arg(meta.exifBytes);
+    if (meta.xmpBytes) lines << QString("XMP: %1 байт").arg(meta.xmpBytes);
+    return lines.join('\n');
+}
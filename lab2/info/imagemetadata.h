@@ -0,0 +1,34 @@
+#ifndef IMAGEMETADATA_H
+#define IMAGEMETADATA_H
+
+#include <QString>
+
+class FileView;
+
+// Метаданные из заголовочных сегментов: EXIF, XMP и описание ICC-профиля
+struct ImageMetadata {
+    int orientation = 0;        // EXIF Orientation 1..8, 0 - не указана
+    QString make;               // производитель камеры
+    QString model;
+    QString software;           // EXIF Software или xmp:CreatorTool
+    QString captureTime;        // DateTimeOriginal ("ГГГГ:ММ:ДД чч:мм:сс") или xmp:CreateDate
+    int dpiX = 0;               // EXIF XResolution, JFIF или pHYs; 0 - не указано
+    int dpiY = 0;
+    qint64 exifBytes = 0;       // размер блока EXIF, 0 - нет
+    qint64 xmpBytes = 0;        // размер пакета XMP, 0 - нет
+    QString iccDescription;     // описание встроенного ICC-профиля
+    qint64 iccBytes = 0;
+
+    bool isEmpty() const { return exifBytes == 0 && xmpBytes == 0 && iccBytes == 0 && dpiX == 0 && dpiY == 0; }
+};
+
+// Разбор сегментов JPEG (APP0 JFIF, APP1 EXIF/XMP, APP2 ICC) и чанков PNG
+// (pHYs, eXIf, iTXt XMP, iCCP) до начала данных изображения. Значения тегов
+// читаются прямо из байтов view без промежуточных буферов; распаковывается
+// только сжатый профиль iCCP. false - не JPEG/PNG или метаданных нет
+bool readImageMetadata(FileView &view, ImageMetadata &meta);
+
+QString orientationName(int orientation);
+QString formatMetadata(const ImageMetadata &meta);
+
+#endif // IMAGEMETADATA_H
@@ -0,0 +1,420 @@
+#include "imagescanner.h"
+#include "dirwalker.h"
+#include "imagehash.h"
+#include "archivereader.h"
+#include "integritycheck.h"
+#include "probeworker.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+
+const int kMaxBatch = 512;       // строк за один такт интерфейса
+const int kMaxPending = 4096;    // готовых результатов, ожидающих интерфейс
+const int kDeliverIntervalMs = 50;
+const int kWaitStepMs = 5;       // шаг ожидания семафоров с проверкой отмены
+const int kCorpusTicks = 10;     // сводка сливается раз в 500 мс
+const int kMaxUrgent = 512;      // дальше - строки, давно ушедшие с экрана
+const int kMaxQueued = 65536;    // не взятых файлов, дальше обход ждёт воркеров
+
+std::atomic<int> nextThreadSlot{0};
+
+// Постоянный номер потока пула: по нему выбирается часть сводки
+int threadSlot()
+{
+    static thread_local int slot = nextThreadSlot.fetch_add(1);
+    return slot;
+}
+
+}
+
+ImageScanner::ImageScanner(QObject *parent)
+    : QObject(parent)
+{
+    deliverTimer.setInterval(kDeliverIntervalMs);
+    connect(&deliverTimer, &QTimer::timeout, this, &ImageScanner::deliver);
+}
+
+ImageScanner::~ImageScanner()
+{
+    cancel();
+    waitForThread();
+}
+
+qint64 ImageScanner::filesFound() const
+{
+    return walker ? walker->filesFound() : 0;
+}
+
+void ImageScanner::start(const QString &folder, const ScanOptions &scanOptions)
+{
+    cancel();
+    waitForThread();
+    deliverTimer.stop();
+
+    options = scanOptions;
+    int threads = options.threads > 0 ? options.threads : QThread::idealThreadCount();
+    pool.setMaxThreadCount(threads);
+
+    cancelled.store(false);
+    workersDone.store(false);
+    pending.clear();
+    // После отмены часть мест могла остаться занятой снятыми задачами
+    pendingSlots.acquire(pendingSlots.available());
+    pendingSlots.release(kMaxPending);
+
+    entries.clear();
+    untaken = 0;
+    archives.clear();
+    urgent.clear();
+    firstEntry = 0;
+    nextInOrder = 0;
+    diskOrder.clear();
+    nextOnDisk = 0;
+    emittedEntries = 0;
+    walkDone = false;
+    rowOfEntry.clear();
+    entryOfRow.clear();
+
+    corpusShards.clear();
+    for (int i = 0; i < threads; ++i) corpusShards.push_back(std::make_unique<CorpusShard>());
+    deliverTicks = 0;
+
+    delete walker;
+    QStringList filters = supportedImageNameFilters();
+    if (options.archives) filters += archiveNameFilters();
+    walker = new DirWalker(filters, options.walkerThreads);
+    walker->setStats(options.stats);
+
+    running = true;
+    // Воркеры сами выбирают из очереди следующий файл: так видимые строки
+    // обгоняют всё, что обход нашёл раньше
+    for (int i = 0; i < threads; ++i) pool.start([this]() { workerLoop(); });
+    walkThread = QThread::create([this, folder]() {
+        walker->walk(folder, [this](const QString &filePath) {
+            if (cancelled.load()) return false;
+            enqueue(filePath);
+            return true;
+        });
+        if (options.order != ScanOrder::Walk && !cancelled.load()) sortQueue();
+        {
+            QMutexLocker locker(&queueMutex);
+            walkDone = true;
+        }
+        queueReady.wakeAll();
+        pool.waitForDone();
+        workersDone.store(true);
+    });
+    walkThread->start();
+    deliverTimer.start();
+}
+
+void ImageScanner::cancel()
+{
+    if (!running) return;
+    {
+        // Под мьютексом очереди: воркер не пропустит пробуждение между проверкой и ожиданием
+        QMutexLocker locker(&queueMutex);
+        cancelled.store(true);
+    }
+    if (walker) walker->cancel();
+    queueReady.wakeAll();
+    queueSpace.wakeAll();
+}
+
+void ImageScanner::enqueue(const QString &filePath)
+{
+    // stat и FIEMAP - в потоке обхода, вне мьютекса очереди
+    DiskOrderKey key;
+    if (options.order != ScanOrder::Walk && !isArchiveFile(filePath)) key = diskOrderKey(filePath, options.order);
+    {
+        QMutexLocker locker(&queueMutex);
+        if (isArchiveFile(filePath)) {
+            archives.push_back(filePath);
+        } else {
+            // Обратное давление на обход: при разборе в порядке обхода очередь не растёт
+            // без предела. Для порядка на диске нужен весь список, там не ждём
+            while (options.order == ScanOrder::Walk && untaken >= kMaxQueued && !cancelled.load())
+                queueSpace.wait(&queueMutex);
+            entries.push_back({filePath, false, key});
+            ++untaken;
+        }
+    }
+    // До конца обхода с сортировкой воркеры берут только видимые строки
+    if (options.order == ScanOrder::Walk) queueReady.wakeOne();
+}
+
+void ImageScanner::sortQueue()
+{
+    QElapsedTimer sortTimer;
+    sortTimer.start();
+    // Ключи копируем под мьютексом, а сортируем без него - поток интерфейса не ждёт
+    QVector<DiskOrderKey> keys;
+    int first = 0;
+    {
+        QMutexLocker locker(&queueMutex);
+        first = firstEntry;
+        keys.reserve(static_cast<int>(entries.size()));
+        for (const Entry &queued : entries) keys.append(queued.key);
+    }
+    QVector<int> order = diskOrderPermutation(keys);
+    for (int &entry : order) entry += first;
+    {
+        QMutexLocker locker(&queueMutex);
+        diskOrder.swap(order);
+        nextOnDisk = 0;
+    }
+    if (options.stats) options.stats->setScanOrder(scanOrderName(options.order), sortTimer.elapsed());
+}
+
+void ImageScanner::prioritize(int row)
+{
+    if (!running || row < 0 || row >= entryOfRow.size()) return;
+    int entry = entryOfRow[row];
+    if (entry < 0) return;
+
+    QMutexLocker locker(&queueMutex);
+    if (entry < firstEntry || entries[entry - firstEntry].taken) return;
+    // Уже ждёт в стеке - поднимаем наверх
+    int at = urgent.lastIndexOf(entry);
+    if (at == urgent.size() - 1 && at >= 0) return;
+    if (at >= 0) urgent.remove(at);
+    urgent.append(entry);
+    if (urgent.size() > kMaxUrgent) urgent.removeFirst();
+    // При разборе по порядку на диске воркеры могут ждать конца обхода
+    queueReady.wakeOne();
+}
+
+bool ImageScanner::takeNext(QString &filePath, int &entry)
+{
+    QMutexLocker locker(&queueMutex);
+    for (;;) {
+        if (cancelled.load()) return false;
+
+        auto take = [&](int candidate) {
+            Entry &queued = entries[candidate - firstEntry];
+            if (queued.taken) return false;
+            queued.taken = true;
+            if (--untaken < kMaxQueued) queueSpace.wakeAll();
+            filePath = queued.filePath;
+            if (candidate < emittedEntries) queued.filePath.clear();
+            entry = candidate;
+            return true;
+        };
+
+        // Сначала видимые строки, начиная с последней запрошенной
+        while (!urgent.isEmpty()) {
+            int candidate = urgent.takeLast();
+            if (candidate >= firstEntry && take(candidate)) return true;
+        }
+        if (options.order == ScanOrder::Walk) {
+            nextInOrder = qMax(nextInOrder, firstEntry);
+            while (nextInOrder < firstEntry + static_cast<int>(entries.size())) {
+                if (take(nextInOrder++)) return true;
+            }
+        } else {
+            // Порядок на диске известен только после обхода, до того ждём видимые строки
+            while (nextOnDisk < diskOrder.size()) {
+                int candidate = diskOrder[nextOnDisk++];
+                if (candidate >= firstEntry && take(candidate)) return true;
+            }
+            if (!walkDone) {
+                queueReady.wait(&queueMutex);
+                continue;
+            }
+        }
+        if (!archives.empty()) {
+            filePath = archives.front();
+            archives.pop_front();
+            entry = -1;
+            return true;
+        }
+        if (walkDone) return false;
+        queueReady.wait(&queueMutex);
+    }
+}
+
+void ImageScanner::workerLoop()
+{
+    QString filePath;
+    int entry = -1;
+    // Процесс создаётся в этом потоке и живёт, пока поток разбирает очередь
+    std::unique_ptr<ProbeProcess> process;
+    if (options.isolate) process = std::make_unique<ProbeProcess>(options.probeTimeoutMs, &cancelled);
+    while (takeNext(filePath, entry)) probe(filePath, entry, process.get());
+}
+
+void ImageScanner::probe(const QString &filePath, int entry, ProbeProcess *process)
+{
+    if (isArchiveFile(filePath)) {
+        // Изображения архива разбираются по одному открытию и выдаются новыми строками
+        scanArchiveImages(filePath, [this](const QString &memberPath, ImageInfo &info, StageTimings &timings) {
+            if (!cancelled.load()) push({memberPath, info, timings});
+        });
+        return;
+    }
+
+    ScanItem item;
+    item.filePath = filePath;
+    item.row = entry;  // пока номер в очереди, строку таблицы подставит deliver()
+
+    if (process) {
+        ProbeRequest request;
+        request.filePath = filePath;
+        request.tasks = ProbeHeader | (options.hashing ? ProbeHash : 0) | (options.integrity ? ProbeVerify : 0)
+                        | (options.colors ? ProbeColors : 0) | (options.recompressQuality > 0 ? ProbeRecompress : 0);
+        request.recompressQuality = options.recompressQuality;
+        ProbeProcess::Outcome outcome = process->run(request, item.info, item.timings);
+        if (outcome == ProbeProcess::Cancelled) return;
+        if (outcome != ProbeProcess::Unavailable) {
+            if (outcome != ProbeProcess::Done) {
+                markProbeFailure(filePath, item.info, outcome);
+                emit probeFailed(filePath, probeOutcomeName(outcome));
+            }
+            push(std::move(item));
+            return;
+        }
+        // Воркер не запустился - разбираем здесь, как без изоляции
+    }
+
+    // Только заголовок: детали досчитываются для видимых строк (DetailLoader)
+    item.info = getImageHeaderInfo(filePath, &item.timings);
+    if (options.hashing && !cancelled.load()) {
+        QElapsedTimer hashTimer;
+        hashTimer.start();
+        computeImageHashes(filePath, item.info);
+        item.timings[ScanStage::Hash] = hashTimer.nsecsElapsed();
+    }
+    // Воркеры проверяют разные файлы одновременно - проверка параллельна по файлам
+    if (options.integrity && !cancelled.load()) {
+        QElapsedTimer verifyTimer;
+        verifyTimer.start();
+        verifyImageIntegrity(filePath, item.info);
+        item.timings[ScanStage::Verify] = verifyTimer.nsecsElapsed();
+    }
+    // Статистика считается тут же, в потоке пула: отдельный проход по архиву потом дороже
+    if (options.colors && !cancelled.load()) {
+        QElapsedTimer colorTimer;
+        colorTimer.start();
+        computeColorStats(filePath, item.info.colors);
+        item.timings[ScanStage::Colors] = colorTimer.nsecsElapsed();
+    }
+    // Оценки по выборке плиток; файлы оцениваются параллельно всеми потоками пула
+    if (options.recompressQuality > 0 && !cancelled.load()) {
+        QElapsedTimer recompressTimer;
+        recompressTimer.start();
+        estimateRecompression(filePath, options.recompressQuality, item.info.recompress);
+        item.timings[ScanStage::Recompress] = recompressTimer.nsecsElapsed();
+    }
+    push(std::move(item));
+}
+
+void ImageScanner::push(ScanItem &&item)
+{
+    while (!pendingSlots.tryAcquire(1, kWaitStepMs))
+        if (cancelled.load()) return;
+
+    {
+        CorpusShard &shard = *corpusShards[threadSlot() % corpusShards.size()];
+        QMutexLocker locker(&shard.mutex);
+        shard.stats.add(item.filePath, item.info);
+    }
+
+    QMutexLocker locker(&pendingMutex);
+    pending.append(std::move(item));
+}
+
+void ImageScanner::deliverQueued()
+{
+    QStringList filePaths;
+    int first = 0;
+    {
+        QMutexLocker locker(&queueMutex);
+        first = emittedEntries;
+        int end = firstEntry + static_cast<int>(entries.size());
+        for (int entry = emittedEntries; entry < end; ++entry) {
+            Entry &queued = entries[entry - firstEntry];
+            filePaths.append(queued.filePath);
+            if (queued.taken) queued.filePath.clear();
+        }
+        emittedEntries = end;
+        // Голова очереди, уже и взятая, и выданная, больше не нужна
+        while (!entries.empty() && entries.front().taken && firstEntry < emittedEntries) {
+            entries.pop_front();
+            ++firstEntry;
+        }
+    }
+
+    for (int i = 0; i < filePaths.size(); ++i) {
+        rowOfEntry.push_back(entryOfRow.size());
+        entryOfRow.append(first + i);
+    }
+    if (!filePaths.isEmpty() && !cancelled.load()) emit filesQueued(filePaths);
+}
+
+void ImageScanner::deliver()
+{
+    // Порядок важен: флаг читаем до того, как забрать очередь,
+    // иначе можно потерять результаты, добавленные в последний момент
+    bool done = workersDone.load();
+
+    QVector<ScanItem> batch;
+    {
+        QMutexLocker locker(&pendingMutex);
+        if (pending.size() <= kMaxBatch) {
+            batch.swap(pending);
+        } else {
+            batch = pending.mid(0, kMaxBatch);
+            pending.remove(0, kMaxBatch);
+        }
+    }
+
+    // Заготовки забираем после результатов: строка каждого файла из пачки уже заведена
+    deliverQueued();
+    for (ScanItem &item : batch) {
+        if (item.row >= 0) {
+            item.row = rowOfEntry[item.row];
+        } else {
+            entryOfRow.append(-1);  // изображение из архива встаёт в конец таблицы
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        pendingSlots.release(batch.size());
+        if (!cancelled.load()) emit batchReady(batch);
+    }
+    if (++deliverTicks % kCorpusTicks == 0) collectCorpus();
+
+    if (done && batch.size() < kMaxBatch) {
+        QMutexLocker locker(&pendingMutex);
+        if (!pending.isEmpty()) return;  // дошлём на следующем такте
+        locker.unlock();
+
+        deliverTimer.stop();
+        waitForThread();
+        collectCorpus();
+        running = false;
+        emit finished(cancelled.load());
+    }
+}
+
+void ImageScanner::collectCorpus()
+{
+    CorpusStats delta;
+    for (const auto &shard : corpusShards) {
+        QMutexLocker locker(&shard->mutex);
+        if (shard->stats.isEmpty()) continue;
+        delta.merge(shard->stats);
+        shard->stats.clear();
+    }
+    if (!delta.isEmpty() && !cancelled.load()) emit corpusUpdated(delta);
+}
+
+void ImageScanner::waitForThread()
+{
+    if (!walkThread) return;
+    walkThread->wait();
+    delete walkThread;
+    walkThread = nullptr;
+}
@@ -0,0 +1,153 @@
+#ifndef IMAGESCANNER_H
+#define IMAGESCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "corpusstats.h"
+#include "diskorder.h"
+#include "imageinfo.h"
+#include "scanstats.h"
+
+class DirWalker;
+class ProbeProcess;
+
+// Результат разбора одного файла, передаваемый в интерфейс пачкой
+struct ScanItem {
+    QString filePath;
+    ImageInfo info;
+    StageTimings timings;
+    int row = -1;  // строка, заведённая по filesQueued; -1 - новая строка (изображение из архива)
+};
+
+struct ScanOptions {
+    int threads = 0;           // 0 - по числу ядер
+    int walkerThreads = 4;
+    bool hashing = false;      // перцептивный хеш и хеш содержимого
+    bool archives = false;     // заглядывать в ZIP и TAR
+    bool integrity = false;    // проверять целостность JPEG, PNG, BMP, TIFF (читает файлы целиком)
+    bool colors = false;       // цветовая статистика по уменьшенному декодированию (см. colorstats.h)
+    int recompressQuality = 0; // > 0 - оценить пересжатие в PNG, JPEG с этим качеством и WebP (см. recompress.h)
+    bool isolate = false;      // разбирать в процессах-воркерах (см. ProbeProcess), по одному на поток
+    int probeTimeoutMs = 10000; // сколько ждать ответа воркера по одному файлу
+    ScanOrder order = ScanOrder::Walk; // иначе разбор - после обхода, по положению файлов на диске
+    ScanStats *stats = nullptr;
+};
+
+// Фоновое сканирование папки: обход, разбор в пуле потоков и выдача
+// результатов пачками в поток интерфейса. Найденные файлы сразу приходят
+// строками-заготовками (filesQueued, флаг ImagePending), разобранные - пачками
+// с номером своей строки. Интерфейс получает не больше kMaxBatch результатов
+// за такт таймера, а воркеры ждут, пока готовых, но ещё не выданных
+// результатов больше kMaxPending (обратное давление). Обход так же ждёт,
+// пока в очереди больше kMaxQueued не взятых файлов (кроме порядка на диске).
+// Очередь разбора приоритетная: строки, которые видны на экране, поднимаются
+// через prioritize() и разбираются раньше остальных (LIFO, как у миниатюр),
+// прочие - в порядке обхода, архивы - последними.
+// С options.order, отличным от Walk, ключ положения на диске снимается при
+// обходе, а разбор (кроме видимых строк) ждёт конца обхода и идёт по ключам:
+// на HDD и ленточных архивах чтение становится почти последовательным.
+// Строки таблицы при этом остаются в порядке обхода.
+// cancel() останавливает обход и воркеры; не взятые файлы остаются заготовками.
+// С options.isolate каждый поток пула разбирает файлы через свой процесс-воркер:
+// файл, на котором воркер упал или завис, приходит строкой с ImageCorrupt и
+// отдельно сигналом probeFailed, а воркер перезапускается. Архивы и в этом
+// режиме разбираются в своём процессе.
+// Сводка по набору копится воркерами в своих частях и раз в kCorpusTicks
+// тактов приходит в интерфейс приращением (corpusUpdated).
+class ImageScanner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ImageScanner(QObject *parent = nullptr);
+    ~ImageScanner();
+
+    void start(const QString &folder, const ScanOptions &options);
+    void cancel();
+    bool isRunning() const { return running; }
+
+    // Строка таблицы видна - разобрать её файл следующим. Номера строк считаются
+    // от пустой таблицы, как их заводят filesQueued и batchReady. Только из потока интерфейса
+    void prioritize(int row);
+
+    qint64 filesFound() const;
+
+signals:
+    // Перед первым результатом: новые строки-заготовки в порядке обхода
+    void filesQueued(const QStringList &filePaths);
+    void batchReady(const QVector<ScanItem> &items);
+    void corpusUpdated(const CorpusStats &delta);
+    void probeFailed(const QString &filePath, const QString &reason);
+    void finished(bool cancelled);
+
+private:
+    // Файл в очереди разбора; номер в очереди - firstEntry + позиция в entries
+    struct Entry {
+        QString filePath;  // очищается, когда файл и взят, и выдан заготовкой
+        bool taken = false;
+        DiskOrderKey key;  // только при options.order != Walk
+    };
+
+    void enqueue(const QString &filePath);
+    void sortQueue();
+    bool takeNext(QString &filePath, int &entry);
+    void workerLoop();
+    void probe(const QString &filePath, int entry, ProbeProcess *process);
+    void push(ScanItem &&item);
+    void deliverQueued();
+    void deliver();
+    void collectCorpus();
+    void waitForThread();
+
+    ScanOptions options;
+    QThreadPool pool;
+    QThread *walkThread = nullptr;
+    DirWalker *walker = nullptr;
+    QTimer deliverTimer;
+
+    QMutex pendingMutex;
+    QVector<ScanItem> pending;
+    QSemaphore pendingSlots;      // свободные места для готовых результатов
+
+    QMutex queueMutex;
+    QWaitCondition queueReady;
+    QWaitCondition queueSpace;    // обход ждёт, пока не взятых файлов не меньше kMaxQueued
+    std::deque<Entry> entries;    // от первого не выданного или не взятого файла
+    int firstEntry = 0;
+    int untaken = 0;              // файлов в entries, ещё не взятых воркерами
+    int nextInOrder = 0;          // первый не взятый файл в порядке обхода
+    QVector<int> diskOrder;       // номера файлов по положению на диске (после обхода)
+    int nextOnDisk = 0;
+    int emittedEntries = 0;       // сколько файлов выдано заготовками
+    QVector<int> urgent;          // номера файлов видимых строк, вершина - самый свежий
+    std::deque<QString> archives; // разбираются после обычных файлов
+    bool walkDone = false;
+
+    // Только поток интерфейса: номера строк таблицы для файлов очереди и обратно
+    std::vector<int> rowOfEntry;
+    QVector<int> entryOfRow;      // -1 - строка изображения из архива
+
+    // Частичные сводки: поток пула пишет в свою часть, мьютекс почти не конкурирует
+    struct CorpusShard {
+        QMutex mutex;
+        CorpusStats stats;
+    };
+    std::vector<std::unique_ptr<CorpusShard>> corpusShards;
+    int deliverTicks = 0;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> workersDone{false};
+    bool running = false;
+};
+
+#endif // IMAGESCANNER_H
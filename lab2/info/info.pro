@@ -8,14 +8,24 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(scanner.pri)
+
 SOURCES += \
-    imageinfo.cpp \
     main.cpp \
-    mainwindow.cpp
+    corpusstats.cpp \
+    detailloader.cpp \
+    imagescanner.cpp \
+    mainwindow.cpp \
+    scanresultmodel.cpp \
+    thumbnailcache.cpp
 
 HEADERS += \
-    imageinfo.h \
-    mainwindow.h
+    corpusstats.h \
+    detailloader.h \
+    imagescanner.h \
+    mainwindow.h \
+    scanresultmodel.h \
+    thumbnailcache.h
 
 FORMS += \
     mainwindow.ui
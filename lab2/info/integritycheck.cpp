@@ -0,0 +1,302 @@
+#include "integritycheck.h"
+#include "archivereader.h"
+#include "crc32.h"
+#include "fileview.h"
+#include <QByteArray>
+#include <QSet>
+#include <QVector>
+#include <cstring>
+
+namespace {
+
+const qint64 kWindow = 1 << 20;   // порция чтения при проходе по файлу
+const int kMaxTiffIfds = 256;     // защита от зацикленных цепочек IFD
+
+quint16 be16(const uchar *p)
+{
+    return static_cast<quint16>((p[0] << 8) | p[1]);
+}
+
+quint32 be32(const uchar *p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3];
+}
+
+quint16 le16(const uchar *p)
+{
+    return static_cast<quint16>(p[0] | (p[1] << 8));
+}
+
+quint32 le32(const uchar *p)
+{
+    return (quint32(p[3]) << 24) | (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | p[0];
+}
+
+// Смещение следующего маркера после энтропийных данных скана или -1, если файл кончился.
+// FF 00 - байт данных, FF D0..D7 - рестарт внутри скана, FF FF - заполнитель
+qint64 findScanEnd(FileView &view, qint64 pos)
+{
+    const qint64 size = view.size();
+    while (pos < size - 1) {
+        qint64 length = qMin(kWindow, size - pos);
+        const uchar *window = view.data(pos, length);
+        if (!window) return -1;
+        qint64 i = 0;
+        while (i < length - 1) {
+            const void *hit = std::memchr(window + i, 0xFF, static_cast<size_t>(length - 1 - i));
+            if (!hit) {
+                i = length - 1;
+                break;
+            }
+            i = static_cast<const uchar *>(hit) - window;
+            uchar next = window[i + 1];
+            if (next == 0x00 || (next >= 0xD0 && next <= 0xD7)) i += 2;
+            else if (next == 0xFF) i += 1;
+            else return pos + i;
+        }
+        pos += i;  // последний байт окна смотрим вместе со следующим
+    }
+    return -1;
+}
+
+IntegrityStatus checkJpeg(FileView &view)
+{
+    const qint64 size = view.size();
+    const uchar *soi = view.data(0, 2);
+    if (!soi || soi[0] != 0xFF || soi[1] != 0xD8) return IntegrityStatus::BadJpegMarker;
+
+    qint64 pos = 2;
+    while (true) {
+        const uchar *m = view.data(pos, 2);
+        if (!m) return IntegrityStatus::MissingEoi;
+        if (m[0] != 0xFF) return IntegrityStatus::BadJpegMarker;
+        uchar marker = m[1];
+        if (marker == 0xFF) {  // заполнитель перед маркером
+            ++pos;
+            continue;
+        }
+        pos += 2;
+        if (marker == 0xD9) return IntegrityStatus::Ok;
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;  // без длины
+        if (marker == 0xD8 || marker == 0x00) return IntegrityStatus::BadJpegMarker;
+
+        const uchar *len = view.data(pos, 2);
+        if (!len) return IntegrityStatus::MissingEoi;
+        qint64 length = be16(len);
+        if (length < 2) return IntegrityStatus::BadJpegMarker;
+        if (pos + length > size) return IntegrityStatus::MissingEoi;
+        pos += length;
+
+        // После SOS идут энтропийные данные до следующего маркера (DHT, SOS, EOI, ...)
+        if (marker == 0xDA) {
+            pos = findScanEnd(view, pos);
+            if (pos < 0) return IntegrityStatus::MissingEoi;
+        }
+    }
+}
+
+IntegrityStatus checkPng(FileView &view)
+{
+    static const uchar signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    const qint64 size = view.size();
+    const uchar *head = view.data(0, 8);
+    if (!head || std::memcmp(head, signature, 8) != 0) return IntegrityStatus::ChunkTruncated;
+
+    qint64 pos = 8;
+    while (pos < size) {
+        const uchar *chunk = view.data(pos, 8);
+        if (!chunk) return IntegrityStatus::ChunkTruncated;
+        quint32 length = be32(chunk);
+        bool end = std::memcmp(chunk + 4, "IEND", 4) == 0;
+        if (length > 0x7FFFFFFFu || pos + 12 + qint64(length) > size) return IntegrityStatus::ChunkTruncated;
+
+        // CRC считается по типу и данным; данные читаем окнами
+        quint32 crc = crc32Update(0, chunk + 4, 4);
+        qint64 offset = pos + 8;
+        qint64 left = length;
+        while (left > 0) {
+            qint64 step = qMin(kWindow, left);
+            const uchar *data = view.data(offset, step);
+            if (!data) return IntegrityStatus::ChunkTruncated;
+            crc = crc32Update(crc, data, step);
+            offset += step;
+            left -= step;
+        }
+        const uchar *stored = view.data(offset, 4);
+        if (!stored) return IntegrityStatus::ChunkTruncated;
+        if (be32(stored) != crc) return IntegrityStatus::ChunkCrc;
+
+        if (end) return IntegrityStatus::Ok;  // данные после IEND не проверяем
+        pos = offset + 4;
+    }
+    return IntegrityStatus::MissingIend;
+}
+
+IntegrityStatus checkBmp(FileView &view)
+{
+    const qint64 size = view.size();
+    const uchar *h = view.data(0, 26);
+    if (!h || h[0] != 'B' || h[1] != 'M') return IntegrityStatus::Unchecked;
+
+    quint32 declaredSize = le32(h + 2);
+    qint64 dataOffset = le32(h + 10);
+    quint32 dibSize = le32(h + 14);
+
+    qint64 width = 0;
+    qint64 height = 0;
+    int bitCount = 0;
+    quint32 compression = 0;
+    qint64 imageSize = 0;
+    if (dibSize == 12) {  // BITMAPCOREHEADER
+        width = le16(h + 18);
+        height = le16(h + 20);
+        bitCount = le16(h + 24);
+    } else {
+        const uchar *info = view.data(0, 38);
+        if (!info) return IntegrityStatus::DataPastEnd;
+        width = qint32(le32(info + 18));
+        height = qint32(le32(info + 22));
+        bitCount = le16(info + 28);
+        compression = le32(info + 30);
+        imageSize = le32(info + 34);
+    }
+
+    if (declaredSize > size || dataOffset > size) return IntegrityStatus::DataPastEnd;
+    const qint64 available = size - dataOffset;
+
+    // BI_RGB и BI_BITFIELDS - строки, выровненные на 4 байта; у сжатых берём biSizeImage.
+    // Ширина, высота и глубина из файла произвольные: строка умещается в qint64
+    // (2^31 * 65535 бит), а её произведение с высотой - нет, поэтому сравниваем делением
+    if (compression == 0 || compression == 3) {
+        qint64 rowBytes = (qAbs(width) * bitCount + 31) / 32 * 4;
+        qint64 rows = qAbs(height);
+        if (rows > 0 && rowBytes > available / rows) return IntegrityStatus::DataPastEnd;
+    } else if (imageSize > available) {
+        return IntegrityStatus::DataPastEnd;
+    }
+    return IntegrityStatus::Ok;
+}
+
+IntegrityStatus checkTiff(FileView &view)
+{
+    const qint64 size = view.size();
+    const uchar *h = view.data(0, 8);
+    if (!h) return IntegrityStatus::DataPastEnd;
+    bool little = h[0] == 'I' && h[1] == 'I';
+    if (!little && !(h[0] == 'M' && h[1] == 'M')) return IntegrityStatus::Unchecked;
+    auto u16 = [little](const uchar *p) { return little ? le16(p) : be16(p); };
+    auto u32 = [little](const uchar *p) { return little ? le32(p) : be32(p); };
+    if (u16(h + 2) != 42) return IntegrityStatus::Unchecked;  // BigTIFF не разбираем
+
+    // Массив смещений (или длин) полосок/тайлов: значения в записи, если влезают в 4 байта
+    auto readValues = [&](const uchar *entry, QVector<qint64> &values) {
+        int type = u16(entry + 2);
+        quint32 count = u32(entry + 4);
+        int width = type == 3 ? 2 : type == 4 ? 4 : 0;
+        if (width == 0 || count > (1u << 24)) return false;
+        qint64 bytes = qint64(count) * width;
+        const uchar *p = entry + 8;
+        if (bytes > 4) {
+            qint64 offset = u32(entry + 8);
+            if (offset + bytes > size) return false;
+            p = view.data(offset, bytes);
+            if (!p) return false;
+        }
+        values.resize(count);
+        for (quint32 i = 0; i < count; ++i) values[i] = width == 2 ? u16(p + i * 2) : u32(p + i * 4);
+        return true;
+    };
+
+    QSet<qint64> visited;
+    qint64 ifd = u32(h + 4);
+    while (ifd != 0) {
+        if (visited.contains(ifd) || visited.size() >= kMaxTiffIfds) break;
+        visited.insert(ifd);
+
+        const uchar *countBytes = view.data(ifd, 2);
+        if (!countBytes) return IntegrityStatus::DataPastEnd;
+        int entries = u16(countBytes);
+        qint64 tableBytes = 2 + qint64(entries) * 12 + 4;
+        if (ifd + tableBytes > size) return IntegrityStatus::DataPastEnd;
+        // Копия: чтение массивов ниже сдвигает окно view
+        const uchar *tableData = view.data(ifd, tableBytes);
+        if (!tableData) return IntegrityStatus::DataPastEnd;
+        QByteArray table(reinterpret_cast<const char *>(tableData), tableBytes);
+        const uchar *t = reinterpret_cast<const uchar *>(table.constData());
+
+        QVector<qint64> offsets;
+        QVector<qint64> lengths;
+        for (int i = 0; i < entries; ++i) {
+            const uchar *entry = t + 2 + i * 12;
+            int tag = u16(entry);
+            bool ok = true;
+            if (tag == 273 || tag == 324) ok = readValues(entry, offsets);       // StripOffsets, TileOffsets
+            else if (tag == 279 || tag == 325) ok = readValues(entry, lengths);  // StripByteCounts, TileByteCounts
+            if (!ok) return IntegrityStatus::DataPastEnd;
+        }
+        for (int i = 0; i < offsets.size() && i < lengths.size(); ++i)
+            if (offsets[i] + lengths[i] > size) return IntegrityStatus::DataPastEnd;
+
+        ifd = u32(t + tableBytes - 4);
+        if (ifd >= size) return IntegrityStatus::DataPastEnd;
+    }
+    return IntegrityStatus::Ok;
+}
+
+}
+
+QString integrityStatusName(IntegrityStatus status)
+{
+    switch (status) {
+    case IntegrityStatus::Unchecked: return "не проверялся";
+    case IntegrityStatus::Ok: return "цел";
+    case IntegrityStatus::Unreadable: return "не читается";
+    case IntegrityStatus::MissingEoi: return "нет маркера EOI (файл обрезан)";
+    case IntegrityStatus::BadJpegMarker: return "повреждена цепочка маркеров JPEG";
+    case IntegrityStatus::ChunkCrc: return "CRC чанка PNG не совпадает";
+    case IntegrityStatus::ChunkTruncated: return "чанк PNG выходит за конец файла";
+    case IntegrityStatus::MissingIend: return "нет чанка IEND (файл обрезан)";
+    case IntegrityStatus::DataPastEnd: return "заявленные данные больше файла";
+    case IntegrityStatus::DecoderCrashed: return "декодер аварийно завершился";
+    case IntegrityStatus::DecoderTimeout: return "декодер завис";
+    }
+    return QString();
+}
+
+QString integrityStatusId(IntegrityStatus status)
+{
+    switch (status) {
+    case IntegrityStatus::Unchecked: return "unchecked";
+    case IntegrityStatus::Ok: return "ok";
+    case IntegrityStatus::Unreadable: return "unreadable";
+    case IntegrityStatus::MissingEoi: return "missingEoi";
+    case IntegrityStatus::BadJpegMarker: return "badJpegMarker";
+    case IntegrityStatus::ChunkCrc: return "chunkCrc";
+    case IntegrityStatus::ChunkTruncated: return "chunkTruncated";
+    case IntegrityStatus::MissingIend: return "missingIend";
+    case IntegrityStatus::DataPastEnd: return "dataPastEnd";
+    case IntegrityStatus::DecoderCrashed: return "decoderCrashed";
+    case IntegrityStatus::DecoderTimeout: return "decoderTimeout";
+    }
+    return QString();
+}
+
+IntegrityStatus checkImageIntegrity(FileView &view, const QString &format)
+{
+    if (!view.isOpen()) return IntegrityStatus::Unreadable;
+    QString f = format.toUpper();
+    if (f == "JPG" || f == "JPEG") return checkJpeg(view);
+    if (f == "PNG") return checkPng(view);
+    if (f == "BMP") return checkBmp(view);
+    if (f == "TIF" || f == "TIFF") return checkTiff(view);
+    return IntegrityStatus::Unchecked;
+}
+
+void verifyImageIntegrity(const QString &filePath, ImageInfo &info)
+{
+    if (splitArchivePath(filePath)) return;
+    FileView view(filePath);
+    IntegrityStatus status = checkImageIntegrity(view, info.format);
+    info.integrity = static_cast<quint8>(status);
+    if (status > IntegrityStatus::Ok) info.flags |= ImageCorrupt;
+}
@@ -0,0 +1,43 @@
+#ifndef INTEGRITYCHECK_H
+#define INTEGRITYCHECK_H
+
+#include <QString>
+#include "imageinfo.h"
+
+class FileView;
+
+// Итог проверки целостности (ImageInfo::integrity)
+enum class IntegrityStatus : quint8 {
+    Unchecked,       // проверка не выполнялась или для формата её нет
+    Ok,
+    Unreadable,      // файл не открылся
+    MissingEoi,      // JPEG: данные кончились до маркера EOI - файл обрезан
+    BadJpegMarker,   // JPEG: на месте маркера посторонние байты
+    ChunkCrc,        // PNG: CRC чанка не совпадает
+    ChunkTruncated,  // PNG: чанк выходит за конец файла
+    MissingIend,     // PNG: нет чанка IEND
+    DataPastEnd,     // BMP, TIFF: заявленные размеры данных больше файла
+    DecoderCrashed,  // процесс-воркер упал на этом файле (см. probeworker.h)
+    DecoderTimeout   // процесс-воркер завис на этом файле и был остановлен
+};
+
+// Файл не проверялся, а уронил или подвесил декодер - декодировать его повторно не стоит
+inline bool isDecoderFailure(IntegrityStatus status)
+{
+    return status == IntegrityStatus::DecoderCrashed || status == IntegrityStatus::DecoderTimeout;
+}
+
+QString integrityStatusName(IntegrityStatus status);  // для интерфейса
+QString integrityStatusId(IntegrityStatus status);    // для JSON и CSV: "ok", "missingEoi", ...
+
+// Проверка по всей длине файла: JPEG - цепочка маркеров до EOI с проходом по
+// энтропийным данным, PNG - длины и CRC всех чанков до IEND, BMP и TIFF - заявленные
+// размеры и смещения данных против длины файла. Файлы проверяются в воркерах
+// сканера параллельно, сама проверка однопоточная
+IntegrityStatus checkImageIntegrity(FileView &view, const QString &format);
+
+// Ставит info.integrity и при повреждении флаг ImageCorrupt.
+// Изображения внутри архивов не проверяются
+void verifyImageIntegrity(const QString &filePath, ImageInfo &info);
+
+#endif // INTEGRITYCHECK_H
@@ -1,10 +1,26 @@
 #include "mainwindow.h"
+#include "fileview.h"
+#include "probeworker.h"
 
 #include <QApplication>
+#include <QCoreApplication>
 
 int main(int argc, char *argv[])
 {
+    // Способ чтения заголовков по умолчанию: INFO_FILE_ACCESS=auto|mmap|pread
+    if (qEnvironmentVariableIsSet("INFO_FILE_ACCESS"))
+        setFileAccessMode(fileAccessModeFromString(qEnvironmentVariable("INFO_FILE_ACCESS")));
+
+    // Процесс-воркер для изолированного разбора (см. ProbeProcess) - без окон
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], kProbeWorkerArgument) == 0) {
+            QCoreApplication app(argc, argv);
+            return runProbeWorker();
+        }
+    }
+
     QApplication a(argc, argv);
+
     MainWindow w;
     w.showMaximized();
     w.show();
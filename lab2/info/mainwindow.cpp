@@ -1,7 +1,15 @@
 #include "mainwindow.h"
 #include "imageinfo.h"
+#include "fileview.h"
+#include "imagehash.h"
+#include "archivereader.h"
+#include "imagemetadata.h"
+#include "integritycheck.h"
+#include "quanttables.h"
+#include "crc32.h"
 #include <QFileDialog>
 #include <QDirIterator>
+#include <QThread>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QElapsedTimer>
@@ -11,16 +19,31 @@
 #include <QFont>
 #include <QSplitter>
 #include <QGroupBox>
+#include <QTabWidget>
+#include <QFile>
+#include <QJsonDocument>
+#include <QFileInfo>
+#include <QSignalBlocker>
+#include <algorithm>
+#include <functional>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
+    // Наблюдение перечитывает файлы, не занимая все ядра
+    watchPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
     setupUI();
     showMaximized();
     setWindowTitle("🔍 Image Info Scanner");
 }
 
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow()
+{
+    // Сканер пишет в scanStats из рабочих потоков - останавливаем его раньше полей окна
+    delete scanner;
+    watchPool.clear();
+    watchPool.waitForDone();
+}
 
 void MainWindow::setupUI()
 {
@@ -52,31 +75,134 @@ void MainWindow::setupUI()
         }
     )");
 
+    QLabel *accessLabel = new QLabel("Чтение заголовков:", this);
+    accessModeCombo = new QComboBox(this);
+    accessModeCombo->addItem("auto", static_cast<int>(FileAccessMode::Auto));
+    accessModeCombo->addItem("mmap", static_cast<int>(FileAccessMode::Mmap));
+    accessModeCombo->addItem("pread", static_cast<int>(FileAccessMode::Pread));
+    accessModeCombo->setCurrentIndex(accessModeCombo->findText(fileAccessModeName(fileAccessMode())));
+
     controlLayout->addWidget(folderLabel);
     controlLayout->addWidget(folderPathEdit, 1);
+    controlLayout->addWidget(accessLabel);
+    controlLayout->addWidget(accessModeCombo);
+    scanOrderCombo = new QComboBox(this);
+    scanOrderCombo->addItem("обход", static_cast<int>(ScanOrder::Walk));
+    scanOrderCombo->addItem("inode", static_cast<int>(ScanOrder::Inode));
+    scanOrderCombo->addItem("экстенты", static_cast<int>(ScanOrder::Extent));
+    scanOrderCombo->setToolTip("Порядок разбора файлов. Для HDD и ленточных архивов - inode или физическое "
+                               "положение (FIEMAP): чтение идёт почти подряд, но начинается после обхода");
+    controlLayout->addWidget(new QLabel("Порядок:", this));
+    controlLayout->addWidget(scanOrderCombo);
     controlLayout->addWidget(btnLoadImages);
 
+    btnCancelScan = new QPushButton("Отмена", this);
+    btnCancelScan->setStyleSheet(btnLoadImages->styleSheet());
+    btnCancelScan->setVisible(false);
+    controlLayout->addWidget(btnCancelScan);
+
+    watchCheckBox = new QCheckBox("Следить за изменениями", this);
+    controlLayout->addWidget(watchCheckBox);
+    duplicatesCheckBox = new QCheckBox("Искать дубликаты", this);
+    controlLayout->addWidget(duplicatesCheckBox);
+    archivesCheckBox = new QCheckBox("Смотреть в ZIP/TAR", this);
+    controlLayout->addWidget(archivesCheckBox);
+    integrityCheckBox = new QCheckBox("Проверять целостность", this);
+    integrityCheckBox->setToolTip("JPEG - маркер EOI, PNG - CRC всех чанков (" + crc32Implementation()
+                                  + "), BMP и TIFF - размеры данных. Файлы читаются целиком");
+    controlLayout->addWidget(integrityCheckBox);
+    colorsCheckBox = new QCheckBox("Цветовая статистика", this);
+    colorsCheckBox->setToolTip("Средний и медианный цвет, основные цвета и перцентили яркости по уменьшенному "
+                               "до " + QString::number(kColorStatsSize) + " пикселей изображению; "
+                               "отбор: luma, luma5, luma95");
+    controlLayout->addWidget(colorsCheckBox);
+    recompressCheckBox = new QCheckBox("Оценить пересжатие, JPEG Q", this);
+    recompressCheckBox->setToolTip("Размер после пересжатия в PNG, JPEG с выбранным качеством и WebP без потерь - "
+                                   "по 16 плиткам из разных частей изображения, без кодирования целиком. "
+                                   "Итоги по набору - на вкладке сводки");
+    recompressQualitySpin = new QSpinBox(this);
+    recompressQualitySpin->setRange(1, 100);
+    recompressQualitySpin->setValue(85);
+    controlLayout->addWidget(recompressCheckBox);
+    controlLayout->addWidget(recompressQualitySpin);
+    isolateCheckBox = new QCheckBox("Изолировать декодеры", this);
+    isolateCheckBox->setToolTip("Разбирать и декодировать файлы в отдельных процессах: испорченный файл, "
+                                "на котором декодер падает или зависает, не роняет программу, "
+                                "а попадает в список на вкладке статистики и под фильтр corrupt");
+    controlLayout->addWidget(isolateCheckBox);
+    memoryBudgetSpin = new QSpinBox(this);
+    memoryBudgetSpin->setRange(16, 64 * 1024);
+    memoryBudgetSpin->setValue(256);
+    memoryBudgetSpin->setSuffix(" МБ");
+    memoryBudgetSpin->setToolTip("Имена и хеши сверх этого объёма уходят во временный файл");
+    controlLayout->addWidget(new QLabel("Память:", this));
+    controlLayout->addWidget(memoryBudgetSpin);
+
+    scanner = new ImageScanner(this);
+
+    // Отбор строк по типизированным колонкам
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    formatFilterCombo = new QComboBox(this);
+    formatFilterCombo->addItem("Все форматы");
+    minSizeSpin = new QSpinBox(this);
+    minSizeSpin->setRange(0, 10 * 1024 * 1024);
+    minSizeSpin->setSuffix(" КБ");
+    minPixelsSpin = new QDoubleSpinBox(this);
+    minPixelsSpin->setRange(0, 1000);
+    minPixelsSpin->setDecimals(1);
+    minPixelsSpin->setSuffix(" Мп");
+    alphaFilterCheckBox = new QCheckBox("Только с альфа-каналом", this);
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText("format == JPEG && width > 4000 && dpi < 150 && !alpha");
+    queryEdit->setToolTip("Поля: " + ResultQuery::fieldNames().join(", ")
+                          + "\nОперации: == != < <= > >= && || ! и скобки; size допускает KB, MB, GB");
+    queryEdit->setClearButtonEnabled(true);
+    queryTimer = new QTimer(this);
+    queryTimer->setSingleShot(true);
+    queryTimer->setInterval(250);
+    filterLayout->addWidget(new QLabel("Фильтр:", this));
+    filterLayout->addWidget(formatFilterCombo);
+    filterLayout->addWidget(new QLabel("размер файла от", this));
+    filterLayout->addWidget(minSizeSpin);
+    filterLayout->addWidget(new QLabel("изображение от", this));
+    filterLayout->addWidget(minPixelsSpin);
+    filterLayout->addWidget(alphaFilterCheckBox);
+    filterLayout->addWidget(queryEdit, 1);
+
+    folderWatcher = new QFileSystemWatcher(this);
+    watchTimer = new QTimer(this);
+    watchTimer->setSingleShot(true);
+    watchTimer->setInterval(300);
+
     // Создаём сплиттер для таблицы и матрицы квантования
     QSplitter *splitter = new QSplitter(Qt::Horizontal, this);
 
-    tableWidget = new QTableWidget(this);
-    tableWidget->setColumnCount(9);  // Добавили колонку для степени сжатия
-    tableWidget->setHorizontalHeaderLabels(QStringList()
-                                           << "Имя файла" << "Размер (пиксели)" << "Разрешение (DPI)"
-                                           << "Глубина цвета" << "Сжатие" << "Степень сжатия"
-                                           << "Формат" << "Размер файла" << "Доп. информация");
-
-    tableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
-    tableWidget->horizontalHeader()->setStretchLastSection(true);
-    tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-    tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    tableWidget->setAlternatingRowColors(true);
+    thumbnailCache = new ThumbnailCache(64, this);
+    resultModel = new ScanResultModel(this);
+    resultModel->setThumbnailCache(thumbnailCache);
+    detailLoader = new DetailLoader(this);
+    resultModel->setDetailLoader(detailLoader);
+    resultModel->setScanner(scanner);
+    tableView = new QTableView(this);
+    tableView->setModel(resultModel);
+    tableView->setIconSize(QSize(thumbnailCache->thumbnailSize(), thumbnailCache->thumbnailSize()));
+    // одинаковая высота строк - без пересчёта при прокрутке
+    tableView->verticalHeader()->setDefaultSectionSize(thumbnailCache->thumbnailSize() + 6);
+
+    tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    tableView->horizontalHeader()->setStretchLastSection(true);
+    tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    tableView->setAlternatingRowColors(true);
+    // Сортировка по числовым ключам колонок (ScanResults::sortIndex), миниатюры - порядок сканирования
+    tableView->horizontalHeader()->setSortIndicator(ScanResults::ThumbnailColumn, Qt::AscendingOrder);
+    tableView->setSortingEnabled(true);
 
     QFont tableFont("Segoe UI", 11);
-    tableWidget->setFont(tableFont);
+    tableView->setFont(tableFont);
 
-    tableWidget->setStyleSheet(R"(
-        QTableWidget {
+    tableView->setStyleSheet(R"(
+        QTableView {
             background-color: #2d3748;
             alternate-background-color: #4a5568;
             gridline-color: #4a5568;
@@ -95,22 +221,31 @@ void MainWindow::setupUI()
             color: #e2e8f0;
             border-bottom: 2px solid #3182ce;
         }
-        QTableWidget::item {
+        QTableView::item {
             padding: 8px;
             border-bottom: 1px solid #4a5568;
         }
     )");
 
     // Фиксированная ширина колонок
-    tableWidget->setColumnWidth(0, 200);  // Имя файла
-    tableWidget->setColumnWidth(1, 120);  // Размер (пиксели)
-    tableWidget->setColumnWidth(2, 120);  // DPI
-    tableWidget->setColumnWidth(3, 100);  // Глубина цвета
-    tableWidget->setColumnWidth(4, 100);  // Сжатие
-    tableWidget->setColumnWidth(5, 180);  // Степень сжатия
-    tableWidget->setColumnWidth(6, 80);   // Формат
-    tableWidget->setColumnWidth(7, 100);  // Размер файла
-    tableWidget->setColumnWidth(8, 280);  // Доп. информация
+    tableView->setColumnWidth(ScanResults::ThumbnailColumn, thumbnailCache->thumbnailSize() + 8);
+    tableView->setColumnWidth(ScanResults::FileNameColumn, 200);
+    tableView->setColumnWidth(ScanResults::PixelSizeColumn, 120);
+    tableView->setColumnWidth(ScanResults::ResolutionColumn, 120);
+    tableView->setColumnWidth(ScanResults::ColorDepthColumn, 100);
+    tableView->setColumnWidth(ScanResults::CompressionColumn, 100);
+    tableView->setColumnWidth(ScanResults::CompressionRatioColumn, 180);
+    tableView->setColumnWidth(ScanResults::RecompressColumn, 320);
+    tableView->setColumnHidden(ScanResults::RecompressColumn, true);
+    tableView->setColumnWidth(ScanResults::FormatColumn, 80);
+    tableView->setColumnWidth(ScanResults::FileSizeColumn, 100);
+    tableView->setColumnWidth(ScanResults::AdditionalInfoColumn, 280);
+    tableView->setColumnWidth(ScanResults::MeanColorColumn, 190);
+    tableView->setColumnWidth(ScanResults::DominantColorsColumn, 260);
+    tableView->setColumnWidth(ScanResults::LuminanceColumn, 130);
+    // Цветовые колонки видны, только когда статистика считается
+    for (int column : {ScanResults::MeanColorColumn, ScanResults::DominantColorsColumn, ScanResults::LuminanceColumn})
+        tableView->setColumnHidden(column, true);
 
     // Панель для отображения матрицы квантования
     QGroupBox *quantBox = new QGroupBox("Матрица квантования JPEG", this);
@@ -146,8 +281,45 @@ void MainWindow::setupUI()
         }
     )");
 
-    splitter->addWidget(tableWidget);
-    splitter->addWidget(quantBox);
+    // Панель статистики по этапам сканирования
+    QWidget *statsPage = new QWidget(this);
+    QVBoxLayout *statsLayout = new QVBoxLayout(statsPage);
+    statsDisplay = new QTextEdit(this);
+    statsDisplay->setReadOnly(true);
+    statsDisplay->setFont(QFont("Courier New", 10));
+    statsDisplay->setStyleSheet(quantMatrixDisplay->styleSheet());
+    statsDisplay->setText("Статистика появится после сканирования");
+    btnExportStats = new QPushButton("Экспорт JSON", this);
+    btnExportStats->setStyleSheet(btnLoadImages->styleSheet());
+    btnExportStats->setEnabled(false);
+    statsLayout->addWidget(statsDisplay, 1);
+    statsLayout->addWidget(btnExportStats);
+
+    duplicatesDisplay = new QTextEdit(this);
+    duplicatesDisplay->setReadOnly(true);
+    duplicatesDisplay->setStyleSheet(quantMatrixDisplay->styleSheet());
+    duplicatesDisplay->setText("Включите \"Искать дубликаты\" перед сканированием");
+
+    corpusDisplay = new QTextEdit(this);
+    corpusDisplay->setReadOnly(true);
+    corpusDisplay->setFont(QFont("Courier New", 10));
+    corpusDisplay->setStyleSheet(quantMatrixDisplay->styleSheet());
+    corpusDisplay->setText(corpusStats.toText());
+
+    metadataDisplay = new QTextEdit(this);
+    metadataDisplay->setReadOnly(true);
+    metadataDisplay->setStyleSheet(quantMatrixDisplay->styleSheet());
+    metadataDisplay->setText("Выберите файл в таблице");
+
+    QTabWidget *sideTabs = new QTabWidget(this);
+    sideTabs->addTab(quantBox, "Квантование");
+    sideTabs->addTab(metadataDisplay, "Метаданные");
+    sideTabs->addTab(corpusDisplay, "Сводка");
+    sideTabs->addTab(statsPage, "Статистика");
+    sideTabs->addTab(duplicatesDisplay, "Дубликаты");
+
+    splitter->addWidget(tableView);
+    splitter->addWidget(sideTabs);
     splitter->setStretchFactor(0, 3);
     splitter->setStretchFactor(1, 1);
 
@@ -159,6 +331,7 @@ void MainWindow::setupUI()
     statusLabel->setStyleSheet("QLabel { font-style: italic; color: #555; padding: 4px; }");
 
     mainLayout->addLayout(controlLayout);
+    mainLayout->addLayout(filterLayout);
     mainLayout->addWidget(splitter, 1);
     mainLayout->addWidget(progressBar);
     mainLayout->addWidget(statusLabel);
@@ -196,7 +369,36 @@ void MainWindow::setupUI()
     )");
 
     connect(btnLoadImages, &QPushButton::clicked, this, &MainWindow::onLoadImages);
-    connect(tableWidget, &QTableWidget::cellClicked, this, &MainWindow::onTableCellClicked);
+    connect(btnCancelScan, &QPushButton::clicked, scanner, &ImageScanner::cancel);
+    connect(scanner, &ImageScanner::filesQueued, this, &MainWindow::onScanQueued);
+    connect(scanner, &ImageScanner::batchReady, this, &MainWindow::onScanBatch);
+    connect(scanner, &ImageScanner::finished, this, &MainWindow::onScanFinished);
+    connect(scanner, &ImageScanner::corpusUpdated, this, &MainWindow::onCorpusUpdated);
+    connect(scanner, &ImageScanner::probeFailed, this, &MainWindow::onProbeFailed);
+    connect(detailLoader, &DetailLoader::probeFailed, this, &MainWindow::onProbeFailed);
+    connect(thumbnailCache, &ThumbnailCache::probeFailed, this, &MainWindow::onProbeFailed);
+    connect(tableView, &QTableView::clicked, this, &MainWindow::onTableCellClicked);
+    connect(thumbnailCache, &ThumbnailCache::thumbnailReady, this, [this](const QString &filePath) {
+        resultModel->refreshThumbnail(resultModel->requestedRow(filePath));
+    });
+    connect(detailLoader, &DetailLoader::detailsReady, this, [this](const QString &filePath, const ImageInfo &info) {
+        int row = resultModel->requestedRow(filePath);
+        if (row < 0) return;
+        resultModel->updateDetails(row, info);
+        // Ждали детали для выбранной строки - показываем матрицу
+        if (resultModel->storeRow(tableView->currentIndex()) == row) onTableCellClicked(tableView->currentIndex());
+    });
+    connect(btnExportStats, &QPushButton::clicked, this, &MainWindow::onExportStats);
+    connect(formatFilterCombo, &QComboBox::currentIndexChanged, this, &MainWindow::onFilterChanged);
+    connect(minSizeSpin, &QSpinBox::valueChanged, this, &MainWindow::onFilterChanged);
+    connect(minPixelsSpin, &QDoubleSpinBox::valueChanged, this, &MainWindow::onFilterChanged);
+    connect(alphaFilterCheckBox, &QCheckBox::toggled, this, &MainWindow::onFilterChanged);
+    connect(queryEdit, &QLineEdit::textChanged, queryTimer, qOverload<>(&QTimer::start));
+    connect(queryEdit, &QLineEdit::returnPressed, this, &MainWindow::onFilterChanged);
+    connect(queryTimer, &QTimer::timeout, this, &MainWindow::onFilterChanged);
+    connect(watchCheckBox, &QCheckBox::toggled, this, &MainWindow::onWatchToggled);
+    connect(folderWatcher, &QFileSystemWatcher::directoryChanged, this, &MainWindow::onWatchedDirectoryChanged);
+    connect(watchTimer, &QTimer::timeout, this, &MainWindow::applyWatchChanges);
 }
 
 void MainWindow::onLoadImages()
@@ -206,91 +408,470 @@ void MainWindow::onLoadImages()
 
     folderPathEdit->setText(folder);
 
-    QStringList formats = {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.gif", "*.tif", "*.tiff", "*.pcx"};
-    QDirIterator it(folder, formats, QDir::Files, QDirIterator::Subdirectories);
-    QStringList files;
-    while (it.hasNext() && files.size() < 100000) files.append(it.next());
+    stopWatching();
+    scannedFolder = folder;
 
-    if (files.isEmpty()) {
+    resultModel->clear();
+    resultModel->setMemoryBudget(static_cast<qint64>(memoryBudgetSpin->value()) << 20);
+    thumbnailCache->clear();
+    detailLoader->clear();
+    progressBar->setVisible(true);
+    progressBar->setRange(0, 0);  // общее число файлов пока неизвестно
+    progressBar->setValue(0);
+    btnLoadImages->setEnabled(false);
+
+    setFileAccessMode(static_cast<FileAccessMode>(accessModeCombo->currentData().toInt()));
+
+    scanStats.clear();
+    corpusStats.clear();
+    updateCorpusDisplay(false);
+    scanProcessed = 0;
+    scanHeaderBytes = 0;
+    btnCancelScan->setVisible(true);
+    btnCancelScan->setEnabled(true);
+
+    // Обход и разбор идут в фоне: строки заводятся заготовками в onScanQueued,
+    // разобранные заголовки приходят пачками в onScanBatch
+    ScanOptions options;
+    options.hashing = duplicatesCheckBox->isChecked();
+    options.archives = archivesCheckBox->isChecked();
+    options.integrity = integrityCheckBox->isChecked();
+    options.colors = colorsCheckBox->isChecked();
+    for (int column : {ScanResults::MeanColorColumn, ScanResults::DominantColorsColumn, ScanResults::LuminanceColumn})
+        tableView->setColumnHidden(column, !options.colors);
+    options.recompressQuality = recompressCheckBox->isChecked() ? recompressQualitySpin->value() : 0;
+    tableView->setColumnHidden(ScanResults::RecompressColumn, options.recompressQuality <= 0);
+    options.isolate = isolateCheckBox->isChecked();
+    options.probeTimeoutMs = kProbeTimeoutMs;
+    options.order = static_cast<ScanOrder>(scanOrderCombo->currentData().toInt());
+    options.stats = &scanStats;
+    // Детали и миниатюры декодируют те же файлы - изолируем и их
+    probeFailures.clear();
+    detailLoader->setIsolation(options.isolate ? kProbeTimeoutMs : 0);
+    thumbnailCache->setIsolation(options.isolate ? kProbeTimeoutMs : 0);
+    scanTimer.start();
+    scanner->start(folder, options);
+}
+
+void MainWindow::onScanQueued(const QStringList &filePaths)
+{
+    // Строки видны сразу после обхода; видимые сканер разберёт первыми
+    resultModel->appendPending(filePaths);
+    progressBar->setMaximum(static_cast<int>(scanner->filesFound()));
+}
+
+void MainWindow::onScanBatch(const QVector<ScanItem> &items)
+{
+    if (items.isEmpty()) return;
+    // Пачка - одно уведомление модели, время делим поровну между файлами
+    QElapsedTimer uiTimer;
+    uiTimer.start();
+    resultModel->applyResults(items);
+    qint64 insertNs = uiTimer.nsecsElapsed() / items.size();
+
+    for (const ScanItem &item : items) {
+        StageTimings timings = item.timings;
+        timings[ScanStage::UiInsert] = insertNs;
+        scanStats.addFile(item.info.format, timings);
+        scanHeaderBytes += item.info.headerBytesRead;
+    }
+    scanProcessed += items.size();
+
+    progressBar->setMaximum(static_cast<int>(scanner->filesFound()));
+    progressBar->setValue(scanProcessed);
+    statusLabel->setText(QString("Обработано %1 из %2 найденных файлов...")
+                             .arg(scanProcessed).arg(scanner->filesFound()));
+}
+
+void MainWindow::onScanFinished(bool cancelled)
+{
+    progressBar->setVisible(false);
+    btnCancelScan->setVisible(false);
+    btnLoadImages->setEnabled(true);
+
+    if (scanProcessed == 0 && !cancelled) {
         QMessageBox::information(this, "Информация", "В выбранной папке нет изображений!");
         return;
     }
 
-    tableWidget->setRowCount(0);
-    progressBar->setVisible(true);
-    progressBar->setRange(0, files.size());
-    progressBar->setValue(0);
-    btnLoadImages->setEnabled(false);
+    qint64 elapsedMs = scanTimer.elapsed();
+    scanStats.setWallTime(elapsedMs);
+    statsDisplay->setText(scanStatsText());
+    updateCorpusDisplay(true);
+    btnExportStats->setEnabled(true);
+    QString status = QString("%1 %2 файлов за %3 мс, прочитано заголовков: %4 KB (%5)")
+                         .arg(cancelled ? "Сканирование отменено, обработано" : "Обработано")
+                         .arg(scanProcessed).arg(elapsedMs)
+                         .arg(scanHeaderBytes / 1024.0, 0, 'f', 1)
+                         .arg(accessModeCombo->currentText());
+    if (qint64 spilled = resultModel->results().spilledBytes())
+        status += QString(", вытеснено на диск: %1 МБ").arg(spilled / (1024.0 * 1024.0), 0, 'f', 1);
+    if (integrityCheckBox->isChecked()) {
+        const ScanResults &results = resultModel->results();
+        int corrupt = 0;
+        for (int row = 0; row < results.size(); ++row)
+            if (results.flags(row) & ImageCorrupt) ++corrupt;
+        status += QString(", повреждено: %1 (фильтр: corrupt)").arg(corrupt);
+    }
+    if (!probeFailures.isEmpty())
+        status += QString(", воркер упал или завис на %1 файлах (см. статистику)").arg(probeFailures.size());
+    statusLabel->setText(status);
 
-    QElapsedTimer timer;
-    timer.start();
+    updateFormatFilter();
 
-    int processed = 0;
-    QVector<ImageInfo> imageInfoList;  // Сохраняем все ImageInfo
+    // Частичный результат остаётся в таблице, но поиск дубликатов
+    // и наблюдение запускаем только для полного обхода
+    if (cancelled) return;
 
-    for (const QString &filePath : files) {
-        ImageInfo info = getImageInfo(filePath);
-        imageInfoList.append(info);
+    if (duplicatesCheckBox->isChecked()) showDuplicateGroups();
 
-        int row = tableWidget->rowCount();
-        tableWidget->insertRow(row);
+    if (watchCheckBox->isChecked()) startWatching();
+}
 
-        QStringList data = {
-            info.fileName, info.size, info.resolution, info.colorDepth,
-            info.compression, info.compressionRatio, info.format, info.fileSize, info.additionalInfo
-        };
+void MainWindow::onCorpusUpdated(const CorpusStats &delta)
+{
+    // Сливаем только приращение: цена не зависит от числа строк в таблице
+    corpusStats.merge(delta);
+    updateCorpusDisplay(!scanner->isRunning());
+}
 
-        for (int i = 0; i < data.size(); ++i) {
-            QTableWidgetItem* item = new QTableWidgetItem(data[i]);
-            item->setTextAlignment(i == 0 || i == 8 ? Qt::AlignLeft : Qt::AlignCenter);
+void MainWindow::onProbeFailed(const QString &filePath, const QString &reason)
+{
+    // Воркер уже перезапущен, файл отмечен в таблице - запоминаем его для отчёта
+    probeFailures.append(filePath + " - " + reason);
+    if (!scanner->isRunning()) statsDisplay->setText(scanStatsText());
+}
 
-            // Сохраняем путь к файлу и индекс в первой колонке
-            if (i == 0) {
-                item->setData(Qt::UserRole, filePath);
-                item->setData(Qt::UserRole + 1, row);  // Сохраняем индекс для доступа к ImageInfo
-            }
+QString MainWindow::scanStatsText() const
+{
+    QString text = scanStats.toText();
+    if (!probeFailures.isEmpty()) {
+        text += QString("\nФайлы, на которых процесс-воркер упал или завис (%1):\n").arg(probeFailures.size());
+        for (const QString &failure : probeFailures) text += "  " + failure + "\n";
+    }
+    return text;
+}
 
-            tableWidget->setItem(row, i, item);
+void MainWindow::updateCorpusDisplay(bool withQualityGroups)
+{
+    // К сводке воркеров в конце сканирования добавляются группы JPEG: качество оценено
+    // один раз на набор таблиц в пуле хранилища, но проход идёт по всем строкам -
+    // на каждом такте сводки он стоил бы O(n)
+    QString text = corpusStats.toText();
+    if (!withQualityGroups) {
+        corpusDisplay->setPlainText(text);
+        return;
+    }
+    const ScanResults &results = resultModel->results();
+    QVector<QualityGroup> groups = results.qualityGroups();
+    if (!groups.isEmpty()) {
+        const int kMaxGroups = 40;
+        text += QString("\nJPEG по программе и качеству (различных наборов таблиц: %1):\n")
+                    .arg(results.quantTableSetCount());
+        for (int i = 0; i < groups.size() && i < kMaxGroups; ++i) {
+            const QualityGroup &group = groups[i];
+            text += QString("  %1 %2 файлов, %3 МБ, наборов: %4  %5\n")
+                        .arg(formatJpegQuality(group.quality), -10).arg(group.files, 9)
+                        .arg(group.bytes / (1024.0 * 1024.0), 0, 'f', 1).arg(group.tableSets)
+                        .arg(group.encoder.isEmpty() ? QString("(программа не указана)") : group.encoder);
         }
+        if (groups.size() > kMaxGroups) text += QString("  ... ещё групп: %1\n").arg(groups.size() - kMaxGroups);
+    }
+    corpusDisplay->setPlainText(text);
+}
 
-        processed++;
-        progressBar->setValue(processed);
-        if (processed % 10 == 0) QApplication::processEvents();
+void MainWindow::onFilterChanged()
+{
+    ResultFilter filter;
+    if (formatFilterCombo->currentIndex() > 0) filter.format = formatFilterCombo->currentText();
+    filter.minFileSize = static_cast<qint64>(minSizeSpin->value()) * 1024;
+    filter.minPixels = static_cast<qint64>(minPixelsSpin->value() * 1e6);
+    filter.alphaOnly = alphaFilterCheckBox->isChecked();
+
+    // С ошибкой в выражении прежний отбор остаётся, пока текст не исправят
+    QString error;
+    filter.query = ResultQuery::parse(queryEdit->text(), &error);
+    queryTimer->stop();
+    if (!error.isEmpty()) {
+        queryEdit->setStyleSheet("QLineEdit { border: 1px solid #e53e3e; }");
+        statusLabel->setText("Ошибка в выражении, " + error);
+        return;
     }
+    queryEdit->setStyleSheet(QString());
 
-    // Сохраняем список ImageInfo в свойстве таблицы
-    tableWidget->setProperty("imageInfoList", QVariant::fromValue(imageInfoList));
+    QElapsedTimer timer;
+    timer.start();
+    resultModel->setFilter(filter);
+    statusLabel->setText(QString("Показано %1 из %2 файлов (отбор %3 мс)")
+                             .arg(resultModel->rowCount()).arg(resultModel->results().size())
+                             .arg(timer.elapsed()));
+}
 
-    progressBar->setVisible(false);
-    btnLoadImages->setEnabled(true);
+void MainWindow::updateFormatFilter()
+{
+    // Список форматов берём из таблицы; выбранный сохраняем, если он ещё есть
+    QString current = formatFilterCombo->currentIndex() > 0 ? formatFilterCombo->currentText() : QString();
+    QSignalBlocker blocker(formatFilterCombo);
+    while (formatFilterCombo->count() > 1) formatFilterCombo->removeItem(1);
+    formatFilterCombo->addItems(resultModel->results().formats());
+    formatFilterCombo->setCurrentIndex(qMax(0, formatFilterCombo->findText(current)));
+}
 
-    qint64 elapsedMs = timer.elapsed();
-    statusLabel->setText(QString("Обработано %1 файлов за %2 мс").arg(files.size()).arg(elapsedMs));
+void MainWindow::showDuplicateGroups()
+{
+    const ScanResults &results = resultModel->results();
+    QVector<bool> hashed(results.size());
+    for (int row = 0; row < results.size(); ++row) hashed[row] = results.flags(row) & ImageHashed;
+
+    QElapsedTimer timer;
+    timer.start();
+    const int kMaxDistance = 6;  // из 64 бит dHash
+    QVector<DuplicateGroup> groups = findDuplicateGroups(results.perceptualHashes(), results.contentHashColumn(),
+                                                         hashed, kMaxDistance, QThread::idealThreadCount());
+
+    QString text = QString("Групп дубликатов: %1 (поиск %2 мс)\n").arg(groups.size()).arg(timer.elapsed());
+    for (int g = 0; g < groups.size(); ++g) {
+        const DuplicateGroup &group = groups[g];
+        text += QString("\nГруппа %1: %2 файлов, %3\n")
+                    .arg(g + 1).arg(group.members.size())
+                    .arg(group.exact ? "точные копии" : QString("похожие (расстояние до %1)").arg(group.maxDistance));
+        for (int row : group.members) text += "  " + results.filePath(row) + "\n";
+    }
+    duplicatesDisplay->setText(text);
+}
+
+void MainWindow::onExportStats()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Экспорт статистики", "scan-stats.json", "JSON (*.json)");
+    if (fileName.isEmpty()) return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось записать файл: " + file.errorString());
+        return;
+    }
+    file.write(QJsonDocument(scanStats.toJson()).toJson());
 }
 
-void MainWindow::onTableCellClicked(int row, int column)
+MainWindow::FileStamp MainWindow::fileStamp(const QString &filePath)
 {
-    // Получаем сохраненный список ImageInfo
-    QVariant variant = tableWidget->property("imageInfoList");
-    if (!variant.isValid()) {
-        quantMatrixDisplay->setText("Нет данных об изображениях");
+    QFileInfo fi(filePath);
+    return {fi.lastModified(), fi.size()};
+}
+
+void MainWindow::onWatchToggled(bool enabled)
+{
+    if (enabled && !scannedFolder.isEmpty()) startWatching();
+    else stopWatching();
+}
+
+void MainWindow::startWatching()
+{
+    stopWatching();
+
+    // Индекс путей и отметок нужен только наблюдению и строится при его включении;
+    // на архивных объёмах он стоил бы больше, чем даёт наблюдение
+    const ScanResults &results = resultModel->results();
+    if (results.size() > kMaxWatchedFiles) {
+        statusLabel->setText(QString("Наблюдение недоступно: %1 файлов, предел %2")
+                                 .arg(results.size()).arg(kMaxWatchedFiles));
         return;
     }
+    // Члены архивов не отслеживаются: у виртуальных путей нет файла на диске
+    for (int row = 0; row < results.size(); ++row) {
+        QString filePath = results.filePath(row);
+        if (splitArchivePath(filePath)) continue;
+        rowByPath.insert(filePath, row);
+        fileStamps.insert(filePath, fileStamp(filePath));
+        filesByDir[filePath.left(filePath.lastIndexOf('/'))].insert(filePath);
+    }
+
+    // Следим только за каталогами дерева: по одному дескриптору на каталог, а не на файл.
+    // Создание, удаление, переименование (и сохранение через временный файл) приходят
+    // событием каталога; изменённые на месте файлы находятся сверкой отметок при следующем
+    QStringList dirs = {scannedFolder};
+    QDirIterator dirIt(scannedFolder, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (dirIt.hasNext()) dirs.append(dirIt.next());
+    folderWatcher->addPaths(dirs);
+}
+
+void MainWindow::stopWatching()
+{
+    watchTimer->stop();
+    pendingDirs.clear();
+    watchPool.clear();  // уже идущие разборы доработают, их ответы отбросятся
+    watchProbes.clear();
+    watchUpdated = 0;
+    rowByPath.clear();
+    fileStamps.clear();
+    filesByDir.clear();
+    if (!folderWatcher->directories().isEmpty()) folderWatcher->removePaths(folderWatcher->directories());
+}
+
+void MainWindow::onWatchedDirectoryChanged(const QString &path)
+{
+    pendingDirs.insert(path);
+    watchTimer->start();  // события приходят пачками - обрабатываем после паузы
+}
+
+void MainWindow::applyWatchChanges()
+{
+    QSet<QString> toProbe;
+    QSet<QString> toRemove;
+    const QStringList filters = supportedImageNameFilters();
+
+    for (const QString &dirPath : std::as_const(pendingDirs)) {
+        QDir dir(dirPath);
+        QString prefix = dirPath + "/";
+
+        // Файлы, которые таблица знает в этом каталоге (без подкаталогов)
+        QSet<QString> known = filesByDir.value(dirPath);
+
+        if (!dir.exists()) {
+            // Каталог удалён вместе с подкаталогами
+            for (auto it = filesByDir.constBegin(); it != filesByDir.constEnd(); ++it)
+                if (it.key() == dirPath || it.key().startsWith(prefix)) toRemove.unite(it.value());
+            continue;
+        }
+
+        const QFileInfoList entries = dir.entryInfoList(filters, QDir::Files);
+        for (const QFileInfo &fi : entries) {
+            QString filePath = fi.filePath();
+            known.remove(filePath);
+            auto stamp = fileStamps.constFind(filePath);
+            if (stamp == fileStamps.constEnd() || stamp->modified != fi.lastModified() || stamp->size != fi.size())
+                toProbe.insert(filePath);
+        }
+        toRemove.unite(known);
+
+        // Новые подкаталоги: начинаем следить и забираем их содержимое
+        const QFileInfoList subdirs = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QFileInfo &sub : subdirs) {
+            if (folderWatcher->directories().contains(sub.filePath())) continue;
+            folderWatcher->addPath(sub.filePath());
+            QDirIterator it(sub.filePath(), filters, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) toProbe.insert(it.next());
+            QDirIterator dirIt(sub.filePath(), QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while (dirIt.hasNext()) folderWatcher->addPath(dirIt.next());
+        }
+    }
+
+    pendingDirs.clear();
+    if (toProbe.isEmpty() && toRemove.isEmpty()) return;
+
+    // Удаляем строки с конца, чтобы индексы оставшихся не смещались раньше времени
+    QVector<int> removedRows;
+    for (const QString &filePath : std::as_const(toRemove)) {
+        auto it = rowByPath.constFind(filePath);
+        if (it != rowByPath.constEnd()) removedRows.append(it.value());
+        rowByPath.remove(filePath);
+        fileStamps.remove(filePath);
+        watchProbes.remove(filePath);
+        QString dirPath = filePath.left(filePath.lastIndexOf('/'));
+        auto files = filesByDir.find(dirPath);
+        if (files != filesByDir.end()) {
+            files->remove(filePath);
+            if (files->isEmpty()) filesByDir.erase(files);
+        }
+    }
+    std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+    for (int row : std::as_const(removedRows)) resultModel->removeResult(row);
+    if (!removedRows.isEmpty()) {
+        const ScanResults &results = resultModel->results();
+        for (int row = removedRows.last(); row < results.size(); ++row) {
+            QString filePath = results.filePath(row);
+            if (!splitArchivePath(filePath)) rowByPath.insert(filePath, row);
+        }
+    }
+
+    // Перечитываем только изменившиеся и новые файлы; строки правятся по приходу ответов
+    for (const QString &filePath : std::as_const(toProbe)) probeWatched(filePath);
+
+    if (!removedRows.isEmpty()) updateFormatFilter();
+    statusLabel->setText(QString("Наблюдение: перечитывается %1, удалено %2 файлов")
+                             .arg(watchProbes.size()).arg(toRemove.size()));
+}
+
+void MainWindow::probeWatched(const QString &filePath)
+{
+    // Отметка и каталог - сразу: повторное событие каталога не пошлёт файл снова,
+    // а удаление до ответа найдёт его в filesByDir и отменит запрос
+    fileStamps.insert(filePath, fileStamp(filePath));
+    filesByDir[filePath.left(filePath.lastIndexOf('/'))].insert(filePath);
+    const quint64 ticket = ++watchTicket;
+    watchProbes.insert(filePath, ticket);
+
+    const bool hashing = duplicatesCheckBox->isChecked();
+    const bool integrity = integrityCheckBox->isChecked();
+    const bool colors = colorsCheckBox->isChecked();
+    const int recompressQuality = recompressCheckBox->isChecked() ? recompressQualitySpin->value() : 0;
+    watchPool.start([this, filePath, ticket, hashing, integrity, colors, recompressQuality]() {
+        ImageInfo info = getImageInfo(filePath);
+        if (hashing) computeImageHashes(filePath, info);
+        if (integrity) verifyImageIntegrity(filePath, info);
+        if (colors) computeColorStats(filePath, info.colors);
+        if (recompressQuality > 0) estimateRecompression(filePath, recompressQuality, info.recompress);
+        QMetaObject::invokeMethod(this, [this, filePath, info, ticket]() {
+            onWatchProbed(filePath, info, ticket);
+        });
+    });
+}
+
+void MainWindow::onWatchProbed(const QString &filePath, const ImageInfo &info, quint64 ticket)
+{
+    auto probe = watchProbes.find(filePath);
+    if (probe == watchProbes.end() || probe.value() != ticket) return;
+    watchProbes.erase(probe);
+
+    auto it = rowByPath.constFind(filePath);
+    if (it != rowByPath.constEnd()) resultModel->updateResult(it.value(), filePath, info);
+    else rowByPath.insert(filePath, resultModel->appendResult(filePath, info));
+    ++watchUpdated;
+
+    if (!watchProbes.isEmpty()) return;
+    updateFormatFilter();
+    statusLabel->setText(QString("Наблюдение: обновлено %1 файлов").arg(watchUpdated));
+    watchUpdated = 0;
+}
 
-    QVector<ImageInfo> imageInfoList = variant.value<QVector<ImageInfo>>();
+void MainWindow::onTableCellClicked(const QModelIndex &index)
+{
+    // Данные читаются прямо из колоночного хранилища, без копирования
+    const ScanResults &results = resultModel->results();
+    int row = resultModel->storeRow(index);
 
-    if (row < 0 || row >= imageInfoList.size()) {
+    if (row < 0 || row >= results.size()) {
         quantMatrixDisplay->setText("Ошибка: неверный индекс строки");
         return;
     }
 
-    const ImageInfo &info = imageInfoList[row];
+    // Метаданные разбираются прямо по отображённому заголовку - это быстрее декодирования
+    QString filePath = results.filePath(row);
+    if (splitArchivePath(filePath)) {
+        metadataDisplay->setText("Метаданные членов архива не показываются");
+    } else {
+        FileView view(filePath);
+        ImageMetadata meta;
+        readImageMetadata(view, meta);
+        QString text = formatMetadata(meta);
+        IntegrityStatus integrity = static_cast<IntegrityStatus>(results.integrity(row));
+        if (integrity != IntegrityStatus::Unchecked) text += "\nЦелостность: " + integrityStatusName(integrity);
+        metadataDisplay->setText(text);
+    }
+
+    if (!results.hasDetails(row)) resultModel->requestDetails(row, true);
+
+    // Таблицы квантования читаются вместе с заголовком - ждём только заготовку
+    if (results.flags(row) & ImagePending) {
+        quantMatrixDisplay->setText("Загрузка...");
+        return;
+    }
 
-    if (info.hasQuantMatrix && !info.quantizationMatrix.isEmpty()) {
-        displayQuantizationMatrix(info.quantizationMatrix);
+    if (results.quantTableId(row) != 0) {
+        displayQuantTables(row);
     } else {
-        QString formatStr = tableWidget->item(row, 6)->text();
-        if (formatStr.toUpper().contains("JPG") || formatStr.toUpper().contains("JPEG")) {
+        QString formatStr = results.format(row);
+        if (formatStr.contains("JPG") || formatStr.contains("JPEG")) {
             quantMatrixDisplay->setText("Не удалось извлечь матрицу квантования из этого JPEG файла.");
         } else {
             quantMatrixDisplay->setText("Матрица квантования доступна только для JPEG файлов.\n\nВыбранный формат: " + formatStr);
@@ -298,27 +879,36 @@ void MainWindow::onTableCellClicked(int row, int column)
     }
 }
 
-void MainWindow::displayQuantizationMatrix(const QVector<QVector<int>> &matrix)
+void MainWindow::displayQuantTables(int row)
 {
-    if (matrix.isEmpty()) {
-        quantMatrixDisplay->setText("Матрица квантования пуста");
-        return;
-    }
-
-    QString text = "Матрица квантования (8x8):\n\n";
-    text += "┌─────────────────────────────────────────────────────────────┐\n";
-
-    for (int row = 0; row < matrix.size(); row++) {
-        text += "│ ";
-        for (int col = 0; col < matrix[row].size(); col++) {
-            text += QString("%1").arg(matrix[row][col], 3);
-            if (col < matrix[row].size() - 1) text += " ";
+    const ScanResults &results = resultModel->results();
+    const QByteArray &set = results.quantTables(row);
+    quint32 id = results.quantTableId(row);
+
+    QString quality = formatJpegQuality(results.jpegQuality(row));
+    QString text = QString("Качество: %1\n").arg(quality.isEmpty() ? QString("не оценить") : quality);
+    if (!results.encoder(row).isEmpty()) text += "Программа: " + results.encoder(row) + "\n";
+    text += QString("Набор таблиц №%1, такой же у файлов: %2 (всего наборов: %3)\n")
+                .arg(id).arg(results.quantTableUsers(id)).arg(results.quantTableSetCount());
+
+    std::array<quint16, 64> matrix;
+    int slot = 0;
+    for (int i = 0; quantTable(set, i, matrix, &slot); ++i) {
+        text += QString("\nТаблица %1%2 (8x8):\n").arg(slot)
+                    .arg(slot == 0 ? " - яркость" : slot == 1 ? " - цветность" : "");
+        text += "┌─────────────────────────────────┐\n";
+        for (int y = 0; y < 8; y++) {
+            text += "│ ";
+            for (int x = 0; x < 8; x++) {
+                text += QString("%1").arg(static_cast<int>(matrix[y * 8 + x]), 3);
+                if (x < 7) text += " ";
+            }
+            text += " │\n";
         }
-        text += " │\n";
+        text += "└─────────────────────────────────┘\n";
     }
 
-    text += "└─────────────────────────────────────────────────────────────┘\n\n";
-    text += "Меньшие значения = более высокое качество\n";
+    text += "\nМеньшие значения = более высокое качество\n";
     text += "Большие значения = более сильное сжатие";
 
     quantMatrixDisplay->setText(text);
@@ -2,13 +2,29 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTableWidget>
+#include <QTableView>
 #include <QPushButton>
 #include <QLineEdit>
 #include <QLabel>
 #include <QProgressBar>
 #include <QTextEdit>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QThreadPool>
 #include "imageinfo.h"
+#include "scanresultmodel.h"
+#include "scanstats.h"
+#include "thumbnailcache.h"
+#include "imagescanner.h"
+#include "detailloader.h"
 
 class MainWindow : public QMainWindow
 {
@@ -19,18 +35,93 @@ public:
 
 private slots:
     void onLoadImages();
-    void onTableCellClicked(int row, int column);
+    void onScanQueued(const QStringList &filePaths);
+    void onScanBatch(const QVector<ScanItem> &items);
+    void onScanFinished(bool cancelled);
+    void onCorpusUpdated(const CorpusStats &delta);
+    void onProbeFailed(const QString &filePath, const QString &reason);
+    void onTableCellClicked(const QModelIndex &index);
+    void onExportStats();
+    void onFilterChanged();
+    void onWatchToggled(bool enabled);
+    void onWatchedDirectoryChanged(const QString &path);
+    void applyWatchChanges();
+    void onWatchProbed(const QString &filePath, const ImageInfo &info, quint64 ticket);
 
 private:
-    QTableWidget *tableWidget;
+    QTableView *tableView;
+    ScanResultModel *resultModel;
+    ThumbnailCache *thumbnailCache;
+    DetailLoader *detailLoader;     // DPI, декодирование и матрица квантования - по требованию
     QPushButton *btnLoadImages;
+    QPushButton *btnCancelScan;
     QLineEdit *folderPathEdit;
+    QComboBox *accessModeCombo;  // mmap / pread для разбора заголовков
+    QComboBox *scanOrderCombo;   // порядок разбора: обход, inode, экстенты
     QProgressBar *progressBar;
     QLabel *statusLabel;
     QTextEdit *quantMatrixDisplay;  // Для отображения матрицы квантования
+    QTextEdit *metadataDisplay;     // EXIF, XMP и ICC выбранного файла
+    QTextEdit *statsDisplay;        // Статистика по этапам сканирования
+    QPushButton *btnExportStats;
+    ScanStats scanStats;
+    ImageScanner *scanner;          // фоновый обход и разбор папки
+    QElapsedTimer scanTimer;
+    int scanProcessed = 0;
+    qint64 scanHeaderBytes = 0;
+    QCheckBox *duplicatesCheckBox;
+    QCheckBox *archivesCheckBox;    // изображения внутри архивов
+    QCheckBox *integrityCheckBox;   // полная проверка целостности файлов
+    QCheckBox *isolateCheckBox;     // разбор и декодирование в процессах-воркерах
+    QCheckBox *colorsCheckBox;      // цветовая статистика при сканировании
+    QCheckBox *recompressCheckBox;  // оценка размера после пересжатия
+    QSpinBox *recompressQualitySpin; // качество JPEG для оценки
+    static const int kProbeTimeoutMs = 10000;
+    QStringList probeFailures;      // файлы, уронившие или подвесившие воркер, с причиной
+    QSpinBox *memoryBudgetSpin;     // МБ под страницы хранилища результатов
+    QComboBox *formatFilterCombo;   // отбор строк таблицы
+    QSpinBox *minSizeSpin;
+    QDoubleSpinBox *minPixelsSpin;
+    QCheckBox *alphaFilterCheckBox;
+    QLineEdit *queryEdit;           // выражение отбора (ResultQuery)
+    QTimer *queryTimer;             // отбор после паузы в наборе
+    QTextEdit *duplicatesDisplay;   // группы точных и почти-дубликатов
+    QTextEdit *corpusDisplay;       // сводка по набору, обновляется во время сканирования
+    CorpusStats corpusStats;
+
+    // Режим наблюдения за папкой: следим только за каталогами и по их событиям
+    // сверяем содержимое с отметками файлов - перечитываем только изменившиеся
+    struct FileStamp {
+        QDateTime modified;
+        qint64 size;
+    };
+    QCheckBox *watchCheckBox;
+    QFileSystemWatcher *folderWatcher;
+    QTimer *watchTimer;
+    QString scannedFolder;
+    static const int kMaxWatchedFiles = 200000;
+    QHash<QString, int> rowByPath;  // только пока включено наблюдение
+    QHash<QString, FileStamp> fileStamps;
+    QHash<QString, QSet<QString>> filesByDir;  // файлы таблицы по каталогам (без подкаталогов)
+    QSet<QString> pendingDirs;
+    // Изменившиеся файлы перечитываются в пуле, а не в потоке интерфейса. Номер
+    // запроса по пути: ответ на устаревший запрос (файл снова изменился, удалён,
+    // наблюдение выключено) отбрасывается
+    QThreadPool watchPool;
+    QHash<QString, quint64> watchProbes;
+    quint64 watchTicket = 0;
+    int watchUpdated = 0;
 
     void setupUI();
-    void displayQuantizationMatrix(const QVector<QVector<int>> &matrix);
+    static FileStamp fileStamp(const QString &filePath);
+    void showDuplicateGroups();
+    void updateCorpusDisplay(bool withQualityGroups);
+    QString scanStatsText() const;
+    void updateFormatFilter();
+    void startWatching();
+    void probeWatched(const QString &filePath);
+    void stopWatching();
+    void displayQuantTables(int row);
 };
 
 #endif // MAINWINDOW_H
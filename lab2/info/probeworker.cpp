@@ -0,0 +1,387 @@
+#include "probeworker.h"
+#include "imagehash.h"
+#include "integritycheck.h"
+#include "fileview.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QSaveFile>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+const char kProbeWorkerArgument[] = "--probe-worker";
+
+namespace {
+
+const int kWaitStepMs = 20;      // шаг ожидания ответа с проверкой отмены
+const int kStopWaitMs = 1000;    // сколько ждать завершения остановленного процесса
+
+QJsonObject requestToJson(const ProbeRequest &request)
+{
+    QJsonObject obj;
+    obj["path"] = request.filePath;
+    obj["tasks"] = request.tasks;
+    if (!request.format.isEmpty()) obj["format"] = request.format;
+    if (request.tasks & ProbeThumbnail) {
+        obj["thumbnailSize"] = request.thumbnailSize;
+        obj["thumbnailPath"] = request.thumbnailPath;
+    }
+    if (request.tasks & ProbeRecompress) obj["recompressQuality"] = request.recompressQuality;
+    return obj;
+}
+
+ProbeRequest requestFromJson(const QJsonObject &obj)
+{
+    ProbeRequest request;
+    request.filePath = obj["path"].toString();
+    request.tasks = obj["tasks"].toInt();
+    request.format = obj["format"].toString();
+    request.thumbnailSize = obj["thumbnailSize"].toInt();
+    request.thumbnailPath = obj["thumbnailPath"].toString();
+    request.recompressQuality = obj["recompressQuality"].toInt();
+    return request;
+}
+
+// Формат по первым байтам файла, без плагинов Qt: для файлов, на которых упал
+// или завис воркер, их canRead() в основном процессе так же опасен, как декодирование
+QString formatBySignature(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+    const QByteArray head = file.read(16);
+    auto at = [&head](int offset, const char *magic, int size) {
+        return head.size() >= offset + size && std::memcmp(head.constData() + offset, magic, size) == 0;
+    };
+    if (at(0, "\xFF\xD8\xFF", 3)) return "JPEG";
+    if (at(0, "\x89PNG\r\n\x1A\n", 8)) return "PNG";
+    if (at(0, "GIF87a", 6) || at(0, "GIF89a", 6)) return "GIF";
+    if (at(0, "BM", 2)) return "BMP";
+    if (at(0, "II*\0", 4) || at(0, "MM\0*", 4)) return "TIFF";
+    if (at(0, "RIFF", 4) && at(8, "WEBP", 4)) return "WEBP";
+    if (at(0, "\0\0\1\0", 4)) return "ICO";
+    return QString();
+}
+
+// ImageInfo целиком: 64-битные хеши - шестнадцатеричными строками (в double не влезают)
+QJsonObject replyToJson(const ImageInfo &info, const StageTimings &timings)
+{
+    QJsonObject obj;
+    obj["fileName"] = info.fileName;
+    obj["format"] = info.format;
+    obj["width"] = info.width;
+    obj["height"] = info.height;
+    obj["dpiX"] = info.dpiX;
+    obj["dpiY"] = info.dpiY;
+    obj["colorDepth"] = info.colorDepth;
+    obj["flags"] = info.flags;
+    obj["fileSize"] = info.fileSize;
+    obj["headerBytesRead"] = info.headerBytesRead;
+    obj["integrity"] = info.integrity;
+    if (!info.quantTables.isEmpty()) obj["quantTables"] = QString::fromLatin1(info.quantTables.toBase64());
+    if (!info.encoder.isEmpty()) obj["encoder"] = info.encoder;
+    if (info.flags & ImageHashed) {
+        obj["perceptualHash"] = QString::number(info.perceptualHash, 16);
+        obj["contentHash"] = QString::number(info.contentHash, 16);
+    }
+    if (info.colors.isValid()) {
+        const ColorStats &c = info.colors;
+        QJsonArray dominant, shares;
+        for (int k = 0; k < c.dominantCount; ++k) {
+            dominant.append(static_cast<qint64>(c.dominant[k]));
+            shares.append(c.dominantShare[k]);
+        }
+        QJsonObject colors;
+        colors["mean"] = static_cast<qint64>(c.mean);
+        colors["median"] = static_cast<qint64>(c.median);
+        colors["dominant"] = dominant;
+        colors["shares"] = shares;
+        colors["luma"] = QJsonArray{c.luma[0], c.luma[1], c.luma[2]};
+        colors["samples"] = static_cast<qint64>(c.samples);
+        obj["colors"] = colors;
+    }
+    if (info.recompress.isValid()) {
+        QJsonArray bytes;
+        for (qint64 size : info.recompress.bytes) bytes.append(size);
+        QJsonObject recompress;
+        recompress["bytes"] = bytes;
+        recompress["jpegQuality"] = info.recompress.jpegQuality;
+        recompress["exact"] = info.recompress.exact;
+        obj["recompress"] = recompress;
+    }
+    QJsonArray stages;
+    for (qint64 ns : timings.ns) stages.append(ns);
+    obj["timings"] = stages;
+    return obj;
+}
+
+bool replyFromJson(const QByteArray &line, ImageInfo &info, StageTimings &timings)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) return false;
+    QJsonObject obj = doc.object();
+
+    info.fileName = obj["fileName"].toString();
+    info.format = obj["format"].toString();
+    info.width = obj["width"].toInt(-1);
+    info.height = obj["height"].toInt(-1);
+    info.dpiX = obj["dpiX"].toInt();
+    info.dpiY = obj["dpiY"].toInt();
+    info.colorDepth = obj["colorDepth"].toInt();
+    info.flags = static_cast<quint8>(obj["flags"].toInt());
+    info.fileSize = obj["fileSize"].toInteger();
+    info.headerBytesRead = obj["headerBytesRead"].toInteger();
+    info.integrity = static_cast<quint8>(obj["integrity"].toInt());
+    info.quantTables = QByteArray::fromBase64(obj["quantTables"].toString().toLatin1());
+    info.encoder = obj["encoder"].toString();
+    info.perceptualHash = obj["perceptualHash"].toString().toULongLong(nullptr, 16);
+    info.contentHash = obj["contentHash"].toString().toULongLong(nullptr, 16);
+    if (obj.contains("colors")) {
+        QJsonObject colors = obj["colors"].toObject();
+        ColorStats &c = info.colors;
+        c.mean = static_cast<quint32>(colors["mean"].toInteger());
+        c.median = static_cast<quint32>(colors["median"].toInteger());
+        QJsonArray dominant = colors["dominant"].toArray();
+        QJsonArray shares = colors["shares"].toArray();
+        c.dominantCount = static_cast<quint8>(qMin<qsizetype>(dominant.size(), c.dominant.size()));
+        for (int k = 0; k < c.dominantCount; ++k) {
+            c.dominant[k] = static_cast<quint32>(dominant[k].toInteger());
+            c.dominantShare[k] = static_cast<quint8>(shares[k].toInt());
+        }
+        QJsonArray luma = colors["luma"].toArray();
+        for (int k = 0; k < 3 && k < luma.size(); ++k) c.luma[k] = static_cast<quint8>(luma[k].toInt());
+        c.samples = static_cast<quint32>(colors["samples"].toInteger());
+    }
+    if (obj.contains("recompress")) {
+        QJsonObject recompress = obj["recompress"].toObject();
+        QJsonArray bytes = recompress["bytes"].toArray();
+        for (int i = 0; i < RecompressTargetCount && i < bytes.size(); ++i)
+            info.recompress.bytes[i] = bytes[i].toInteger();
+        info.recompress.jpegQuality = static_cast<quint8>(recompress["jpegQuality"].toInt());
+        info.recompress.exact = recompress["exact"].toBool();
+    }
+    QJsonArray stages = obj["timings"].toArray();
+    for (int i = 0; i < stages.size() && i < static_cast<int>(timings.ns.size()); ++i)
+        timings.ns[i] = stages[i].toInteger();
+    return true;
+}
+
+}
+
+void runProbe(const ProbeRequest &request, ImageInfo &info, StageTimings &timings)
+{
+    const QString &filePath = request.filePath;
+    if (request.tasks & ProbeHeader) {
+        info = getImageHeaderInfo(filePath, &timings);
+    } else if (info.format.isEmpty()) {
+        info.format = request.format;
+    }
+    if (request.tasks & ProbeDetails) getImageDetails(filePath, info, &timings);
+    if (request.tasks & ProbeHash) {
+        QElapsedTimer hashTimer;
+        hashTimer.start();
+        computeImageHashes(filePath, info);
+        timings[ScanStage::Hash] = hashTimer.nsecsElapsed();
+    }
+    if (request.tasks & ProbeVerify) {
+        QElapsedTimer verifyTimer;
+        verifyTimer.start();
+        verifyImageIntegrity(filePath, info);
+        timings[ScanStage::Verify] = verifyTimer.nsecsElapsed();
+    }
+    if (request.tasks & ProbeColors) {
+        QElapsedTimer colorTimer;
+        colorTimer.start();
+        computeColorStats(filePath, info.colors);
+        timings[ScanStage::Colors] = colorTimer.nsecsElapsed();
+    }
+    if (request.tasks & ProbeRecompress) {
+        QElapsedTimer recompressTimer;
+        recompressTimer.start();
+        estimateRecompression(filePath, request.recompressQuality, info.recompress);
+        timings[ScanStage::Recompress] = recompressTimer.nsecsElapsed();
+    }
+    if (request.tasks & ProbeThumbnail) {
+        QImage image = decodeThumbnail(filePath, request.thumbnailSize);
+        if (!image.isNull()) writeThumbnail(image, request.thumbnailPath);
+    }
+}
+
+QImage decodeThumbnail(const QString &filePath, int size)
+{
+    QImageReader reader(filePath);
+    QSize full = reader.size();
+    if (full.isValid() && (full.width() > size || full.height() > size))
+        reader.setScaledSize(full.scaled(size, size, Qt::KeepAspectRatio));
+    QImage image = reader.read();
+    if (image.isNull()) return QImage();
+    if (image.width() > size || image.height() > size)
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;
+}
+
+bool writeThumbnail(const QImage &image, const QString &path)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile out(path);
+    return out.open(QIODevice::WriteOnly) && image.save(&out, "PNG") && out.commit();
+}
+
+int runProbeWorker()
+{
+    // Ответы - в копию stdout, а сам stdout, куда может писать декодер, - в stderr:
+    // посторонний вывод не смешается с протоколом
+    FILE *replies = stdout;
+#if defined(Q_OS_UNIX)
+    int replyFd = ::dup(STDOUT_FILENO);
+    if (replyFd >= 0 && ::dup2(STDERR_FILENO, STDOUT_FILENO) >= 0) {
+        if (FILE *stream = ::fdopen(replyFd, "w")) replies = stream;
+    }
+#elif defined(Q_OS_WIN)
+    // Протокол - строки с '\n': без двоичного режима CRT превратит их в "\r\n"
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+    int replyFd = _dup(_fileno(stdout));
+    if (replyFd >= 0 && _dup2(_fileno(stderr), _fileno(stdout)) == 0) {
+        if (FILE *stream = _fdopen(replyFd, "wb")) replies = stream;
+    }
+#endif
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromStdString(line));
+        ProbeRequest request = requestFromJson(doc.object());
+        ImageInfo info;
+        StageTimings timings;
+        if (!request.filePath.isEmpty()) runProbe(request, info, timings);
+        QByteArray reply = QJsonDocument(replyToJson(info, timings)).toJson(QJsonDocument::Compact) + '\n';
+        std::fwrite(reply.constData(), 1, reply.size(), replies);
+        std::fflush(replies);
+    }
+    return 0;
+}
+
+ProbeProcess::ProbeProcess(int timeoutMs, const std::atomic<bool> *cancelled)
+    : timeoutMs(timeoutMs), cancelled(cancelled)
+{
+}
+
+ProbeProcess::~ProbeProcess()
+{
+    if (!process) return;
+    // Конец stdin - воркер выходит сам
+    process->closeWriteChannel();
+    if (!process->waitForFinished(kStopWaitMs)) stop();
+}
+
+bool ProbeProcess::ensureStarted()
+{
+    if (process && process->state() == QProcess::Running) return true;
+    if (startFailed) return false;
+
+    process = std::make_unique<QProcess>();
+    process->setProgram(QCoreApplication::applicationFilePath());
+    process->setArguments({QString::fromLatin1(kProbeWorkerArgument)});
+    // Воркер читает файлы тем же способом, что и основной процесс
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("INFO_FILE_ACCESS", fileAccessModeName(fileAccessMode()));
+    process->setProcessEnvironment(environment);
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process->start();
+    if (!process->waitForStarted(timeoutMs)) {
+        std::fprintf(stderr, "Не удалось запустить процесс-воркер: %s\n", qPrintable(process->errorString()));
+        process.reset();
+        startFailed = true;  // больше не пытаемся - разбор пойдёт в своём процессе
+        return false;
+    }
+    return true;
+}
+
+void ProbeProcess::stop()
+{
+    if (!process) return;
+    process->kill();
+    process->waitForFinished(kStopWaitMs);
+    process.reset();
+}
+
+ProbeProcess::Outcome ProbeProcess::run(const ProbeRequest &request, ImageInfo &info, StageTimings &timings)
+{
+    if (!ensureStarted()) return Unavailable;
+
+    process->write(QJsonDocument(requestToJson(request)).toJson(QJsonDocument::Compact) + '\n');
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!process->canReadLine()) {
+        if (cancelled && cancelled->load()) {
+            stop();
+            return Cancelled;
+        }
+        if (process->state() != QProcess::Running) {
+            stop();
+            ++restartCount;
+            return Crashed;
+        }
+        qint64 left = timeoutMs - timer.elapsed();
+        if (left <= 0) {
+            stop();
+            ++restartCount;
+            return TimedOut;
+        }
+        process->waitForReadyRead(static_cast<int>(qMin<qint64>(left, kWaitStepMs)));
+    }
+
+    if (!replyFromJson(process->readLine(), info, timings)) {
+        // Ответ не разобрался - протокол сбит, процесс лучше начать заново
+        stop();
+        ++restartCount;
+        return Crashed;
+    }
+    return Done;
+}
+
+QString probeOutcomeName(ProbeProcess::Outcome outcome)
+{
+    switch (outcome) {
+    case ProbeProcess::Done: return "разобран";
+    case ProbeProcess::Crashed: return "процесс-воркер аварийно завершился";
+    case ProbeProcess::TimedOut: return "процесс-воркер не ответил вовремя и остановлен";
+    case ProbeProcess::Cancelled: return "отменено";
+    case ProbeProcess::Unavailable: return "процесс-воркер не запускается";
+    }
+    return QString();
+}
+
+void markProbeFailure(const QString &filePath, ImageInfo &info, ProbeProcess::Outcome outcome)
+{
+    // Этот файл уронил или подвесил воркер: в своём процессе его не трогают даже
+    // плагины Qt. Формат - по сигнатуре, не узнали - по расширению
+    QFileInfo fi(filePath);
+    info = ImageInfo();
+    info.fileName = fi.fileName();
+    info.fileSize = fi.size();
+    info.format = formatBySignature(filePath);
+    if (info.format.isEmpty()) info.format = fi.suffix().toUpper();
+    info.flags = ImageCorrupt | ImageDetailed;
+    IntegrityStatus status = outcome == ProbeProcess::TimedOut ? IntegrityStatus::DecoderTimeout
+                                                               : IntegrityStatus::DecoderCrashed;
+    info.integrity = static_cast<quint8>(status);
+}
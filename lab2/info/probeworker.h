@@ -0,0 +1,90 @@
+#ifndef PROBEWORKER_H
+#define PROBEWORKER_H
+
+#include <QString>
+#include <QImage>
+#include <atomic>
+#include <memory>
+#include "imageinfo.h"
+
+class QProcess;
+
+// Что сделать с файлом при разборе (флаги сочетаются)
+enum ProbeTask : quint8 {
+    ProbeHeader    = 0x01,  // getImageHeaderInfo
+    ProbeDetails   = 0x02,  // getImageDetails - полное декодирование
+    ProbeHash      = 0x04,  // computeImageHashes
+    ProbeVerify    = 0x08,  // verifyImageIntegrity
+    ProbeThumbnail = 0x10,  // миниатюра в PNG-файл thumbnailPath
+    ProbeColors    = 0x20,  // computeColorStats
+    ProbeRecompress = 0x40  // estimateRecompression с качеством JPEG recompressQuality
+};
+
+struct ProbeRequest {
+    QString filePath;
+    int tasks = ProbeHeader;
+    QString format;          // для ProbeDetails без ProbeHeader - формат, известный по таблице
+    int thumbnailSize = 0;
+    QString thumbnailPath;
+    int recompressQuality = 0;
+};
+
+// Разбор в текущем процессе - то же самое делает процесс-воркер
+void runProbe(const ProbeRequest &request, ImageInfo &info, StageTimings &timings);
+
+// Миниатюра не больше size по длинной стороне: JPEG декодируется сразу уменьшенным
+QImage decodeThumbnail(const QString &filePath, int size);
+bool writeThumbnail(const QImage &image, const QString &path);  // PNG, атомарно
+
+// Аргумент командной строки, с которым программа работает процессом-воркером
+extern const char kProbeWorkerArgument[];
+
+// Цикл процесса-воркера: запросы - по строке JSON из stdin, ответы - по строке
+// JSON в stdout, пока stdin не закроют. Вывод декодеров в stdout уходит в stderr
+int runProbeWorker();
+
+// Процесс-воркер, изолирующий сторонние декодеры: падение или зависание на
+// испорченном файле убивает только его, а не программу с результатами.
+// Обмен - через каналы stdin/stdout. Синхронный и принадлежит одному потоку
+// (QProcess нельзя передавать между потоками), поэтому воркеров столько же,
+// сколько потоков разбора, и блокировки декодеров одного процесса не мешают
+// остальным. Процесс запускается при первом запросе и перезапускается после
+// аварии; файл, на котором она случилась, возвращается как Crashed или TimedOut
+class ProbeProcess {
+public:
+    enum Outcome {
+        Done,
+        Crashed,      // процесс завершился, не ответив
+        TimedOut,     // не ответил за timeoutMs - остановлен
+        Cancelled,    // взведён флаг отмены - процесс остановлен
+        Unavailable   // процесс не запускается - разбирать в своём процессе
+    };
+
+    explicit ProbeProcess(int timeoutMs, const std::atomic<bool> *cancelled = nullptr);
+    ~ProbeProcess();
+
+    ProbeProcess(const ProbeProcess &) = delete;
+    ProbeProcess &operator=(const ProbeProcess &) = delete;
+
+    Outcome run(const ProbeRequest &request, ImageInfo &info, StageTimings &timings);
+    int restarts() const { return restartCount; }
+    int timeout() const { return timeoutMs; }
+
+private:
+    bool ensureStarted();
+    void stop();
+
+    std::unique_ptr<QProcess> process;
+    int timeoutMs;
+    const std::atomic<bool> *cancelled;
+    int restartCount = 0;
+    bool startFailed = false;
+};
+
+QString probeOutcomeName(ProbeProcess::Outcome outcome);
+
+// Отметка о файле, уронившем или подвесившем воркер: ImageCorrupt, ImageDetailed
+// (повторно не декодировать) и integrity = DecoderCrashed / DecoderTimeout
+void markProbeFailure(const QString &filePath, ImageInfo &info, ProbeProcess::Outcome outcome);
+
+#endif // PROBEWORKER_H
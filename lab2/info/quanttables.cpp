@@ -0,0 +1,184 @@
+#include "quanttables.h"
+#include "fileview.h"
+#include <limits>
+
+namespace {
+
+const int kMaxTables = 4;  // Tq - от 0 до 3
+
+// Номер позиции в естественном порядке для каждой позиции зигзага
+const int kNaturalOrder[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Таблицы из приложения K стандарта - от них libjpeg масштабирует качество
+const quint16 kStdLuminance[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+const quint16 kStdChrominance[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Значение таблицы libjpeg для качества quality (jpeg_quality_scaling + jpeg_add_quant_table)
+int ijgValue(quint16 standard, int quality, int limit)
+{
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    int value = (standard * scale + 50) / 100;
+    return qBound(1, value, limit);
+}
+
+}
+
+QByteArray extractQuantizationTables(FileView &view)
+{
+    const uchar *soi = view.data(0, 2);
+    if (!soi || soi[0] != 0xFF || soi[1] != 0xD8) return QByteArray();
+
+    QByteArray slots[kMaxTables];
+    qint64 pos = 2;
+    while (pos + 4 <= view.size()) {
+        const uchar *marker = view.data(pos, 2);
+        if (!marker || marker[0] != 0xFF) break;
+
+        unsigned char code = marker[1];
+        if (code == 0xFF) {  // байт-заполнитель
+            pos++;
+            continue;
+        }
+        if (code == 0x01 || (code >= 0xD0 && code <= 0xD7)) {  // маркеры без длины
+            pos += 2;
+            continue;
+        }
+        if (code == 0xDA || code == 0xD9) break;  // начало скана или конец файла
+
+        const uchar *lenBytes = view.data(pos + 2, 2);
+        if (!lenBytes) break;
+        int length = (lenBytes[0] << 8) | lenBytes[1];
+        if (length < 2) break;
+
+        // DQT (0xFFDB): в одном сегменте может быть несколько таблиц подряд
+        if (code == 0xDB) {
+            const uchar *segment = view.data(pos + 4, length - 2);
+            if (!segment) break;
+            int at = 0;
+            while (at < length - 2) {
+                int precision = segment[at] >> 4;  // 0 - 8 бит, 1 - 16 бит
+                int slot = segment[at] & 0x0F;
+                int bytes = 1 + 64 * (precision ? 2 : 1);
+                if (precision > 1 || slot >= kMaxTables || at + bytes > length - 2) break;
+                slots[slot] = QByteArray(reinterpret_cast<const char *>(segment + at), bytes);
+                at += bytes;
+            }
+        }
+
+        pos += 2 + length;
+    }
+
+    QByteArray set;
+    for (const QByteArray &table : slots) set += table;
+    return set;
+}
+
+int quantTableCount(const QByteArray &set)
+{
+    int count = 0;
+    for (int at = 0; at < set.size(); at += 1 + 64 * ((uchar(set[at]) >> 4) ? 2 : 1)) ++count;
+    return count;
+}
+
+bool quantTable(const QByteArray &set, int index, std::array<quint16, 64> &values, int *slot)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(set.constData());
+    int at = 0;
+    for (int i = 0; at < set.size(); ++i) {
+        bool wide = (p[at] >> 4) != 0;
+        if (i == index) {
+            if (slot) *slot = p[at] & 0x0F;
+            const uchar *data = p + at + 1;
+            for (int k = 0; k < 64; ++k)
+                values[kNaturalOrder[k]] = wide ? quint16((data[k * 2] << 8) | data[k * 2 + 1]) : data[k];
+            return true;
+        }
+        at += 1 + 64 * (wide ? 2 : 1);
+    }
+    return false;
+}
+
+JpegQuality estimateJpegQuality(const QByteArray &set)
+{
+    // Сравниваем таблицы яркости (Tq 0) и цветности (Tq 1) с таблицами libjpeg
+    // для каждого качества и берём ближайшее. Набор оценивается один раз на пул,
+    // поэтому полный перебор 100 вариантов дешевле любой аналитической оценки
+    JpegQuality result;
+    std::array<quint16, 64> values[2];
+    bool present[2] = {false, false};
+    int limit = 255;  // cjpeg по умолчанию ограничивает значения 8 битами (force_baseline)
+    std::array<quint16, 64> table;
+    int slot = 0;
+    for (int i = 0; quantTable(set, i, table, &slot); ++i) {
+        if (slot > 1) continue;
+        values[slot] = table;
+        present[slot] = true;
+        for (quint16 v : table)
+            if (v > 255) limit = 32767;
+    }
+    if (!present[0]) return result;
+
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int quality = 1; quality <= 100; ++quality) {
+        qint64 distance = 0;
+        for (int i = 0; i < 64; ++i) {
+            distance += qAbs(values[0][i] - ijgValue(kStdLuminance[i], quality, limit));
+            if (present[1]) distance += qAbs(values[1][i] - ijgValue(kStdChrominance[i], quality, limit));
+        }
+        if (distance < best) {
+            best = distance;
+            result.quality = quality;
+        }
+    }
+    result.exactIjg = best == 0;
+    return result;
+}
+
+QString formatJpegQuality(const JpegQuality &quality)
+{
+    if (quality.quality <= 0) return QString();
+    return quality.exactIjg ? QString("Q%1 (IJG)").arg(quality.quality) : QString("≈Q%1").arg(quality.quality);
+}
+
+QuantTablePool::QuantTablePool()
+{
+    // Номер 0 - "таблиц нет"
+    sets.append(QByteArray());
+    qualities.append(JpegQuality());
+}
+
+quint32 QuantTablePool::intern(const QByteArray &set)
+{
+    if (set.isEmpty()) return 0;
+    auto it = ids.constFind(set);
+    if (it != ids.constEnd()) return it.value();
+    quint32 id = static_cast<quint32>(sets.size());
+    sets.append(set);
+    qualities.append(estimateJpegQuality(set));
+    ids.insert(set, id);
+    return id;
+}
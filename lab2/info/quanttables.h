@@ -0,0 +1,50 @@
+#ifndef QUANTTABLES_H
+#define QUANTTABLES_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <array>
+
+class FileView;
+
+// Набор таблиц квантования JPEG - все DQT до первого скана - в каноническом виде:
+// по возрастанию номера таблицы байт (Pq << 4 | Tq) и 64 значения по 1 или 2 байта
+// в зигзаг-порядке, как в сегменте DQT. Повторное определение таблицы заменяет
+// прежнее, поэтому одинаковые наборы дают одинаковые байты. Пусто - таблиц нет
+QByteArray extractQuantizationTables(FileView &view);
+
+int quantTableCount(const QByteArray &set);
+// Таблица index набора в естественном порядке (строки 8x8); slot - её номер Tq.
+// false - такой таблицы нет
+bool quantTable(const QByteArray &set, int index, std::array<quint16, 64> &values, int *slot = nullptr);
+
+// Оценка коэффициента качества IJG (libjpeg, -quality) по набору таблиц
+struct JpegQuality {
+    int quality = 0;        // 1..100, 0 - не оценить
+    bool exactIjg = false;  // таблицы в точности как у libjpeg с этим качеством
+};
+
+JpegQuality estimateJpegQuality(const QByteArray &set);
+QString formatJpegQuality(const JpegQuality &quality);  // "Q85 (IJG)", "≈Q92"
+
+// Пул интернированных наборов: одинаковые наборы со всего корпуса хранятся один раз,
+// качество оценивается при первом появлении набора. Номер 0 - таблиц нет.
+// Не потокобезопасен, как и StringPool
+class QuantTablePool {
+public:
+    QuantTablePool();
+
+    quint32 intern(const QByteArray &set);
+    const QByteArray &tables(quint32 id) const { return sets[id]; }
+    const JpegQuality &quality(quint32 id) const { return qualities[id]; }
+    int size() const { return sets.size(); }
+
+private:
+    QVector<QByteArray> sets;
+    QVector<JpegQuality> qualities;
+    QHash<QByteArray, quint32> ids;
+};
+
+#endif // QUANTTABLES_H
@@ -0,0 +1,153 @@
+#include "recompress.h"
+#include "imageinfo.h"
+#include <QBuffer>
+#include <QHash>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QStringList>
+
+namespace {
+
+const char *const kWriterFormats[RecompressTargetCount] = {"png", "jpeg", "webp"};
+
+// Размер изображения в формате target; -1 - кодировщика нет или ошибка записи
+qint64 encodedSize(const QImage &image, RecompressTarget target, int jpegQuality)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, kWriterFormats[target]);
+    // Модуль WebP из qtimageformats при качестве 100 сжимает без потерь
+    if (target == RecompressJpeg) writer.setQuality(jpegQuality);
+    else if (target == RecompressWebp) writer.setQuality(100);
+    if (!writer.write(image)) return -1;
+    return buffer.size();
+}
+
+// Постоянная часть файла (заголовки, таблицы) - размер крошечного однотонного изображения.
+// У каждой плитки она своя, а у целого файла - одна, поэтому из плиток её вычитаем.
+// Считается один раз на пару (формат, качество) и кешируется для всех потоков
+qint64 formatOverhead(RecompressTarget target, int jpegQuality)
+{
+    static QMutex mutex;
+    static QHash<int, qint64> cache;
+    const int key = target * 128 + (target == RecompressJpeg ? jpegQuality : 0);
+    {
+        QMutexLocker locker(&mutex);
+        auto it = cache.constFind(key);
+        if (it != cache.constEnd()) return it.value();
+    }
+    QImage blank(8, 8, QImage::Format_RGB32);
+    blank.fill(Qt::gray);
+    qint64 overhead = qMax<qint64>(0, encodedSize(blank, target, jpegQuality));
+    QMutexLocker locker(&mutex);
+    cache.insert(key, overhead);
+    return overhead;
+}
+
+}
+
+qint64 RecompressEstimate::best() const
+{
+    qint64 result = -1;
+    for (qint64 size : bytes)
+        if (size >= 0 && (result < 0 || size < result)) result = size;
+    return result;
+}
+
+bool recompressTargetAvailable(RecompressTarget target)
+{
+    static const QList<QByteArray> formats = QImageWriter::supportedImageFormats();
+    return formats.contains(kWriterFormats[target]);
+}
+
+QString recompressTargetName(RecompressTarget target, int jpegQuality)
+{
+    switch (target) {
+    case RecompressPng: return "PNG";
+    case RecompressJpeg: return jpegQuality > 0 ? QString("JPEG Q%1").arg(jpegQuality) : QString("JPEG");
+    case RecompressWebp: return "WebP";
+    default: return QString();
+    }
+}
+
+QString formatRecompressEstimate(const RecompressEstimate &estimate)
+{
+    if (!estimate.isValid()) return QString();
+    QStringList parts;
+    for (int target = 0; target < RecompressTargetCount; ++target) {
+        if (estimate.bytes[target] < 0) continue;
+        parts.append(recompressTargetName(static_cast<RecompressTarget>(target), estimate.jpegQuality) + " "
+                     + formatFileSize(estimate.bytes[target]));
+    }
+    return parts.join(", ");
+}
+
+bool estimateRecompression(const QString &filePath, int jpegQuality, RecompressEstimate &estimate)
+{
+    QImageReader reader(filePath);
+    QImage image = reader.read();
+    if (image.isNull()) return false;
+    return estimateRecompression(image, jpegQuality, static_cast<quint32>(qHash(filePath)), estimate);
+}
+
+bool estimateRecompression(const QImage &image, int jpegQuality, quint32 seed, RecompressEstimate &estimate)
+{
+    estimate = RecompressEstimate();
+    if (image.isNull() || jpegQuality < 1 || jpegQuality > 100) return false;
+    estimate.jpegQuality = static_cast<quint8>(jpegQuality);
+
+    const qint64 pixels = static_cast<qint64>(image.width()) * image.height();
+    const qint64 sampleArea = static_cast<qint64>(kRecompressGrid) * kRecompressGrid * kRecompressTile * kRecompressTile;
+    if (pixels <= sampleArea) {
+        // Маленькое изображение дешевле закодировать целиком
+        estimate.exact = true;
+        for (int target = 0; target < RecompressTargetCount; ++target) {
+            if (recompressTargetAvailable(static_cast<RecompressTarget>(target)))
+                estimate.bytes[target] = encodedSize(image, static_cast<RecompressTarget>(target), jpegQuality);
+        }
+        return true;
+    }
+
+    // По плитке в каждой ячейке сетки: выборка покрывает и края, и середину
+    QRandomGenerator random(seed);
+    QVector<QImage> tiles;
+    qint64 tilePixels = 0;
+    for (int gy = 0; gy < kRecompressGrid; ++gy) {
+        for (int gx = 0; gx < kRecompressGrid; ++gx) {
+            int x0 = image.width() * gx / kRecompressGrid;
+            int y0 = image.height() * gy / kRecompressGrid;
+            int cellWidth = image.width() * (gx + 1) / kRecompressGrid - x0;
+            int cellHeight = image.height() * (gy + 1) / kRecompressGrid - y0;
+            int w = qMin(kRecompressTile, cellWidth);
+            int h = qMin(kRecompressTile, cellHeight);
+            if (w <= 0 || h <= 0) continue;
+            int x = x0 + (cellWidth > w ? random.bounded(cellWidth - w + 1) : 0);
+            int y = y0 + (cellHeight > h ? random.bounded(cellHeight - h + 1) : 0);
+            tiles.append(image.copy(x, y, w, h));
+            tilePixels += static_cast<qint64>(w) * h;
+        }
+    }
+    if (tilePixels == 0) return false;
+
+    for (int target = 0; target < RecompressTargetCount; ++target) {
+        RecompressTarget format = static_cast<RecompressTarget>(target);
+        if (!recompressTargetAvailable(format)) continue;
+        const qint64 overhead = formatOverhead(format, jpegQuality);
+        qint64 payload = 0;
+        bool ok = true;
+        for (const QImage &tile : std::as_const(tiles)) {
+            qint64 size = encodedSize(tile, format, jpegQuality);
+            if (size < 0) {
+                ok = false;
+                break;
+            }
+            payload += qMax<qint64>(0, size - overhead);
+        }
+        if (ok) estimate.bytes[target] = overhead + static_cast<qint64>(double(payload) * pixels / tilePixels);
+    }
+    return true;
+}
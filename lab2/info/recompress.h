@@ -0,0 +1,43 @@
+#ifndef RECOMPRESS_H
+#define RECOMPRESS_H
+
+#include <QString>
+#include <array>
+
+class QImage;
+
+// Во что пересжимаем
+enum RecompressTarget {
+    RecompressPng,
+    RecompressJpeg,   // с заданным качеством
+    RecompressWebp,   // WebP без потерь, если есть модуль qtimageformats
+    RecompressTargetCount
+};
+
+// Ожидаемый размер файла после пересжатия, байт
+struct RecompressEstimate {
+    std::array<qint64, RecompressTargetCount> bytes{-1, -1, -1};  // -1 - кодировщика нет
+    quint8 jpegQuality = 0;   // 0 - оценки нет
+    bool exact = false;       // изображение меньше выборки и закодировано целиком
+
+    bool isValid() const { return jpegQuality > 0; }
+    qint64 best() const;      // наименьший из оценённых, -1 - нет
+};
+
+const int kRecompressTile = 128;   // сторона плитки выборки
+const int kRecompressGrid = 4;     // сетка 4x4 - по плитке на ячейку
+
+// Стратифицированная выборка: изображение делится на сетку, в каждой ячейке
+// кодируется одна плитка в случайном (но повторяемом для файла) месте. Байт на
+// пиксель по плиткам без постоянных заголовков формата переносятся на всё
+// изображение. Декодирование полное, кодируется около 16 плиток вместо всего
+// изображения. Потокобезопасно: файлы оцениваются параллельно в потоках разбора
+bool estimateRecompression(const QString &filePath, int jpegQuality, RecompressEstimate &estimate);
+bool estimateRecompression(const QImage &image, int jpegQuality, quint32 seed, RecompressEstimate &estimate);
+
+bool recompressTargetAvailable(RecompressTarget target);
+QString recompressTargetName(RecompressTarget target, int jpegQuality = 0);  // "PNG", "JPEG Q85", "WebP"
+// "PNG 1250.0 KB, JPEG Q85 340.2 KB, WebP 910.7 KB"; нет оценки - пустая строка
+QString formatRecompressEstimate(const RecompressEstimate &estimate);
+
+#endif // RECOMPRESS_H
@@ -0,0 +1,224 @@
+#include "recordwriter.h"
+#include "integritycheck.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QMutexLocker>
+
+namespace {
+
+const QStringList kCsvColumns = {
+    "path", "fileName", "format", "width", "height", "dpiX", "dpiY", "colorDepth",
+    "compression", "colorSpace", "fileSize", "grayscale", "indexed", "alpha", "decoded", "detailed", "headerBytesRead"
+};
+// Необязательные группы - в порядке битов CsvColumnGroup
+const QStringList kCsvIntegrityColumns = {"integrity"};
+const QStringList kCsvQualityColumns = {"encoder", "jpegQuality", "quantTableSet"};
+const QStringList kCsvColorColumns = {"meanColor", "medianColor", "dominantColors", "luma5", "luma50", "luma95"};
+const QStringList kCsvRecompressColumns = {"pngEstimate", "jpegEstimate", "jpegEstimateQuality", "webpLosslessEstimate"};
+
+QString csvEscape(const QString &value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n') && !value.contains('\r'))
+        return value;
+    QString escaped = value;
+    escaped.replace("\"", "\"\"");
+    return "\"" + escaped + "\"";
+}
+
+}
+
+RecordFormat recordFormatFromString(const QString &name, bool *ok)
+{
+    QString n = name.trimmed().toLower();
+    if (ok) *ok = true;
+    if (n == "csv") return RecordFormat::Csv;
+    if (ok) *ok = (n == "jsonl" || n == "json");
+    return RecordFormat::JsonLines;
+}
+
+QJsonObject imageInfoToJson(const QString &filePath, const ImageInfo &info)
+{
+    QJsonObject obj;
+    obj["path"] = filePath;
+    obj["fileName"] = info.fileName;
+    obj["format"] = info.format;
+    obj["width"] = info.width;
+    obj["height"] = info.height;
+    obj["dpiX"] = info.dpiX;
+    obj["dpiY"] = info.dpiY;
+    obj["colorDepth"] = info.colorDepth;
+    obj["compression"] = getCompressionInfo(info.format);
+    obj["colorSpace"] = getColorSpaceInfo(info.format);
+    obj["fileSize"] = info.fileSize;
+    obj["decoded"] = bool(info.flags & ImageDecoded);
+    // Без деталей (разбор по началу файла, --io) глубина и каналы - оценка по формату
+    // пикселей заголовка, DPI - только из метаданных
+    obj["detailed"] = bool(info.flags & ImageDetailed);
+    obj["grayscale"] = bool(info.flags & ImageGrayscale);
+    obj["indexed"] = bool(info.flags & ImageIndexed);
+    obj["alpha"] = bool(info.flags & ImageAlpha);
+    obj["headerBytesRead"] = info.headerBytesRead;
+    if (info.integrity != 0) obj["integrity"] = integrityStatusId(static_cast<IntegrityStatus>(info.integrity));
+    if (!info.encoder.isEmpty()) obj["encoder"] = info.encoder;
+
+    if (info.flags & ImageHashed) {
+        obj["perceptualHash"] = QString("%1").arg(info.perceptualHash, 16, 16, QChar('0'));
+        obj["contentHash"] = QString("%1").arg(info.contentHash, 16, 16, QChar('0'));
+    }
+    if (info.colors.isValid()) {
+        const ColorStats &c = info.colors;
+        QJsonObject colors;
+        colors["mean"] = formatColor(c.mean);
+        colors["median"] = formatColor(c.median);
+        QJsonArray dominant;
+        for (int k = 0; k < c.dominantCount; ++k) {
+            QJsonObject color;
+            color["color"] = formatColor(c.dominant[k]);
+            color["share"] = c.dominantShare[k];
+            dominant.append(color);
+        }
+        colors["dominant"] = dominant;
+        colors["luma"] = QJsonObject{{"p5", c.luma[0]}, {"p50", c.luma[1]}, {"p95", c.luma[2]}};
+        obj["colors"] = colors;
+    }
+    if (info.recompress.isValid()) {
+        // Оценка по выборке плиток, байт; кодировщика нет - поля нет
+        const RecompressEstimate &estimate = info.recompress;
+        QJsonObject recompress;
+        if (estimate.bytes[RecompressPng] >= 0) recompress["png"] = estimate.bytes[RecompressPng];
+        if (estimate.bytes[RecompressJpeg] >= 0) recompress["jpeg"] = estimate.bytes[RecompressJpeg];
+        recompress["jpegQuality"] = estimate.jpegQuality;
+        if (estimate.bytes[RecompressWebp] >= 0) recompress["webpLossless"] = estimate.bytes[RecompressWebp];
+        recompress["exact"] = estimate.exact;
+        obj["recompress"] = recompress;
+    }
+    return obj;
+}
+
+RecordWriter::RecordWriter(FILE *out, RecordFormat format, int csvGroups)
+    : out(out), format(format), csvGroups(csvGroups)
+{
+}
+
+void RecordWriter::writeHeader()
+{
+    if (format != RecordFormat::Csv) return;
+    QStringList columns = kCsvColumns;
+    if (csvGroups & CsvIntegrity) columns += kCsvIntegrityColumns;
+    if (csvGroups & CsvQuality) columns += kCsvQualityColumns;
+    if (csvGroups & CsvColors) columns += kCsvColorColumns;
+    if (csvGroups & CsvRecompress) columns += kCsvRecompressColumns;
+    QMutexLocker locker(&mutex);
+    QByteArray line = columns.join(',').toUtf8() + '\n';
+    std::fwrite(line.constData(), 1, line.size(), out);
+    std::fflush(out);
+}
+
+void RecordWriter::write(const QString &filePath, const ImageInfo &info)
+{
+    // Набор таблиц оценивается при первом появлении, дальше - поиск по хешу.
+    // Номер выдаётся и описание набора пишется под одной блокировкой: запись другого
+    // потока с тем же номером не может обогнать описание
+    quint32 setId = 0;
+    JpegQuality quality;
+    if (!info.quantTables.isEmpty()) {
+        QMutexLocker locker(&mutex);
+        int before = quantPool.size();
+        setId = quantPool.intern(info.quantTables);
+        quality = quantPool.quality(setId);
+        if (format == RecordFormat::JsonLines && quantPool.size() != before) {
+            QJsonArray tables;
+            std::array<quint16, 64> values;
+            for (int i = 0; quantTable(info.quantTables, i, values); ++i) {
+                QJsonArray table;
+                for (quint16 v : values) table.append(int(v));
+                tables.append(table);
+            }
+            QJsonObject definition;
+            definition["quantTableSet"] = static_cast<qint64>(setId);
+            definition["quantizationTables"] = tables;
+            QByteArray line = QJsonDocument(definition).toJson(QJsonDocument::Compact) + '\n';
+            std::fwrite(line.constData(), 1, line.size(), out);
+        }
+    }
+
+    // Сама запись форматируется вне блокировки, под ней только вывод
+    QByteArray line = formatRecord(filePath, info, setId, quality);
+    QMutexLocker locker(&mutex);
+    std::fwrite(line.constData(), 1, line.size(), out);
+    std::fflush(out);
+    ++written;
+}
+
+int RecordWriter::quantTableSetCount() const
+{
+    QMutexLocker locker(&mutex);
+    return quantPool.size() - 1;
+}
+
+QByteArray RecordWriter::formatRecord(const QString &filePath, const ImageInfo &info, quint32 setId,
+                                      const JpegQuality &quality)
+{
+    if (format == RecordFormat::JsonLines) {
+        QJsonObject obj = imageInfoToJson(filePath, info);
+        if (setId != 0) {
+            obj["quantTableSet"] = static_cast<qint64>(setId);
+            if (quality.quality > 0) obj["jpegQuality"] = quality.quality;
+            obj["ijgTables"] = quality.exactIjg;
+        }
+        return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+    }
+
+    QStringList fields = {
+        filePath, info.fileName, info.format,
+        QString::number(info.width), QString::number(info.height),
+        QString::number(info.dpiX), QString::number(info.dpiY), QString::number(info.colorDepth),
+        getCompressionInfo(info.format), getColorSpaceInfo(info.format),
+        QString::number(info.fileSize),
+        QString::number(info.flags & ImageGrayscale ? 1 : 0),
+        QString::number(info.flags & ImageIndexed ? 1 : 0),
+        QString::number(info.flags & ImageAlpha ? 1 : 0),
+        QString::number(info.flags & ImageDecoded ? 1 : 0),
+        QString::number(info.flags & ImageDetailed ? 1 : 0),
+        QString::number(info.headerBytesRead)
+    };
+    if (csvGroups & CsvIntegrity)
+        fields += info.integrity != 0 ? integrityStatusId(static_cast<IntegrityStatus>(info.integrity)) : QString();
+    if (csvGroups & CsvQuality) {
+        fields += {
+            info.encoder,
+            quality.quality > 0 ? QString::number(quality.quality) : QString(),
+            setId != 0 ? QString::number(setId) : QString()
+        };
+    }
+    if (csvGroups & CsvColors) {
+        // Основные цвета - через пробел: "#RRGGBB:41 #RRGGBB:20"
+        const ColorStats &c = info.colors;
+        QStringList dominant;
+        for (int k = 0; k < c.dominantCount; ++k)
+            dominant.append(formatColor(c.dominant[k]) + ":" + QString::number(c.dominantShare[k]));
+        fields += {
+            c.isValid() ? formatColor(c.mean) : QString(),
+            c.isValid() ? formatColor(c.median) : QString(),
+            dominant.join(' '),
+            c.isValid() ? QString::number(c.luma[0]) : QString(),
+            c.isValid() ? QString::number(c.luma[1]) : QString(),
+            c.isValid() ? QString::number(c.luma[2]) : QString()
+        };
+    }
+    if (csvGroups & CsvRecompress) {
+        const RecompressEstimate &estimate = info.recompress;
+        auto estimateField = [&estimate](RecompressTarget target) {
+            return estimate.isValid() && estimate.bytes[target] >= 0 ? QString::number(estimate.bytes[target])
+                                                                     : QString();
+        };
+        fields += {
+            estimateField(RecompressPng), estimateField(RecompressJpeg),
+            estimate.isValid() ? QString::number(estimate.jpegQuality) : QString(),
+            estimateField(RecompressWebp)
+        };
+    }
+    for (QString &field : fields) field = csvEscape(field);
+    return fields.join(',').toUtf8() + '\n';
+}
@@ -0,0 +1,59 @@
+#ifndef RECORDWRITER_H
+#define RECORDWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <cstdio>
+#include "imageinfo.h"
+#include "quanttables.h"
+
+// Формат потокового вывода результатов сканирования
+enum class RecordFormat {
+    JsonLines,  // одна JSON-запись на строку
+    Csv
+};
+
+RecordFormat recordFormatFromString(const QString &name, bool *ok = nullptr);
+
+// Необязательные группы колонок CSV - только для включённых проверок, чтобы файл
+// без них не тащил пустые колонки. На JSON Lines не влияют: там пустые поля не пишутся
+enum CsvColumnGroup {
+    CsvIntegrity = 0x1,   // integrity (--verify)
+    CsvQuality = 0x2,     // encoder, jpegQuality, quantTableSet
+    CsvColors = 0x4,      // цветовая статистика (--colors)
+    CsvRecompress = 0x8   // оценки пересжатия (--recompress)
+};
+
+QJsonObject imageInfoToJson(const QString &filePath, const ImageInfo &info);
+
+// Потокобезопасная запись результатов по одной записи на файл.
+// Каждая запись сбрасывается сразу, чтобы её можно было читать через конвейер.
+// Таблицы квантования JPEG интернируются: запись несёт номер набора (quantTableSet)
+// и оценку качества, а сами таблицы в JSON Lines выводятся один раз отдельной строкой
+// без "path" - {"quantTableSet": N, "quantizationTables": [...]} - раньше первой записи
+// с этим номером. Прежнего поля quantizationTable (одна таблица в каждой записи) нет.
+class RecordWriter {
+public:
+    // csvGroups - CsvColumnGroup
+    RecordWriter(FILE *out, RecordFormat format, int csvGroups = 0);
+
+    void writeHeader();
+    void write(const QString &filePath, const ImageInfo &info);
+    qint64 recordCount() const { return written; }
+    int quantTableSetCount() const;
+
+private:
+    QByteArray formatRecord(const QString &filePath, const ImageInfo &info, quint32 setId,
+                            const JpegQuality &quality);
+
+    FILE *out;
+    RecordFormat format;
+    int csvGroups;
+    mutable QMutex mutex;       // и вывод, и пул: описание набора уходит раньше ссылок на него
+    qint64 written = 0;
+    QuantTablePool quantPool;
+};
+
+#endif // RECORDWRITER_H
@@ -0,0 +1,421 @@
+#include "resultquery.h"
+#include "scanresults.h"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+enum class Field {
+    Width, Height, Pixels, Megapixels, Dpi, DpiX, DpiY, Depth, Size, Quality, Luma, Luma5, Luma95,
+    Format, Compression, ColorSpace, Encoder
+};
+
+enum class Op { Eq, Ne, Lt, Le, Gt, Ge };
+
+struct FieldName {
+    const char *name;
+    Field field;
+};
+
+const FieldName kFields[] = {
+    {"width", Field::Width}, {"height", Field::Height}, {"pixels", Field::Pixels},
+    {"mp", Field::Megapixels}, {"dpi", Field::Dpi}, {"dpix", Field::DpiX}, {"dpiy", Field::DpiY},
+    {"depth", Field::Depth}, {"size", Field::Size}, {"quality", Field::Quality},
+    {"luma", Field::Luma}, {"luma5", Field::Luma5}, {"luma95", Field::Luma95}, {"format", Field::Format},
+    {"compression", Field::Compression}, {"colorspace", Field::ColorSpace}, {"encoder", Field::Encoder}
+};
+
+struct FlagName {
+    const char *name;
+    quint8 flag;
+};
+
+const FlagName kFlags[] = {
+    {"alpha", ImageAlpha}, {"gray", ImageGrayscale}, {"indexed", ImageIndexed},
+    {"decoded", ImageDecoded}, {"hashed", ImageHashed}, {"detailed", ImageDetailed},
+    {"pending", ImagePending}, {"corrupt", ImageCorrupt}
+};
+
+bool isLabelField(Field field)
+{
+    return field == Field::Format || field == Field::Compression || field == Field::ColorSpace
+           || field == Field::Encoder;
+}
+
+struct Token {
+    enum Kind { Ident, Number, String, Operator, LeftParen, RightParen, End };
+    Kind kind = End;
+    QString text;
+    double number = 0;
+    int pos = 0;
+};
+
+// Разбивка на лексемы; false - непонятный символ (позиция в error)
+bool tokenize(const QString &text, QVector<Token> &tokens, QString &error)
+{
+    int i = 0;
+    const int n = text.size();
+    while (i < n) {
+        QChar c = text[i];
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+
+        Token token;
+        token.pos = i;
+        if (c.isDigit() || (c == '.' && i + 1 < n && text[i + 1].isDigit())) {
+            int start = i;
+            while (i < n && (text[i].isDigit() || text[i] == '.')) ++i;
+            bool ok = false;
+            token.number = text.mid(start, i - start).toDouble(&ok);
+            if (!ok) {
+                error = QString("позиция %1: неверное число").arg(start + 1);
+                return false;
+            }
+            // Суффикс размера: 10MB, 2.5k
+            int suffixStart = i;
+            while (i < n && text[i].isLetter()) ++i;
+            QString suffix = text.mid(suffixStart, i - suffixStart).toLower();
+            if (suffix == "k" || suffix == "kb") token.number *= 1024.0;
+            else if (suffix == "m" || suffix == "mb") token.number *= 1024.0 * 1024.0;
+            else if (suffix == "g" || suffix == "gb") token.number *= 1024.0 * 1024.0 * 1024.0;
+            else if (!suffix.isEmpty()) {
+                error = QString("позиция %1: неизвестный суффикс \"%2\"").arg(suffixStart + 1).arg(suffix);
+                return false;
+            }
+            token.kind = Token::Number;
+            token.text = text.mid(start, i - start);
+        } else if (c.isLetter() || c == '_') {
+            int start = i;
+            while (i < n && (text[i].isLetterOrNumber() || text[i] == '_' || text[i] == '-')) ++i;
+            token.text = text.mid(start, i - start);
+            QString lower = token.text.toLower();
+            // Словесные формы логических операций
+            if (lower == "and") token = {Token::Operator, "&&", 0, start};
+            else if (lower == "or") token = {Token::Operator, "||", 0, start};
+            else if (lower == "not") token = {Token::Operator, "!", 0, start};
+            else token.kind = Token::Ident;
+        } else if (c == '"' || c == '\'') {
+            int close = text.indexOf(c, i + 1);
+            if (close < 0) {
+                error = QString("позиция %1: не закрыта кавычка").arg(i + 1);
+                return false;
+            }
+            token.kind = Token::String;
+            token.text = text.mid(i + 1, close - i - 1);
+            i = close + 1;
+        } else if (c == '(' || c == ')') {
+            token.kind = c == '(' ? Token::LeftParen : Token::RightParen;
+            token.text = c;
+            ++i;
+        } else {
+            static const char *const operators[] = {"&&", "||", "==", "!=", "<=", ">=", "<", ">", "!", "="};
+            token.kind = Token::Operator;
+            for (const char *op : operators) {
+                if (text.mid(i, static_cast<int>(qstrlen(op))) == QLatin1String(op)) {
+                    token.text = op;
+                    break;
+                }
+            }
+            if (token.text.isEmpty()) {
+                error = QString("позиция %1: непонятный символ '%2'").arg(i + 1).arg(c);
+                return false;
+            }
+            i += token.text.size();
+            if (token.text == "=") token.text = "==";
+        }
+        tokens.append(token);
+    }
+
+    Token end;
+    end.pos = n;
+    tokens.append(end);
+    return true;
+}
+
+}
+
+// Узел разобранного выражения
+struct QueryNode {
+    enum Kind { And, Or, Not, Compare, Label, Flag };
+
+    Kind kind = Flag;
+    Field field = Field::Width;
+    Op op = Op::Eq;
+    double value = 0;
+    QString label;       // для Label
+    int labelSlot = 0;   // номер таблицы в Matcher::labelTables
+    quint8 flag = 0;
+    std::unique_ptr<QueryNode> left;
+    std::unique_ptr<QueryNode> right;
+};
+
+namespace {
+
+// Рекурсивный спуск по грамматике из resultquery.h; ошибка останавливает разбор
+class Parser {
+public:
+    using Node = std::unique_ptr<QueryNode>;
+
+    Parser(const QVector<Token> &tokens, int &labelNodes) : tokens(tokens), labelNodes(labelNodes) {}
+
+    Node parseExpression()
+    {
+        Node node = parseOr();
+        if (node && peek().kind != Token::End) fail("лишнее в конце выражения");
+        if (!error.isEmpty()) return nullptr;
+        return node;
+    }
+
+    QString error;
+
+private:
+    const Token &peek() const { return tokens[pos]; }
+    const Token &take() { return tokens[pos < tokens.size() - 1 ? pos++ : pos]; }
+    bool takeOperator(const char *op)
+    {
+        if (peek().kind != Token::Operator || peek().text != QLatin1String(op)) return false;
+        ++pos;
+        return true;
+    }
+    Node fail(const QString &message)
+    {
+        if (error.isEmpty()) error = QString("позиция %1: %2").arg(peek().pos + 1).arg(message);
+        return nullptr;
+    }
+
+    Node binary(QueryNode::Kind kind, Node left, Node right)
+    {
+        auto node = std::make_unique<QueryNode>();
+        node->kind = kind;
+        node->left = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    Node parseOr()
+    {
+        Node left = parseAnd();
+        while (left && takeOperator("||")) {
+            Node right = parseAnd();
+            if (!right) return nullptr;
+            left = binary(QueryNode::Or, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    Node parseAnd()
+    {
+        Node left = parseUnary();
+        while (left && takeOperator("&&")) {
+            Node right = parseUnary();
+            if (!right) return nullptr;
+            left = binary(QueryNode::And, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    Node parseUnary()
+    {
+        if (takeOperator("!")) {
+            Node operand = parseUnary();
+            if (!operand) return nullptr;
+            return binary(QueryNode::Not, std::move(operand), nullptr);
+        }
+        if (peek().kind == Token::LeftParen) {
+            take();
+            Node inner = parseOr();
+            if (!inner) return nullptr;
+            if (peek().kind != Token::RightParen) return fail("ожидалась ')'");
+            take();
+            return inner;
+        }
+        return parseCondition();
+    }
+
+    Node parseCondition()
+    {
+        if (peek().kind != Token::Ident) return fail("ожидалось имя поля");
+        const Token &name = take();
+        QString lower = name.text.toLower();
+
+        auto node = std::make_unique<QueryNode>();
+        for (const FlagName &flag : kFlags) {
+            if (lower == QLatin1String(flag.name)) {
+                node->kind = QueryNode::Flag;
+                node->flag = flag.flag;
+                return node;
+            }
+        }
+
+        const FieldName *field = nullptr;
+        for (const FieldName &candidate : kFields)
+            if (lower == QLatin1String(candidate.name)) field = &candidate;
+        if (!field) {
+            --pos;
+            return fail(QString("неизвестное поле \"%1\"").arg(name.text));
+        }
+        node->field = field->field;
+
+        static const struct { const char *text; Op op; } ops[] = {
+            {"==", Op::Eq}, {"!=", Op::Ne}, {"<", Op::Lt}, {"<=", Op::Le}, {">", Op::Gt}, {">=", Op::Ge}
+        };
+        bool found = false;
+        for (const auto &candidate : ops) {
+            if (takeOperator(candidate.text)) {
+                node->op = candidate.op;
+                found = true;
+                break;
+            }
+        }
+        if (!found) return fail("ожидалось сравнение");
+
+        const Token &value = peek();
+        if (isLabelField(node->field)) {
+            if (node->op != Op::Eq && node->op != Op::Ne) return fail("подписи сравниваются только через == и !=");
+            if (value.kind != Token::Ident && value.kind != Token::String && value.kind != Token::Number)
+                return fail("ожидалось значение");
+            node->kind = QueryNode::Label;
+            node->label = value.text;
+            node->labelSlot = labelNodes++;
+        } else {
+            if (value.kind != Token::Number) return fail("ожидалось число");
+            node->kind = QueryNode::Compare;
+            node->value = value.number;
+        }
+        take();
+        return node;
+    }
+
+    const QVector<Token> &tokens;
+    int &labelNodes;
+    int pos = 0;
+};
+
+double fieldValue(Field field, const ScanResults &results, int row)
+{
+    switch (field) {
+    case Field::Width: return results.width(row);
+    case Field::Height: return results.height(row);
+    case Field::Pixels: return double(qMax(results.width(row), 0)) * qMax(results.height(row), 0);
+    case Field::Megapixels: return double(qMax(results.width(row), 0)) * qMax(results.height(row), 0) / 1e6;
+    case Field::Dpi: return qMax(results.dpiX(row), results.dpiY(row));
+    case Field::DpiX: return results.dpiX(row);
+    case Field::DpiY: return results.dpiY(row);
+    case Field::Depth: return results.colorDepth(row);
+    case Field::Size: return double(results.fileSize(row));
+    case Field::Quality: return results.jpegQuality(row).quality;
+    case Field::Luma:
+    case Field::Luma5:
+    case Field::Luma95: {
+        // Статистика не считалась - NaN, и любое сравнение ложно
+        if (!results.hasColorStats(row)) return std::numeric_limits<double>::quiet_NaN();
+        return results.luminancePercentile(row, field == Field::Luma5 ? 0 : field == Field::Luma ? 1 : 2);
+    }
+    default: return 0;
+    }
+}
+
+bool evaluate(const QueryNode &node, const ScanResults &results, int row,
+              const std::vector<QVector<bool>> &labelTables)
+{
+    switch (node.kind) {
+    case QueryNode::And:
+        return evaluate(*node.left, results, row, labelTables) && evaluate(*node.right, results, row, labelTables);
+    case QueryNode::Or:
+        return evaluate(*node.left, results, row, labelTables) || evaluate(*node.right, results, row, labelTables);
+    case QueryNode::Not:
+        return !evaluate(*node.left, results, row, labelTables);
+    case QueryNode::Flag:
+        return results.flags(row) & node.flag;
+    case QueryNode::Label: {
+        quint32 id = node.field == Field::Format ? results.formatId(row)
+                     : node.field == Field::Compression ? results.compressionId(row)
+                     : node.field == Field::Encoder ? results.encoderId(row)
+                                                    : results.colorSpaceId(row);
+        const QVector<bool> &table = labelTables[node.labelSlot];
+        bool equal = static_cast<qsizetype>(id) < table.size() && table[id];
+        return node.op == Op::Eq ? equal : !equal;
+    }
+    case QueryNode::Compare: {
+        double value = fieldValue(node.field, results, row);
+        if (std::isnan(value)) return false;
+        switch (node.op) {
+        case Op::Eq: return value == node.value;
+        case Op::Ne: return value != node.value;
+        case Op::Lt: return value < node.value;
+        case Op::Le: return value <= node.value;
+        case Op::Gt: return value > node.value;
+        case Op::Ge: return value >= node.value;
+        }
+    }
+    }
+    return false;
+}
+
+void bindLabels(const QueryNode *node, const ScanResults &results, std::vector<QVector<bool>> &tables)
+{
+    if (!node) return;
+    if (node->kind == QueryNode::Label) {
+        QVector<bool> &table = tables[node->labelSlot];
+        if (node->field == Field::Encoder) {
+            table.fill(false, results.encoderCount());
+            for (int id = 0; id < results.encoderCount(); ++id)
+                table[id] = results.encoderName(static_cast<quint32>(id)).compare(node->label, Qt::CaseInsensitive) == 0;
+        } else {
+            table.fill(false, results.labelCount());
+            for (int id = 0; id < results.labelCount(); ++id)
+                table[id] = results.label(static_cast<quint16>(id)).compare(node->label, Qt::CaseInsensitive) == 0;
+        }
+    }
+    bindLabels(node->left.get(), results, tables);
+    bindLabels(node->right.get(), results, tables);
+}
+
+}
+
+ResultQuery ResultQuery::parse(const QString &text, QString *error)
+{
+    ResultQuery query;
+    if (error) error->clear();
+    if (text.trimmed().isEmpty()) return query;
+
+    QVector<Token> tokens;
+    QString message;
+    if (tokenize(text, tokens, message)) {
+        Parser parser(tokens, query.labelNodes);
+        std::unique_ptr<QueryNode> root = parser.parseExpression();
+        if (root) {
+            query.root = std::move(root);
+            query.source = text.trimmed();
+            return query;
+        }
+        message = parser.error;
+    }
+    if (error) *error = message;
+    return ResultQuery();
+}
+
+QStringList ResultQuery::fieldNames()
+{
+    QStringList names;
+    for (const FieldName &field : kFields) names.append(field.name);
+    for (const FlagName &flag : kFlags) names.append(flag.name);
+    return names;
+}
+
+ResultQuery::Matcher ResultQuery::matcher(const ScanResults &results) const
+{
+    Matcher matcher;
+    matcher.query = this;
+    matcher.results = &results;
+    matcher.labelTables.resize(labelNodes);
+    bindLabels(root.get(), results, matcher.labelTables);
+    return matcher;
+}
+
+bool ResultQuery::Matcher::operator()(int row) const
+{
+    return !query->root || evaluate(*query->root, *results, row, labelTables);
+}
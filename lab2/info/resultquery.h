@@ -0,0 +1,56 @@
+#ifndef RESULTQUERY_H
+#define RESULTQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+class ScanResults;
+struct QueryNode;
+
+// Выражение отбора строк, например: format == JPEG && width > 4000 && dpi < 150 && !alpha
+// Текст разбирается один раз (лексер и рекурсивный спуск) в дерево узлов над
+// типизированными колонками ScanResults; при проверке строк текст ячеек не строится.
+//
+//   выражение := и ( ("||" | or) и )*
+//   и         := не ( ("&&" | and) не )*
+//   не        := ("!" | not) не | "(" выражение ")" | сравнение | флаг
+//   сравнение := поле ("==" | "!=" | "<" | "<=" | ">" | ">=") значение
+//
+// Числовые поля: width, height, pixels, mp, dpi, dpix, dpiy, depth, size
+// (size допускает суффиксы KB, MB, GB), quality (оценка качества JPEG, 0 - нет таблиц),
+// luma, luma5, luma95 (перцентили яркости 0..255; без цветовой статистики условие ложно).
+// Подписи: format, compression, colorspace, encoder - только == и !=, без учёта регистра. Флаги: alpha, gray, indexed, decoded, hashed, detailed, pending, corrupt.
+class ResultQuery {
+public:
+    // Пустой текст - запрос без условий. При ошибке возвращается пустой запрос,
+    // а в error - описание с позицией
+    static ResultQuery parse(const QString &text, QString *error = nullptr);
+    static QStringList fieldNames();
+
+    bool isEmpty() const { return !root; }
+    const QString &text() const { return source; }
+
+    // Проверка строк конкретного хранилища: подписи из запроса заранее
+    // сопоставлены номерам пула подписей. Можно звать из нескольких потоков
+    class Matcher {
+    public:
+        bool operator()(int row) const;
+
+    private:
+        friend class ResultQuery;
+        const ResultQuery *query = nullptr;
+        const ScanResults *results = nullptr;
+        std::vector<QVector<bool>> labelTables;  // по узлу-подписи: номер подписи -> совпала ли
+    };
+    Matcher matcher(const ScanResults &results) const;
+
+private:
+    std::shared_ptr<const QueryNode> root;
+    QString source;
+    int labelNodes = 0;
+};
+
+#endif // RESULTQUERY_H
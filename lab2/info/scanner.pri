@@ -0,0 +1,61 @@
+# Общее ядро сканера изображений: используется GUI (info.pro) и консольной утилитой (../infoscan)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/archivereader.cpp \
+    $$PWD/colorstats.cpp \
+    $$PWD/crc32.cpp \
+    $$PWD/dirwalker.cpp \
+    $$PWD/diskorder.cpp \
+    $$PWD/fileview.cpp \
+    $$PWD/headerprefetch.cpp \
+    $$PWD/imagehash.cpp \
+    $$PWD/imageinfo.cpp \
+    $$PWD/imagemetadata.cpp \
+    $$PWD/integritycheck.cpp \
+    $$PWD/probeworker.cpp \
+    $$PWD/quanttables.cpp \
+    $$PWD/recompress.cpp \
+    $$PWD/recordwriter.cpp \
+    $$PWD/resultquery.cpp \
+    $$PWD/scanresults.cpp \
+    $$PWD/scanstats.cpp
+
+HEADERS += \
+    $$PWD/archivereader.h \
+    $$PWD/colorstats.h \
+    $$PWD/crc32.h \
+    $$PWD/dirwalker.h \
+    $$PWD/diskorder.h \
+    $$PWD/fileview.h \
+    $$PWD/headerprefetch.h \
+    $$PWD/imagehash.h \
+    $$PWD/imageinfo.h \
+    $$PWD/imagemetadata.h \
+    $$PWD/integritycheck.h \
+    $$PWD/probeworker.h \
+    $$PWD/quanttables.h \
+    $$PWD/recompress.h \
+    $$PWD/recordwriter.h \
+    $$PWD/resultquery.h \
+    $$PWD/scanresults.h \
+    $$PWD/scanstats.h
+
+# zlib - распаковка deflate-членов ZIP (только начало, до разбора заголовка) и профилей iCCP в PNG.
+# Если Qt собран с системной zlib - линкуемся с ней, иначе (Windows, MinGW) берём копию из QtCore
+qtConfig(system-zlib) {
+    DEFINES += HAVE_SYSTEM_ZLIB
+    LIBS += -lz
+} else {
+    QT += core-private
+}
+
+# io_uring для пакетного чтения заголовков (Linux); без liburing - пул потоков
+linux {
+    CONFIG += link_pkgconfig
+    packagesExist(liburing) {
+        PKGCONFIG += liburing
+        DEFINES += HAVE_LIBURING
+    }
+}
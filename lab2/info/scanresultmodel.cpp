@@ -0,0 +1,333 @@
+#include "scanresultmodel.h"
+#include "thumbnailcache.h"
+#include "detailloader.h"
+#include "imagescanner.h"
+#include "integritycheck.h"
+#include <QColor>
+#include <QPainter>
+#include <QPixmap>
+
+namespace {
+
+// Очереди миниатюр и деталей держат 512 запросов - более старые ответы уже не придут
+const int kMaxRequestedRows = 4096;
+
+}
+
+ScanResultModel::ScanResultModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int ScanResultModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return isIdentity() ? store.size() : rows.size();
+}
+
+int ScanResultModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ScanResults::ColumnCount;
+}
+
+QVariant ScanResultModel::data(const QModelIndex &index, int role) const
+{
+    int row = storeRow(index);
+    if (row < 0) return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+        // Раз строку рисуют, она на экране - самое время разобрать её заголовок или посчитать детали
+        if (index.column() == ScanResults::FileNameColumn) {
+            if (store.flags(row) & ImagePending) {
+                if (scanner) scanner->prioritize(row);
+            } else if (!store.hasDetails(row)) {
+                requestDetails(row);
+            }
+        }
+        return store.displayText(row, index.column());
+    case Qt::DecorationRole:
+        // Вызывается только для видимых строк: так они первыми попадают в очередь миниатюр
+        // Файл, уронивший воркер, не декодируем снова
+        if (index.column() == ScanResults::ThumbnailColumn && thumbnails
+            && !isDecoderFailure(static_cast<IntegrityStatus>(store.integrity(row)))) {
+            quint64 key = (store.flags(row) & ImageHashed) ? store.contentHash(row) : 0;
+            QString filePath = store.filePath(row);
+            QImage image = thumbnails->thumbnail(filePath, key);
+            if (!image.isNull()) return image;
+            if (requestedRows.size() >= kMaxRequestedRows) requestedRows.clear();
+            requestedRows.insert(filePath, row);
+        }
+        // Образцы цветов рядом с их кодами
+        if (index.column() == ScanResults::MeanColorColumn && store.hasColorStats(row))
+            return QColor(QRgb(store.meanColor(row)));
+        if (index.column() == ScanResults::DominantColorsColumn && store.hasColorStats(row)) {
+            ColorStats stats = store.colorStats(row);
+            if (stats.dominantCount == 0) return QVariant();
+            QPixmap swatch(12 * stats.dominantCount, 12);
+            QPainter painter(&swatch);
+            for (int k = 0; k < stats.dominantCount; ++k)
+                painter.fillRect(12 * k, 0, 12, 12, QColor(QRgb(stats.dominant[k])));
+            return swatch;
+        }
+        return QVariant();
+    case Qt::TextAlignmentRole:
+        return (index.column() == ScanResults::FileNameColumn || index.column() == ScanResults::AdditionalInfoColumn)
+                   ? int(Qt::AlignLeft | Qt::AlignVCenter) : int(Qt::AlignCenter);
+    case Qt::UserRole:
+        return store.filePath(row);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ScanResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QAbstractTableModel::headerData(section, orientation, role);
+
+    static const QStringList headers = {
+        "", "Имя файла", "Размер (пиксели)", "Разрешение (DPI)",
+        "Глубина цвета", "Сжатие", "Степень сжатия", "Пересжатие (оценка)",
+        "Формат", "Размер файла", "Доп. информация",
+        "Средний цвет", "Основные цвета", "Яркость p5/p50/p95"
+    };
+    return headers.value(section);
+}
+
+bool ScanResultModel::isIdentity() const
+{
+    return (sortColumn <= ScanResults::ThumbnailColumn || sortColumn >= ScanResults::ColumnCount)
+           && activeFilter.isEmpty();
+}
+
+int ScanResultModel::storeRow(const QModelIndex &index) const
+{
+    if (!index.isValid()) return -1;
+    if (isIdentity()) return index.row() < store.size() ? index.row() : -1;
+    return index.row() < rows.size() ? rows[index.row()] : -1;
+}
+
+QModelIndex ScanResultModel::indexOfStoreRow(int row, int column) const
+{
+    if (row < 0 || row >= store.size()) return QModelIndex();
+    if (isIdentity()) return index(row, column);
+    int modelRow = row < modelRowOf.size() ? modelRowOf[row] : -1;
+    return modelRow >= 0 ? index(modelRow, column) : QModelIndex();
+}
+
+void ScanResultModel::computeView(const QVector<int> &changed)
+{
+    rows.clear();
+    modelRowOf.clear();
+    if (isIdentity()) {
+        matched.clear();
+        staleMatches.clear();
+        return;
+    }
+
+    const bool sorted = sortColumn > ScanResults::ThumbnailColumn && sortColumn < ScanResults::ColumnCount;
+    const int n = store.size();
+    // Отметки отбора запомнены: проверяются только новые и изменившиеся строки
+    staleMatches += changed;
+    store.matchRows(activeFilter, matched, staleMatches);
+    staleMatches.clear();
+    rows.reserve(n);
+    modelRowOf.fill(-1, n);
+
+    auto take = [&](int row) {
+        if (!matched[row]) return;
+        modelRowOf[row] = rows.size();
+        rows.append(row);
+    };
+    if (!sorted) {
+        for (int row = 0; row < n; ++row) take(row);
+    } else {
+        // Убывание - тот же индекс, пройденный с конца
+        const QVector<int> &order = store.sortIndex(sortColumn);
+        if (sortOrder == Qt::AscendingOrder)
+            for (int i = 0; i < n; ++i) take(order[i]);
+        else
+            for (int i = n - 1; i >= 0; --i) take(order[i]);
+    }
+}
+
+void ScanResultModel::rebuildView(const QVector<int> &changed)
+{
+    emit layoutAboutToBeChanged();
+
+    // Выделение и текущая строка привязаны к строкам хранилища, а не к позиции в таблице
+    const QModelIndexList before = persistentIndexList();
+    QVector<int> storeRows;
+    storeRows.reserve(before.size());
+    for (const QModelIndex &index : before) storeRows.append(storeRow(index));
+
+    computeView(changed);
+
+    QModelIndexList after;
+    after.reserve(before.size());
+    for (int i = 0; i < before.size(); ++i) after.append(indexOfStoreRow(storeRows[i], before[i].column()));
+    changePersistentIndexList(before, after);
+
+    emit layoutChanged();
+}
+
+void ScanResultModel::sort(int column, Qt::SortOrder order)
+{
+    if (column == sortColumn && order == sortOrder) return;
+    sortColumn = column;
+    sortOrder = order;
+    rebuildView();
+}
+
+void ScanResultModel::setFilter(const ResultFilter &filter)
+{
+    activeFilter = filter;
+    matched.clear();
+    staleMatches.clear();
+    rebuildView();
+}
+
+void ScanResultModel::clear()
+{
+    beginResetModel();
+    store.clear();
+    rows.clear();
+    modelRowOf.clear();
+    matched.clear();
+    staleMatches.clear();
+    requestedRows.clear();
+    endResetModel();
+}
+
+int ScanResultModel::appendResult(const QString &filePath, const ImageInfo &info)
+{
+    if (!isIdentity()) {
+        // Новая строка встаёт на своё место по сортировке и фильтру
+        int row = store.append(filePath, info);
+        rebuildView();
+        return row;
+    }
+    int row = store.size();
+    beginInsertRows(QModelIndex(), row, row);
+    store.append(filePath, info);
+    endInsertRows();
+    return row;
+}
+
+int ScanResultModel::appendPending(const QStringList &filePaths)
+{
+    int first = store.size();
+    if (filePaths.isEmpty()) return first;
+    ImageInfo info;
+    info.flags = ImagePending;
+    if (!isIdentity()) {
+        for (const QString &filePath : filePaths) store.append(filePath, info);
+        rebuildView();
+        return first;
+    }
+    beginInsertRows(QModelIndex(), first, first + filePaths.size() - 1);
+    for (const QString &filePath : filePaths) store.append(filePath, info);
+    endInsertRows();
+    return first;
+}
+
+void ScanResultModel::applyResults(const QVector<ScanItem> &items)
+{
+    int first = store.size();
+    int lowest = first;
+    int highest = -1;
+    QVector<const ScanItem *> appended;
+    QVector<int> filled;
+    for (const ScanItem &item : items) {
+        if (item.row < 0 || item.row >= first) {
+            appended.append(&item);
+            continue;
+        }
+        store.fillPending(item.row, item.filePath, item.info);
+        filled.append(item.row);
+        lowest = qMin(lowest, item.row);
+        highest = qMax(highest, item.row);
+    }
+
+    if (!isIdentity()) {
+        // Индексы сортировки и отметки отбора досчитывают заполненные и новые строки
+        for (const ScanItem *item : std::as_const(appended)) store.append(item->filePath, item->info);
+        rebuildView(filled);
+        return;
+    }
+    if (highest >= 0) emit dataChanged(index(lowest, 0), index(highest, ScanResults::ColumnCount - 1));
+    if (appended.isEmpty()) return;
+    beginInsertRows(QModelIndex(), first, first + appended.size() - 1);
+    for (const ScanItem *item : std::as_const(appended)) store.append(item->filePath, item->info);
+    endInsertRows();
+}
+
+void ScanResultModel::updateResult(int row, const QString &filePath, const ImageInfo &info)
+{
+    store.update(row, filePath, info);
+    if (!isIdentity()) {
+        rebuildView({row});
+        return;
+    }
+    emit dataChanged(index(row, 0), index(row, ScanResults::ColumnCount - 1));
+}
+
+void ScanResultModel::requestDetails(int row, bool urgent) const
+{
+    if (!details || row < 0 || row >= store.size()) return;
+    QString filePath = store.filePath(row);
+    if (requestedRows.size() >= kMaxRequestedRows) requestedRows.clear();
+    requestedRows.insert(filePath, row);
+    details->request(filePath, store.format(row), urgent);
+}
+
+int ScanResultModel::requestedRow(const QString &filePath) const
+{
+    // После удалений номера строк сдвигаются - сверяем путь
+    int row = requestedRows.value(filePath, -1);
+    if (row < 0 || row >= store.size() || store.filePath(row) != filePath) return -1;
+    return row;
+}
+
+void ScanResultModel::updateDetails(int row, const ImageInfo &info)
+{
+    if (row < 0 || row >= store.size()) return;
+    // Строки не переставляются под курсором: новый порядок - при следующей сортировке
+    store.updateDetails(row, info);
+    if (!matched.isEmpty()) staleMatches.append(row);
+    QModelIndex first = indexOfStoreRow(row, 0);
+    if (first.isValid()) emit dataChanged(first, index(first.row(), ScanResults::ColumnCount - 1));
+}
+
+void ScanResultModel::refreshThumbnail(int row)
+{
+    QModelIndex cell = indexOfStoreRow(row, ScanResults::ThumbnailColumn);
+    if (cell.isValid()) emit dataChanged(cell, cell, {Qt::DecorationRole});
+}
+
+void ScanResultModel::removeResult(int row)
+{
+    if (isIdentity()) {
+        beginRemoveRows(QModelIndex(), row, row);
+        store.remove(row);
+        endRemoveRows();
+        return;
+    }
+
+    int modelRow = modelRowOf.value(row, -1);
+    if (modelRow >= 0) beginRemoveRows(QModelIndex(), modelRow, modelRow);
+    store.remove(row);
+
+    // Порядок остальных строк не меняется, сдвигаются только номера в хранилище
+    if (modelRow >= 0) rows.remove(modelRow);
+    modelRowOf.remove(row);
+    if (row < matched.size()) matched.remove(row);
+    staleMatches.removeAll(row);
+    for (int &r : staleMatches)
+        if (r > row) --r;
+    for (int &r : rows)
+        if (r > row) --r;
+    for (int i = 0; i < rows.size(); ++i) modelRowOf[rows[i]] = i;
+
+    if (modelRow >= 0) endRemoveRows();
+}
@@ -0,0 +1,82 @@
+#ifndef SCANRESULTMODEL_H
+#define SCANRESULTMODEL_H
+
+#include <QAbstractTableModel>
+#include "scanresults.h"
+
+class ThumbnailCache;
+class DetailLoader;
+class ImageScanner;
+struct ScanItem;
+
+// Модель таблицы поверх колоночного хранилища: строки не копируются,
+// текст ячеек формируется только для видимых строк.
+// Сортировка и отбор - это перестановка номеров строк хранилища (rows),
+// построенная по типизированным колонкам. Внешние методы принимают номер
+// строки хранилища, а не строки модели.
+class ScanResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit ScanResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    const ScanResults &results() const { return store; }
+
+    void setFilter(const ResultFilter &filter);
+    const ResultFilter &filter() const { return activeFilter; }
+
+    // Строка хранилища для индекса модели и обратно (-1 / недействительный индекс, если строка скрыта)
+    int storeRow(const QModelIndex &index) const;
+    QModelIndex indexOfStoreRow(int row, int column = 0) const;
+
+    void setThumbnailCache(ThumbnailCache *cache) { thumbnails = cache; }
+    void refreshThumbnail(int row);
+    // Видимые строки без деталей запрашивают их у loader; готовые приходят в updateDetails()
+    void setDetailLoader(DetailLoader *loader) { details = loader; }
+    void requestDetails(int row, bool urgent = false) const;
+    // Видимые строки-заготовки поднимаются в очереди разбора сканера
+    void setScanner(ImageScanner *value) { scanner = value; }
+    void updateDetails(int row, const ImageInfo &info);
+    // Строка, для которой запрошены миниатюра или детали, или -1.
+    // Общего индекса путь -> строка нет: на десятках миллионов файлов он не влезет в память
+    int requestedRow(const QString &filePath) const;
+
+    // Бюджет памяти хранилища (см. ScanResults::setMemoryBudget)
+    void setMemoryBudget(qint64 bytes) { store.setMemoryBudget(bytes); }
+
+    void clear();
+    int appendResult(const QString &filePath, const ImageInfo &info);
+    int appendPending(const QStringList &filePaths);    // заготовки; возвращает номер первой строки
+    // Разобранные файлы: item.row >= 0 заполняет заготовку, -1 - новая строка
+    void applyResults(const QVector<ScanItem> &items);
+    void updateResult(int row, const QString &filePath, const ImageInfo &info);
+    void removeResult(int row);
+
+private:
+    bool isIdentity() const;
+    void rebuildView(const QVector<int> &changed = {});
+    void computeView(const QVector<int> &changed);
+
+    ScanResults store;
+    ThumbnailCache *thumbnails = nullptr;
+    DetailLoader *details = nullptr;
+    ImageScanner *scanner = nullptr;
+
+    int sortColumn = -1;
+    Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    ResultFilter activeFilter;
+    QVector<int> rows;        // строка модели -> строка хранилища (пусто, если порядок исходный)
+    QVector<int> modelRowOf;  // строка хранилища -> строка модели или -1
+    QVector<quint8> matched;  // отметки отбора activeFilter по строкам хранилища; пусто - не считались
+    QVector<int> staleMatches;  // строки, чьи детали пришли после подсчёта отметок
+    mutable QHash<QString, int> requestedRows;  // последние запросы миниатюр и деталей
+};
+
+#endif // SCANRESULTMODEL_H
@@ -0,0 +1,843 @@
+#include "scanresults.h"
+#include "integritycheck.h"
+#include <QDataStream>
+#include <QDir>
+#include <QTemporaryFile>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+const int kPageRows = 4096;
+const int kFilterChunk = 64 * 1024;  // строк на задачу при параллельном отборе
+
+// Ключ сортировки по имени - первые 8 байт UTF-8 (побайтно - это порядок кодовых точек)
+quint64 namePrefixKey(const char *name, int length)
+{
+    quint64 key = 0;
+    for (int b = 0; b < 8; ++b) key = (key << 8) | (b < length ? static_cast<uchar>(name[b]) : 0u);
+    return key;
+}
+
+}
+
+qint64 ScanResults::Page::memoryBytes() const
+{
+    return nameArena.size()
+           + qint64(rows()) * (sizeof(quint32) * 3 + sizeof(quint16) + sizeof(quint64) * 2 + sizeof(quint8))
+           + qint64(medianColors.size() + dominantColors.size()) * sizeof(quint32)
+           + qint64(recompressBytes.size()) * sizeof(qint64) + recompressQuality.size();
+}
+
+void ScanResults::Page::save(QDataStream &out) const
+{
+    out << nameArena << nameOffsets << nameLengths << dirOfRow << headerBytes
+        << pHashes << contentHashes << integrity << medianColors << dominantColors
+        << recompressBytes << recompressQuality;
+}
+
+void ScanResults::Page::load(QDataStream &in)
+{
+    in >> nameArena >> nameOffsets >> nameLengths >> dirOfRow >> headerBytes
+       >> pHashes >> contentHashes >> integrity >> medianColors >> dominantColors
+       >> recompressBytes >> recompressQuality;
+}
+
+ScanResults::ScanResults() = default;
+
+ScanResults::~ScanResults() = default;
+
+void ScanResults::clear()
+{
+    labels = StringPool();
+    encoders = EncoderPool();
+    quantPool = QuantTablePool();
+    dirs.clear();
+    dirIds.clear();
+    widths.clear();
+    heights.clear();
+    dpiXs.clear();
+    dpiYs.clear();
+    depths.clear();
+    flagBits.clear();
+    formatIds.clear();
+    compressionIds.clear();
+    colorSpaceIds.clear();
+    encoderIds.clear();
+    quantIds.clear();
+    fileSizes.clear();
+    meanColors.clear();
+    lumaLevels.clear();
+    pages.clear();
+    pageStarts.clear();
+    lastPage = 0;
+    loadedBytes = 0;
+    useClock = 0;
+    spillFile.reset();  // временный файл удаляется вместе с объектом
+    invalidateSortIndexes();
+    labelRanks.clear();
+}
+
+void ScanResults::reserve(int rows)
+{
+    // Страницы резервируются сами по kPageRows строк
+    widths.reserve(rows);
+    heights.reserve(rows);
+    dpiXs.reserve(rows);
+    dpiYs.reserve(rows);
+    depths.reserve(rows);
+    flagBits.reserve(rows);
+    formatIds.reserve(rows);
+    compressionIds.reserve(rows);
+    colorSpaceIds.reserve(rows);
+    encoderIds.reserve(rows);
+    quantIds.reserve(rows);
+    fileSizes.reserve(rows);
+    meanColors.reserve(rows);
+    lumaLevels.reserve(rows);
+}
+
+void ScanResults::setMemoryBudget(qint64 bytes)
+{
+    budget = qMax<qint64>(bytes, 0);
+    enforceBudget(-1);
+}
+
+qint64 ScanResults::spilledBytes() const
+{
+    return spillFile ? spillFile->size() : 0;
+}
+
+int ScanResults::pageIndex(int row) const
+{
+    int count = pageStarts.size();
+    if (lastPage < count && row >= pageStarts[lastPage]
+        && (lastPage + 1 == count || row < pageStarts[lastPage + 1]))
+        return lastPage;
+    auto it = std::upper_bound(pageStarts.constBegin(), pageStarts.constEnd(), row);
+    lastPage = static_cast<int>(it - pageStarts.constBegin()) - 1;
+    return lastPage;
+}
+
+ScanResults::Page &ScanResults::page(int index, bool modify) const
+{
+    PageSlot &slot = pages[index];
+    if (!slot.page) {
+        // Без вытесненной страницы строки таблицы потеряли бы данные, а колонки разошлись бы
+        // по длине - ошибка чтения файла подкачки останавливает программу, а не даёт пустую страницу
+        QByteArray bytes;
+        if (spillFile && spillFile->seek(slot.fileOffset)) bytes = spillFile->read(slot.fileLength);
+        auto loaded = std::make_unique<Page>();
+        QDataStream in(bytes);
+        loaded->load(in);
+        int end = index + 1 < pageStarts.size() ? pageStarts[index + 1] : size();
+        if (bytes.size() != slot.fileLength || in.status() != QDataStream::Ok
+            || loaded->rows() != end - pageStarts[index]) {
+            qFatal("ScanResults: cannot read page %d (%lld bytes at %lld) from the spill file %s: %s", index,
+                   static_cast<long long>(slot.fileLength), static_cast<long long>(slot.fileOffset),
+                   spillFile ? qPrintable(spillFile->fileName()) : "-",
+                   spillFile ? qPrintable(spillFile->errorString()) : "no spill file");
+        }
+        slot.page = std::move(loaded);
+        loadedBytes += slot.page->memoryBytes();
+        enforceBudget(index);
+    }
+    slot.lastUse = ++useClock;
+    if (modify) slot.dirty = true;
+    return *slot.page;
+}
+
+const ScanResults::Page &ScanResults::pageOf(int row, int *offset) const
+{
+    int index = pageIndex(row);
+    *offset = row - pageStarts[index];
+    return page(index);
+}
+
+void ScanResults::enforceBudget(int keep) const
+{
+    // Вытесняем давно не использованные страницы, пока не уложимся в бюджет
+    while (loadedBytes > budget) {
+        int victim = -1;
+        for (int i = 0; i < static_cast<int>(pages.size()); ++i) {
+            if (i == keep || !pages[i].page) continue;
+            if (victim < 0 || pages[i].lastUse < pages[victim].lastUse) victim = i;
+        }
+        if (victim < 0 || !spillPage(victim)) return;
+    }
+}
+
+bool ScanResults::spillPage(int index) const
+{
+    PageSlot &slot = pages[index];
+    if (slot.dirty) {
+        if (!spillFile) {
+            spillFile = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/info-results-XXXXXX");
+            if (!spillFile->open()) {
+                spillFile.reset();
+                return false;  // писать некуда - остаёмся в памяти сверх бюджета
+            }
+        }
+        QByteArray bytes;
+        {
+            QDataStream out(&bytes, QIODevice::WriteOnly);
+            slot.page->save(out);
+        }
+        // Старая копия страницы в файле не переиспользуется: перезаписи редки
+        qint64 offset = spillFile->size();
+        if (!spillFile->seek(offset) || spillFile->write(bytes) != bytes.size()) return false;
+        slot.fileOffset = offset;
+        slot.fileLength = bytes.size();
+        slot.dirty = false;
+    }
+    loadedBytes -= slot.page->memoryBytes();
+    slot.page.reset();
+    return true;
+}
+
+quint32 ScanResults::internDir(const QString &dir)
+{
+    auto it = dirIds.constFind(dir);
+    if (it != dirIds.constEnd()) return it.value();
+    quint32 id = static_cast<quint32>(dirs.size());
+    dirs.append(dir);
+    dirIds.insert(dir, id);
+    return id;
+}
+
+int ScanResults::append(const QString &filePath, const ImageInfo &info)
+{
+    int row = size();
+    if (pages.empty() || page(static_cast<int>(pages.size()) - 1).rows() >= kPageRows) {
+        pages.emplace_back();
+        pages.back().page = std::make_unique<Page>();
+        pageStarts.append(row);
+    }
+    Page &tail = page(static_cast<int>(pages.size()) - 1, true);
+    tail.nameOffsets.append(0);
+    tail.nameLengths.append(0);
+    tail.dirOfRow.append(0);
+    tail.headerBytes.append(0);
+    tail.pHashes.append(0);
+    tail.contentHashes.append(0);
+    tail.integrity.append(0);
+    tail.medianColors.append(0);
+    tail.dominantColors.resize(tail.dominantColors.size() + 3);
+    tail.recompressBytes.resize(tail.recompressBytes.size() + RecompressTargetCount);
+    tail.recompressQuality.append(0);
+
+    widths.append(0);
+    heights.append(0);
+    dpiXs.append(0);
+    dpiYs.append(0);
+    depths.append(0);
+    flagBits.append(0);
+    formatIds.append(0);
+    compressionIds.append(0);
+    colorSpaceIds.append(0);
+    encoderIds.append(0);
+    quantIds.append(0);
+    fileSizes.append(0);
+    meanColors.append(0);
+    lumaLevels.append(0);
+    store(row, filePath, info);
+    return row;
+}
+
+void ScanResults::update(int row, const QString &filePath, const ImageInfo &info)
+{
+    store(row, filePath, info);
+    invalidateSortIndexes();
+}
+
+void ScanResults::fillPending(int row, const QString &filePath, const ImageInfo &info)
+{
+    if (!(flagBits[row] & ImagePending)) {
+        update(row, filePath, info);
+        return;
+    }
+    store(row, filePath, info);
+
+    // Имя и порядок добавления у заготовки уже верные, остальные ключи поменялись
+    for (int column = PixelSizeColumn; column < ColumnCount; ++column) {
+        QVector<int> &index = sortIndexes[column];
+        if (row >= index.size()) continue;  // строка ещё в недосортированном хвосте
+        QVector<int> &stale = staleRows[column];
+        stale.append(row);
+        // Когда меняется больше половины, проще построить индекс заново
+        if (stale.size() > index.size() / 2) dropSortIndex(column);
+    }
+}
+
+void ScanResults::updateDetails(int row, const ImageInfo &info)
+{
+    dpiXs[row] = static_cast<quint16>(qBound(0, info.dpiX, 0xFFFF));
+    dpiYs[row] = static_cast<quint16>(qBound(0, info.dpiY, 0xFFFF));
+
+    // Не декодировалось - остаётся оценка по формату пикселей из заголовка
+    quint8 kept = flagBits[row];
+    if (info.flags & ImageDecoded) {
+        depths[row] = static_cast<quint8>(qBound(0, info.colorDepth, 0xFF));
+        kept &= ~(ImageAlpha | ImageGrayscale | ImageIndexed);
+    }
+    flagBits[row] = static_cast<quint8>(kept | (info.flags & ~ImageHashed));
+
+    // Декодер упал на этом файле (см. markProbeFailure) - отметка идёт в колонку целостности
+    if (info.integrity != 0) {
+        int index = pageIndex(row);
+        page(index, true).integrity[row - pageStarts[index]] = info.integrity;
+    }
+
+    // Изменились только колонки, зависящие от деталей
+    for (int column : {ResolutionColumn, ColorDepthColumn, CompressionRatioColumn, AdditionalInfoColumn})
+        dropSortIndex(column);
+}
+
+void ScanResults::store(int row, const QString &filePath, const ImageInfo &info)
+{
+    widths[row] = info.width;
+    heights[row] = info.height;
+    dpiXs[row] = static_cast<quint16>(qBound(0, info.dpiX, 0xFFFF));
+    dpiYs[row] = static_cast<quint16>(qBound(0, info.dpiY, 0xFFFF));
+    depths[row] = static_cast<quint8>(qBound(0, info.colorDepth, 0xFF));
+    flagBits[row] = info.flags;
+    formatIds[row] = labels.intern(info.format);
+    compressionIds[row] = labels.intern(getCompressionInfo(info.format));
+    colorSpaceIds[row] = labels.intern(getColorSpaceInfo(info.format));
+    encoderIds[row] = encoders.intern(info.encoder);
+    quantIds[row] = quantPool.intern(info.quantTables);
+    fileSizes[row] = info.fileSize;
+    const ColorStats &colors = info.colors;
+    meanColors[row] = colors.isValid() ? (colors.mean & 0xFFFFFF) | kColorValid : 0;
+    lumaLevels[row] = colors.luma[0] | (quint32(colors.luma[1]) << 8) | (quint32(colors.luma[2]) << 16);
+
+    storePaged(row, filePath, info);
+}
+
+void ScanResults::storePaged(int row, const QString &filePath, const ImageInfo &info)
+{
+    int slash = filePath.lastIndexOf('/');
+    QByteArray name = filePath.mid(slash + 1).toUtf8();
+    quint32 dir = internDir(filePath.left(qMax(slash, 0)));
+
+    int index = pageIndex(row);
+    int offset = row - pageStarts[index];
+    Page &paged = page(index, true);
+    qint64 before = paged.memoryBytes();
+
+    paged.dirOfRow[offset] = dir;
+    quint16 length = static_cast<quint16>(qMin<qsizetype>(name.size(), 0xFFFF));
+    if (paged.nameLengths[offset] > 0 && paged.nameLengths[offset] >= length) {
+        // Имя уже записано (заготовка, повторный разбор) - новое помещается на его место
+        std::memcpy(paged.nameArena.data() + paged.nameOffsets[offset], name.constData(), length);
+    } else {
+        paged.nameOffsets[offset] = paged.nameArena.size();
+        paged.nameArena.append(name.constData(), length);
+    }
+    paged.nameLengths[offset] = length;
+    paged.headerBytes[offset] = static_cast<quint32>(qMin<qint64>(info.headerBytesRead, 0xFFFFFFFF));
+    paged.pHashes[offset] = info.perceptualHash;
+    paged.contentHashes[offset] = info.contentHash;
+    paged.integrity[offset] = info.integrity;
+    paged.medianColors[offset] = info.colors.median;
+    for (int k = 0; k < 3; ++k) {
+        quint32 color = k < info.colors.dominantCount
+                            ? (info.colors.dominant[k] & 0xFFFFFF) | (quint32(info.colors.dominantShare[k]) << 24) : 0;
+        paged.dominantColors[offset * 3 + k] = color;
+    }
+    const RecompressEstimate &estimate = info.recompress;
+    for (int target = 0; target < RecompressTargetCount; ++target)
+        paged.recompressBytes[offset * RecompressTargetCount + target] = estimate.bytes[target];
+    paged.recompressQuality[offset] = estimate.isValid() ? (estimate.jpegQuality | (estimate.exact ? 0x80 : 0)) : 0;
+
+    loadedBytes += paged.memoryBytes() - before;
+    if (loadedBytes > budget) enforceBudget(index);
+}
+
+void ScanResults::remove(int row)
+{
+    // Буфер имён страницы и пулы не уплотняем: удаления редки (режим наблюдения)
+    invalidateSortIndexes();
+    int index = pageIndex(row);
+    int offset = row - pageStarts[index];
+    Page &paged = page(index, true);
+    qint64 before = paged.memoryBytes();
+    paged.nameOffsets.remove(offset);
+    paged.nameLengths.remove(offset);
+    paged.dirOfRow.remove(offset);
+    paged.headerBytes.remove(offset);
+    paged.pHashes.remove(offset);
+    paged.contentHashes.remove(offset);
+    paged.integrity.remove(offset);
+    paged.medianColors.remove(offset);
+    paged.dominantColors.remove(offset * 3, 3);
+    paged.recompressBytes.remove(offset * RecompressTargetCount, RecompressTargetCount);
+    paged.recompressQuality.remove(offset);
+    loadedBytes += paged.memoryBytes() - before;
+
+    if (paged.rows() == 0) {
+        loadedBytes -= paged.memoryBytes();
+        pages.erase(pages.begin() + index);
+        pageStarts.remove(index);
+        lastPage = 0;
+    } else {
+        ++index;
+    }
+    for (int i = index; i < pageStarts.size(); ++i) --pageStarts[i];
+
+    widths.remove(row);
+    heights.remove(row);
+    dpiXs.remove(row);
+    dpiYs.remove(row);
+    depths.remove(row);
+    flagBits.remove(row);
+    formatIds.remove(row);
+    compressionIds.remove(row);
+    colorSpaceIds.remove(row);
+    encoderIds.remove(row);
+    quantIds.remove(row);
+    fileSizes.remove(row);
+    meanColors.remove(row);
+    lumaLevels.remove(row);
+}
+
+QString ScanResults::fileName(int row) const
+{
+    int offset = 0;
+    const Page &paged = pageOf(row, &offset);
+    return QString::fromUtf8(paged.nameArena.constData() + paged.nameOffsets[offset], paged.nameLengths[offset]);
+}
+
+QString ScanResults::filePath(int row) const
+{
+    int offset = 0;
+    const Page &paged = pageOf(row, &offset);
+    return dirs[paged.dirOfRow[offset]] + "/"
+           + QString::fromUtf8(paged.nameArena.constData() + paged.nameOffsets[offset], paged.nameLengths[offset]);
+}
+
+qint64 ScanResults::headerBytesRead(int row) const
+{
+    int offset = 0;
+    return pageOf(row, &offset).headerBytes[offset];
+}
+
+quint8 ScanResults::integrity(int row) const
+{
+    int offset = 0;
+    return pageOf(row, &offset).integrity[offset];
+}
+
+ColorStats ScanResults::colorStats(int row) const
+{
+    ColorStats stats;
+    if (!hasColorStats(row)) return stats;
+    stats.samples = 1;
+    stats.mean = meanColor(row);
+    for (int k = 0; k < 3; ++k) stats.luma[k] = static_cast<quint8>(luminancePercentile(row, k));
+    int offset = 0;
+    const Page &paged = pageOf(row, &offset);
+    stats.median = paged.medianColors[offset];
+    for (int k = 0; k < 3; ++k) {
+        quint32 color = paged.dominantColors[offset * 3 + k];
+        if (color == 0) break;  // доля основного цвета не меньше 5%, так что 0 - это "нет"
+        stats.dominant[k] = color & 0xFFFFFF;
+        stats.dominantShare[k] = static_cast<quint8>(color >> 24);
+        stats.dominantCount = static_cast<quint8>(k + 1);
+    }
+    return stats;
+}
+
+RecompressEstimate ScanResults::recompressEstimate(int row) const
+{
+    RecompressEstimate estimate;
+    int offset = 0;
+    const Page &paged = pageOf(row, &offset);
+    quint8 quality = paged.recompressQuality[offset];
+    if (quality == 0) return estimate;
+    estimate.jpegQuality = quality & 0x7F;
+    estimate.exact = quality & 0x80;
+    for (int target = 0; target < RecompressTargetCount; ++target)
+        estimate.bytes[target] = paged.recompressBytes[offset * RecompressTargetCount + target];
+    return estimate;
+}
+
+quint64 ScanResults::perceptualHash(int row) const
+{
+    int offset = 0;
+    return pageOf(row, &offset).pHashes[offset];
+}
+
+quint64 ScanResults::contentHash(int row) const
+{
+    int offset = 0;
+    return pageOf(row, &offset).contentHashes[offset];
+}
+
+QVector<quint64> ScanResults::perceptualHashes() const
+{
+    QVector<quint64> result;
+    result.reserve(size());
+    for (int i = 0; i < static_cast<int>(pages.size()); ++i) result.append(page(i).pHashes);
+    return result;
+}
+
+QVector<quint64> ScanResults::contentHashColumn() const
+{
+    QVector<quint64> result;
+    result.reserve(size());
+    for (int i = 0; i < static_cast<int>(pages.size()); ++i) result.append(page(i).contentHashes);
+    return result;
+}
+
+qint64 ScanResults::quantTableUsers(quint32 id) const
+{
+    return std::count(quantIds.constBegin(), quantIds.constEnd(), id);
+}
+
+QVector<QualityGroup> ScanResults::qualityGroups() const
+{
+    // Сначала число файлов по парам (программа, набор таблиц): пар столько же,
+    // сколько различных наборов, и качество каждого набора уже посчитано в пуле
+    struct Users {
+        qint64 files = 0;
+        qint64 bytes = 0;
+    };
+    QHash<quint64, Users> byPair;
+    for (int row = 0; row < size(); ++row) {
+        if (quantIds[row] == 0) continue;
+        Users &users = byPair[(quint64(encoderIds[row]) << 32) | quantIds[row]];
+        ++users.files;
+        users.bytes += fileSizes[row];
+    }
+
+    // Затем пары с одинаковыми программой и качеством сливаются в группу
+    QVector<QualityGroup> groups;
+    QHash<quint64, int> groupOf;
+    for (auto it = byPair.constBegin(); it != byPair.constEnd(); ++it) {
+        quint32 encoderId = static_cast<quint32>(it.key() >> 32);
+        const JpegQuality &quality = quantPool.quality(static_cast<quint32>(it.key()));
+        quint64 key = (quint64(encoderId) << 16) | (quint64(quality.quality) << 1) | (quality.exactIjg ? 1 : 0);
+        auto found = groupOf.constFind(key);
+        int index = found != groupOf.constEnd() ? found.value() : -1;
+        if (index < 0) {
+            index = groups.size();
+            groupOf.insert(key, index);
+            QualityGroup group;
+            group.encoder = encoders.at(encoderId);
+            group.quality = quality;
+            groups.append(group);
+        }
+        QualityGroup &group = groups[index];
+        group.files += it.value().files;
+        group.bytes += it.value().bytes;
+        ++group.tableSets;
+    }
+    std::sort(groups.begin(), groups.end(), [](const QualityGroup &a, const QualityGroup &b) {
+        if (a.files != b.files) return a.files > b.files;
+        if (a.quality.quality != b.quality.quality) return a.quality.quality > b.quality.quality;
+        return a.encoder < b.encoder;
+    });
+    return groups;
+}
+
+QString ScanResults::displayText(int row, int column) const
+{
+    // Заголовок ещё не разобран - известно только имя
+    if ((flagBits[row] & ImagePending) && column != FileNameColumn) return QStringLiteral("…");
+    // Поля второго уровня ещё не посчитаны - не показываем "N/A" раньше времени
+    if (!(flagBits[row] & ImageDetailed)
+        && (column == ResolutionColumn || column == CompressionRatioColumn || column == AdditionalInfoColumn))
+        return QStringLiteral("…");
+
+    switch (column) {
+    case FileNameColumn: return fileName(row);
+    case PixelSizeColumn: return formatPixelSize(widths[row], heights[row]);
+    case ResolutionColumn: return formatResolution(dpiXs[row], dpiYs[row]);
+    case ColorDepthColumn: return formatColorDepth(depths[row]);
+    case CompressionColumn: return compression(row);
+    case CompressionRatioColumn:
+        return formatCompressionRatio(format(row), fileSizes[row], widths[row], heights[row], depths[row], flagBits[row]);
+    case RecompressColumn: return formatRecompressEstimate(recompressEstimate(row));
+    case FormatColumn: return format(row);
+    case FileSizeColumn: return formatFileSize(fileSizes[row]);
+    case AdditionalInfoColumn: {
+        QString text = formatAdditionalInfo(colorSpace(row), widths[row], heights[row], flagBits[row]);
+        if (flagBits[row] & ImageCorrupt)
+            text = "Повреждён: " + integrityStatusName(static_cast<IntegrityStatus>(integrity(row))) + "; " + text;
+        return text;
+    }
+    case MeanColorColumn: return formatMeanColor(colorStats(row));
+    case DominantColorsColumn: return formatDominantColors(colorStats(row));
+    case LuminanceColumn: return formatLuminance(colorStats(row));
+    default: return QString();
+    }
+}
+
+void ScanResults::invalidateSortIndexes()
+{
+    for (int column = 0; column < ColumnCount; ++column) dropSortIndex(column);
+}
+
+void ScanResults::dropSortIndex(int column)
+{
+    sortIndexes[column].clear();
+    staleRows[column].clear();
+    pagedKeys[column].clear();
+    if (column == FileNameColumn) nameKeys.clear();
+}
+
+qint64 ScanResults::sortKey(int column, int row) const
+{
+    switch (column) {
+    case PixelSizeColumn:
+        return static_cast<qint64>(qMax(widths[row], 0)) * qMax(heights[row], 0);
+    case ResolutionColumn:
+        return (static_cast<qint64>(dpiXs[row]) << 16) | dpiYs[row];
+    case ColorDepthColumn:
+        return depths[row];
+    case CompressionColumn:
+        return labelRanks[compressionIds[row]];
+    case CompressionRatioColumn: {
+        // Та же величина, что в formatCompressionRatio(): доля сэкономленного места, в тысячных процента
+        qint64 uncompressed = static_cast<qint64>(qMax(widths[row], 0)) * qMax(heights[row], 0) * (depths[row] / 8);
+        if (!(flagBits[row] & ImageDecoded) || uncompressed <= 0 || fileSizes[row] <= 0 || format(row) == "BMP")
+            return std::numeric_limits<qint64>::min();
+        return (uncompressed - fileSizes[row]) * 100000 / uncompressed;
+    }
+    case RecompressColumn: {
+        // По выигрышу лучшего варианта против текущего файла: больше всего экономящие - в конце
+        RecompressEstimate estimate = recompressEstimate(row);
+        qint64 best = estimate.best();
+        if (best < 0) return std::numeric_limits<qint64>::min();
+        return fileSizes[row] - best;
+    }
+    case FormatColumn:
+        return labelRanks[formatIds[row]];
+    case FileSizeColumn:
+        return fileSizes[row];
+    case AdditionalInfoColumn:
+        return (static_cast<qint64>(labelRanks[colorSpaceIds[row]]) << 8) | flagBits[row];
+    case MeanColorColumn: {
+        // По яркости среднего цвета, без статистики - в начале
+        if (!hasColorStats(row)) return -1;
+        quint32 rgb = meanColor(row);
+        int luma = (54 * int(rgb >> 16) + 183 * int((rgb >> 8) & 0xFF) + 19 * int(rgb & 0xFF)) >> 8;
+        return (static_cast<qint64>(luma) << 24) | rgb;
+    }
+    case DominantColorsColumn: {
+        // По доле главного цвета: однотонные изображения - в конце
+        if (!hasColorStats(row)) return -1;
+        int offset = 0;
+        return pageOf(row, &offset).dominantColors[offset * 3] >> 24;
+    }
+    case LuminanceColumn:
+        // По медиане, затем p5 и p95
+        if (!hasColorStats(row)) return -1;
+        return (static_cast<qint64>(luminancePercentile(row, 1)) << 16) | (luminancePercentile(row, 0) << 8)
+               | luminancePercentile(row, 2);
+    default:
+        return row;  // миниатюры - порядок добавления
+    }
+}
+
+QByteArray ScanResults::nameBytes(int row) const
+{
+    int offset = 0;
+    const Page &paged = pageOf(row, &offset);
+    return QByteArray(paged.nameArena.constData() + paged.nameOffsets[offset], paged.nameLengths[offset]);
+}
+
+void ScanResults::extendNameKeys() const
+{
+    // Страницы новых строк читаются по порядку, строки QString не создаются
+    int row = nameKeys.size();
+    nameKeys.resize(size());
+    while (row < size()) {
+        int offset = 0;
+        const Page &paged = pageOf(row, &offset);
+        for (; offset < paged.rows() && row < size(); ++offset, ++row)
+            nameKeys[row] = namePrefixKey(paged.nameArena.constData() + paged.nameOffsets[offset],
+                                          paged.nameLengths[offset]);
+    }
+}
+
+QVector<int> ScanResults::nameSortIndex() const
+{
+    // Сначала по префиксам имён из nameKeys, полные имена читаются только для равных префиксов
+    nameKeys.clear();
+    extendNameKeys();
+    std::vector<std::pair<quint64, int>> keys;
+    keys.reserve(size());
+    for (int row = 0; row < size(); ++row) keys.push_back({nameKeys[row], row});
+    std::sort(keys.begin(), keys.end());  // равные ключи остаются в порядке строк
+
+    QVector<int> index(static_cast<int>(keys.size()));
+    for (size_t i = 0; i < keys.size();) {
+        size_t end = i + 1;
+        while (end < keys.size() && keys[end].first == keys[i].first) ++end;
+        if (end - i == 1) {
+            index[static_cast<int>(i)] = keys[i].second;
+        } else {
+            // Общий префикс - досортировываем группу по полным именам
+            std::vector<std::pair<QByteArray, int>> group;
+            group.reserve(end - i);
+            for (size_t k = i; k < end; ++k) group.push_back({nameBytes(keys[k].second), keys[k].second});
+            std::stable_sort(group.begin(), group.end(),
+                             [](const auto &a, const auto &b) { return a.first < b.first; });
+            for (size_t k = i; k < end; ++k) index[static_cast<int>(k)] = group[k - i].second;
+        }
+        i = end;
+    }
+    return index;
+}
+
+const QVector<int> &ScanResults::sortIndex(int column) const
+{
+    if (column < 0 || column >= ColumnCount) column = ThumbnailColumn;
+    QVector<int> &index = sortIndexes[column];
+    QVector<int> &stale = staleRows[column];
+    int sorted = index.size();
+    if (sorted == size() && stale.isEmpty()) return index;
+
+    // Имена лежат страницами: с нуля индекс строится одним проходом, дальше новые строки
+    // досортировываются и вливаются по резидентным префиксам имён (nameKeys) - страницы
+    // старых строк читаются только при равных префиксах
+    if (column == FileNameColumn) {
+        if (sorted == 0) {
+            index = nameSortIndex();
+            return index;
+        }
+        extendNameKeys();
+        auto nameLess = [this](int a, int b) {
+            if (nameKeys[a] != nameKeys[b]) return nameKeys[a] < nameKeys[b];
+            QByteArray nameA = nameBytes(a);
+            QByteArray nameB = nameBytes(b);
+            return nameA < nameB || (nameA == nameB && a < b);
+        };
+        index.resize(size());
+        std::iota(index.begin() + sorted, index.end(), sorted);
+        std::sort(index.begin() + sorted, index.end(), nameLess);
+        std::inplace_merge(index.begin(), index.begin() + sorted, index.end(), nameLess);
+        return index;
+    }
+
+    // Ранги подписей: их немного, пересчитываем только при появлении новой.
+    // Новая подпись сдвигает ранги - индексы по подписям строятся заново
+    if (labelRanks.size() != labels.size()) {
+        QVector<int> order(labels.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return labels.at(a) < labels.at(b); });
+        labelRanks.resize(labels.size());
+        for (int rank = 0; rank < order.size(); ++rank) labelRanks[order[rank]] = rank;
+        for (int labelColumn : {CompressionColumn, FormatColumn, AdditionalInfoColumn})
+            dropSortIndex(labelColumn);
+        sorted = index.size();
+    }
+
+    // Ключи из страниц (основные цвета, пересжатие) снимаются проходом по строкам подряд
+    // и хранятся, пока индекс жив: сравнения при сортировке и вливании страниц не читают
+    const QVector<qint64> *cached = nullptr;
+    if (column == DominantColorsColumn || column == RecompressColumn) {
+        QVector<qint64> &keys = pagedKeys[column];
+        int known = keys.size();
+        keys.resize(size());
+        for (int row = known; row < size(); ++row) keys[row] = sortKey(column, row);
+        std::sort(stale.begin(), stale.end());
+        for (int row : std::as_const(stale)) keys[row] = sortKey(column, row);
+        cached = &keys;
+    }
+    auto key = [this, column, cached](int row) { return cached ? (*cached)[row] : sortKey(column, row); };
+    auto less = [&key](int a, int b) { return key(a) < key(b); };
+
+    // Заполненные заготовки вынимаем из индекса и вливаем заново за O(n + k log k).
+    // При равных ключах - по номеру строки, как при построении с нуля
+    if (!stale.isEmpty()) {
+        QVector<quint8> moved(sorted, 0);
+        for (int row : std::as_const(stale)) moved[row] = 1;
+        index.erase(std::remove_if(index.begin(), index.end(), [&moved](int row) { return moved[row] != 0; }),
+                    index.end());
+        int kept = index.size();
+        std::sort(stale.begin(), stale.end());
+        std::stable_sort(stale.begin(), stale.end(), less);
+        index += stale;
+        stale.clear();
+        auto lessOrEarlier = [&key](int a, int b) {
+            qint64 keyA = key(a);
+            qint64 keyB = key(b);
+            return keyA < keyB || (keyA == keyB && a < b);
+        };
+        std::inplace_merge(index.begin(), index.begin() + kept, index.end(), lessOrEarlier);
+    }
+    index.resize(size());
+    std::iota(index.begin() + sorted, index.end(), sorted);
+    std::stable_sort(index.begin() + sorted, index.end(), less);
+    std::inplace_merge(index.begin(), index.begin() + sorted, index.end(), less);
+    return index;
+}
+
+QVector<quint8> ScanResults::matchRows(const ResultFilter &filter) const
+{
+    QVector<quint8> result;
+    matchRows(filter, result, {});
+    return result;
+}
+
+void ScanResults::matchRows(const ResultFilter &filter, QVector<quint8> &result, const QVector<int> &changed) const
+{
+    const int n = size();
+    int from = result.size();
+    if (from > n) from = 0;  // строки удалялись, а отметки не сдвинули - считаем заново
+    result.resize(n);
+    if (filter.isEmpty()) {
+        result.fill(1);
+        return;
+    }
+    if (from == n && changed.isEmpty()) return;
+
+    // Формат из списка сравниваем по номеру подписи; неизвестный не совпадёт ни с чем
+    int formatId = -1;
+    for (int id = 0; id < labels.size() && !filter.format.isEmpty(); ++id)
+        if (labels.at(static_cast<quint16>(id)) == filter.format) formatId = id;
+    const ResultQuery::Matcher query = filter.query.matcher(*this);
+
+    // Потоки пишут в непересекающиеся куски через сырой указатель - без отсоединения QVector
+    quint8 *out = result.data();
+    auto run = [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            bool ok = (filter.format.isEmpty() || formatIds[row] == formatId)
+                      && fileSizes[row] >= filter.minFileSize
+                      && (filter.minPixels <= 0
+                          || static_cast<qint64>(qMax(widths[row], 0)) * qMax(heights[row], 0) >= filter.minPixels)
+                      && (!filter.alphaOnly || (flagBits[row] & ImageAlpha))
+                      && query(row);
+            out[row] = ok;
+        }
+    };
+
+    // Изменившиеся строки (заполненные заготовки, новые детали) - по одной, новые - кусками
+    for (int row : changed)
+        if (row >= 0 && row < from) run(row, row + 1);
+    if (n - from <= kFilterChunk) {
+        run(from, n);
+        return;
+    }
+    for (int begin = from; begin < n; begin += kFilterChunk) {
+        int end = qMin(n, begin + kFilterChunk);
+        filterPool.start([&run, begin, end]() { run(begin, end); });
+    }
+    filterPool.waitForDone();
+}
+
+QStringList ScanResults::formats() const
+{
+    QVector<bool> seen(labels.size());
+    for (quint16 id : formatIds) seen[id] = true;
+    QStringList result;
+    for (int id = 0; id < seen.size(); ++id)
+        if (seen[id] && !labels.at(id).isEmpty()) result.append(labels.at(id));
+    result.sort();
+    return result;
+}
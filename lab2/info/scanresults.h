@@ -0,0 +1,281 @@
+#ifndef SCANRESULTS_H
+#define SCANRESULTS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QThreadPool>
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "imageinfo.h"
+#include "quanttables.h"
+#include "resultquery.h"
+
+class QDataStream;
+class QTemporaryFile;
+
+// Пул интернированных строк: одинаковые значения хранятся один раз, в строках таблицы - только номер.
+// Номера типа Id не переиспользуются: пул, которому не хватило номеров, - ошибка, а не перенос
+template <typename Id>
+class BasicStringPool {
+public:
+    Id intern(const QString &value)
+    {
+        auto it = ids.constFind(value);
+        if (it != ids.constEnd()) return it.value();
+        if (static_cast<quint64>(strings.size()) > std::numeric_limits<Id>::max())
+            qFatal("BasicStringPool: more than %llu distinct strings",
+                   static_cast<unsigned long long>(std::numeric_limits<Id>::max()) + 1);
+        Id id = static_cast<Id>(strings.size());
+        strings.append(value);
+        ids.insert(value, id);
+        return id;
+    }
+    const QString &at(Id id) const { return strings[id]; }
+    int size() const { return strings.size(); }
+
+private:
+    QVector<QString> strings;
+    QHash<QString, Id> ids;
+};
+
+// Подписи (формат, сжатие, цветовое пространство) - их единицы
+using StringPool = BasicStringPool<quint16>;
+// Программы-кодировщики - по одной на каждую версию, их может быть сколько угодно
+using EncoderPool = BasicStringPool<quint32>;
+
+// Условия отбора строк; проверяются по типизированным колонкам, без разбора текста
+struct ResultFilter {
+    QString format;          // "JPEG", "PNG", ...; пусто - любой
+    qint64 minFileSize = 0;  // байт
+    qint64 minPixels = 0;    // ширина x высота
+    bool alphaOnly = false;
+    ResultQuery query;       // выражение из строки фильтра
+
+    bool isEmpty() const
+    {
+        return format.isEmpty() && minFileSize <= 0 && minPixels <= 0 && !alphaOnly && query.isEmpty();
+    }
+};
+
+// Группа JPEG с одной программой-кодировщиком и одним оценённым качеством
+struct QualityGroup {
+    QString encoder;      // пусто - не указана
+    JpegQuality quality;
+    qint64 files = 0;
+    qint64 bytes = 0;
+    int tableSets = 0;    // различных наборов таблиц квантования в группе
+};
+
+// Колоночное (struct-of-arrays) хранилище результатов сканирования.
+// Числовые поля, по которым сортируют и отбирают строки, всегда в памяти
+// (около 42 байт на файл). Имена, хеши, медиана и основные цвета лежат страницами по kPageRows строк:
+// страницы сверх бюджета памяти вытесняются во временный файл и подгружаются
+// при обращении. Каталоги, подписи и наборы таблиц квантования - в пулах,
+// текст формируется только в displayText().
+class ScanResults {
+public:
+    enum Column {
+        ThumbnailColumn,  // только картинка, текста нет
+        FileNameColumn,
+        PixelSizeColumn,
+        ResolutionColumn,
+        ColorDepthColumn,
+        CompressionColumn,
+        CompressionRatioColumn,
+        RecompressColumn,      // оценка размера после пересжатия в PNG / JPEG / WebP
+        FormatColumn,
+        FileSizeColumn,
+        AdditionalInfoColumn,
+        MeanColorColumn,       // средний и медианный цвет
+        DominantColorsColumn,
+        LuminanceColumn,       // перцентили яркости p5 / p50 / p95
+        ColumnCount
+    };
+
+    ScanResults();
+    ~ScanResults();
+
+    ScanResults(const ScanResults &) = delete;
+    ScanResults &operator=(const ScanResults &) = delete;
+
+    int size() const { return widths.size(); }
+    void clear();
+    void reserve(int rows);
+
+    // Сколько памяти отдать под страницы; лишние уходят в файл подкачки
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return budget; }
+    qint64 pagedBytes() const { return loadedBytes; }  // страниц в памяти сейчас
+    qint64 spilledBytes() const;                        // размер файла подкачки
+
+    int append(const QString &filePath, const ImageInfo &info);
+    void update(int row, const QString &filePath, const ImageInfo &info);
+    // Заполняет строку-заготовку (ImagePending) разобранным заголовком. В отличие
+    // от update() индексы сортировки не сбрасываются: строка вливается в них заново
+    void fillPending(int row, const QString &filePath, const ImageInfo &info);
+    // Дописывает поля второго уровня (getImageDetails), остальные колонки не трогает
+    void updateDetails(int row, const ImageInfo &info);
+    bool hasDetails(int row) const { return flagBits[row] & ImageDetailed; }
+    void remove(int row);
+
+    QString filePath(int row) const;
+    QString fileName(int row) const;
+    QString displayText(int row, int column) const;
+
+    int width(int row) const { return widths[row]; }
+    int height(int row) const { return heights[row]; }
+    int dpiX(int row) const { return dpiXs[row]; }
+    int dpiY(int row) const { return dpiYs[row]; }
+    int colorDepth(int row) const { return depths[row]; }
+    quint8 flags(int row) const { return flagBits[row]; }
+    qint64 fileSize(int row) const { return fileSizes[row]; }
+    qint64 headerBytesRead(int row) const;
+    quint8 integrity(int row) const;  // IntegrityStatus
+    const QString &format(int row) const { return labels.at(formatIds[row]); }
+    const QString &compression(int row) const { return labels.at(compressionIds[row]); }
+    const QString &colorSpace(int row) const { return labels.at(colorSpaceIds[row]); }
+    const QString &encoder(int row) const { return encoders.at(encoderIds[row]); }
+
+    // Номера подписей в пуле - для запросов, сравнивающих числа вместо строк
+    quint16 formatId(int row) const { return formatIds[row]; }
+    quint16 compressionId(int row) const { return compressionIds[row]; }
+    quint16 colorSpaceId(int row) const { return colorSpaceIds[row]; }
+    int labelCount() const { return labels.size(); }
+    const QString &label(quint16 id) const { return labels.at(id); }
+    // Кодировщики - в своём пуле: их появление не сдвигает ранги подписей
+    quint32 encoderId(int row) const { return encoderIds[row]; }
+    int encoderCount() const { return encoders.size(); }
+    const QString &encoderName(quint32 id) const { return encoders.at(id); }
+
+    // Цветовая статистика: средний цвет и яркость резидентны (по ним сортируют и отбирают),
+    // медиана и основные цвета - в страницах. У собранной статистики samples - только признак (1)
+    bool hasColorStats(int row) const { return meanColors[row] & kColorValid; }
+    quint32 meanColor(int row) const { return meanColors[row] & 0xFFFFFF; }
+    int luminancePercentile(int row, int index) const { return (lumaLevels[row] >> (8 * index)) & 0xFF; }
+    ColorStats colorStats(int row) const;
+
+    // Оценка пересжатия (в страницах); без оценки - isValid() == false
+    RecompressEstimate recompressEstimate(int row) const;
+
+    quint64 perceptualHash(int row) const;
+    quint64 contentHash(int row) const;
+    // Колонки целиком (для поиска дубликатов) - собираются проходом по страницам
+    QVector<quint64> perceptualHashes() const;
+    QVector<quint64> contentHashColumn() const;
+
+    // Таблицы квантования JPEG интернированы: у строки только номер набора в пуле
+    // (0 - таблиц нет), одинаковые наборы со всего корпуса хранятся и оцениваются один раз
+    quint32 quantTableId(int row) const { return quantIds[row]; }
+    const QByteArray &quantTables(int row) const { return quantPool.tables(quantIds[row]); }
+    const JpegQuality &jpegQuality(int row) const { return quantPool.quality(quantIds[row]); }
+    int quantTableSetCount() const { return quantPool.size() - 1; }
+    qint64 quantTableUsers(quint32 id) const;  // сколько строк с этим набором
+
+    // JPEG, сгруппированные по программе и качеству, по убыванию числа файлов.
+    // Проход по двум резидентным колонкам, страницы не читаются
+    QVector<QualityGroup> qualityGroups() const;
+
+    // Номера строк по возрастанию значения колонки (по числам, а не по тексту ячеек).
+    // Строится один раз; добавленные и заполненные строки потом досортировываются
+    // и вливаются за O(n), update() и remove() сбрасывают индексы
+    const QVector<int> &sortIndex(int column) const;
+
+    // Отметка для каждой строки: прошла ли она отбор. Запрос привязывается к пулу
+    // подписей один раз, строки проверяются параллельно кусками
+    QVector<quint8> matchRows(const ResultFilter &filter) const;
+    // То же с запомненным результатом того же отбора: проверяются только строки,
+    // добавленные после прошлого вызова (от result.size()), и changed - строки,
+    // чьи значения с тех пор изменились
+    void matchRows(const ResultFilter &filter, QVector<quint8> &result, const QVector<int> &changed) const;
+    QStringList formats() const;  // различные форматы в таблице
+
+private:
+    // Редко нужные поля kPageRows подряд идущих строк
+    struct Page {
+        QByteArray nameArena;  // имена файлов подряд в UTF-8
+        QVector<quint32> nameOffsets;
+        QVector<quint16> nameLengths;
+        QVector<quint32> dirOfRow;
+        QVector<quint32> headerBytes;
+        QVector<quint64> pHashes;
+        QVector<quint64> contentHashes;
+        QVector<quint8> integrity;   // IntegrityStatus
+        QVector<quint32> medianColors;
+        QVector<quint32> dominantColors;  // по 3 на строку: 0xSSRRGGBB, SS - доля в %, 0 - нет цвета
+        QVector<qint64> recompressBytes;  // по RecompressTargetCount на строку
+        QVector<quint8> recompressQuality; // качество JPEG оценки | 0x80 для точной, 0 - оценки нет
+
+        int rows() const { return nameOffsets.size(); }
+        qint64 memoryBytes() const;
+        void save(QDataStream &out) const;
+        void load(QDataStream &in);
+    };
+
+    struct PageSlot {
+        std::unique_ptr<Page> page;  // nullptr - страница в файле подкачки
+        qint64 fileOffset = -1;
+        qint64 fileLength = 0;
+        bool dirty = true;           // в файле устаревшая копия или её нет
+        quint64 lastUse = 0;
+    };
+
+    void store(int row, const QString &filePath, const ImageInfo &info);
+    void storePaged(int row, const QString &filePath, const ImageInfo &info);
+    quint32 internDir(const QString &dir);
+    void invalidateSortIndexes();
+    void dropSortIndex(int column);
+    qint64 sortKey(int column, int row) const;
+    QByteArray nameBytes(int row) const;
+    void extendNameKeys() const;
+    QVector<int> nameSortIndex() const;
+
+    int pageIndex(int row) const;
+    Page &page(int index, bool modify = false) const;
+    const Page &pageOf(int row, int *offset) const;
+    void enforceBudget(int keep) const;
+    bool spillPage(int index) const;
+
+    StringPool labels;
+    EncoderPool encoders;
+    QuantTablePool quantPool;
+    QVector<QString> dirs;
+    QHash<QString, quint32> dirIds;
+
+    QVector<qint32> widths;
+    QVector<qint32> heights;
+    QVector<quint16> dpiXs;
+    QVector<quint16> dpiYs;
+    QVector<quint8> depths;
+    QVector<quint8> flagBits;
+    QVector<quint16> formatIds;
+    QVector<quint16> compressionIds;
+    QVector<quint16> colorSpaceIds;
+    QVector<quint32> encoderIds;
+    QVector<quint32> quantIds;
+    QVector<qint64> fileSizes;
+    static const quint32 kColorValid = 0x01000000;
+    QVector<quint32> meanColors;  // 0xRRGGBB | kColorValid
+    QVector<quint32> lumaLevels;  // p5 | p50 << 8 | p95 << 16
+
+    mutable std::vector<PageSlot> pages;
+    QVector<int> pageStarts;  // первая строка каждой страницы (после удалений страницы короче)
+    mutable int lastPage = 0; // последняя найденная страница - строки обычно читают подряд
+    mutable qint64 loadedBytes = 0;
+    mutable quint64 useClock = 0;
+    mutable std::unique_ptr<QTemporaryFile> spillFile;
+    qint64 budget = 256LL << 20;
+
+    mutable std::array<QVector<int>, ColumnCount> sortIndexes;  // покрывают строки [0, size индекса)
+    mutable std::array<QVector<int>, ColumnCount> staleRows;    // строки индекса, чей ключ с тех пор изменился
+    mutable std::array<QVector<qint64>, ColumnCount> pagedKeys;  // ключи колонок из страниц, по строкам
+    mutable QVector<quint64> nameKeys;  // первые 8 байт имени каждой строки - для вливания в индекс по имени
+    mutable QVector<int> labelRanks;  // алфавитный ранг каждой подписи из labels
+    mutable QThreadPool filterPool;   // потоки отбора живут между вызовами matchRows
+};
+
+#endif // SCANRESULTS_H
@@ -0,0 +1,196 @@
+#include "scanstats.h"
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <cmath>
+
+QString scanStageName(ScanStage stage)
+{
+    switch (stage) {
+    case ScanStage::Enumerate: return "enumerate";
+    case ScanStage::Open: return "open";
+    case ScanStage::Header: return "header";
+    case ScanStage::Decode: return "decode";
+    case ScanStage::QuantTable: return "quantTable";
+    case ScanStage::Hash: return "hash";
+    case ScanStage::Verify: return "verify";
+    case ScanStage::Colors: return "colors";
+    case ScanStage::Recompress: return "recompress";
+    case ScanStage::UiInsert: return "uiInsert";
+    default: return "unknown";
+    }
+}
+
+void LatencyHistogram::add(qint64 ns)
+{
+    int bucket = 0;
+    if (ns > 1) bucket = qBound(0, static_cast<int>(std::log2(static_cast<double>(ns)) * kBucketsPerOctave), kBucketCount - 1);
+    buckets[bucket]++;
+    samples++;
+    total += ns;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < kBucketCount; ++i) buckets[i] += other.buckets[i];
+    samples += other.samples;
+    total += other.total;
+}
+
+qint64 LatencyHistogram::percentileNs(double p) const
+{
+    if (samples == 0) return 0;
+    qint64 rank = static_cast<qint64>(std::ceil(p * samples));
+    qint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return static_cast<qint64>(std::exp2((i + 0.5) / kBucketsPerOctave));
+    }
+    return 0;
+}
+
+void ScanStats::clear()
+{
+    QMutexLocker locker(&mutex);
+    overall = StageHistograms();
+    byFormat.clear();
+    filesByFormat.clear();
+    files = 0;
+    wallMs = 0;
+    scanOrder.clear();
+    sortMs = 0;
+    coldScans.clear();
+}
+
+void ScanStats::addSample(ScanStage stage, const QString &format, qint64 ns)
+{
+    QMutexLocker locker(&mutex);
+    overall.stages[static_cast<int>(stage)].add(ns);
+    if (!format.isEmpty()) byFormat[format].stages[static_cast<int>(stage)].add(ns);
+}
+
+void ScanStats::addFile(const QString &format, const StageTimings &timings)
+{
+    QMutexLocker locker(&mutex);
+    StageHistograms &perFormat = byFormat[format];
+    for (int i = 0; i < static_cast<int>(ScanStage::Count); ++i) {
+        if (timings.ns[i] <= 0) continue;
+        overall.stages[i].add(timings.ns[i]);
+        perFormat.stages[i].add(timings.ns[i]);
+    }
+    filesByFormat[format]++;
+    files++;
+}
+
+void ScanStats::setWallTime(qint64 ms)
+{
+    QMutexLocker locker(&mutex);
+    wallMs = ms;
+}
+
+void ScanStats::setScanOrder(const QString &order, qint64 ms)
+{
+    QMutexLocker locker(&mutex);
+    scanOrder = order;
+    sortMs = ms;
+}
+
+void ScanStats::addColdScan(const QString &order, qint64 ms)
+{
+    QMutexLocker locker(&mutex);
+    coldScans.append({order, ms});
+}
+
+namespace {
+
+QJsonObject histogramToJson(const LatencyHistogram &h)
+{
+    QJsonObject obj;
+    obj["count"] = h.count();
+    obj["totalMs"] = h.totalNs() / 1e6;
+    obj["p50Us"] = h.percentileNs(0.50) / 1e3;
+    obj["p95Us"] = h.percentileNs(0.95) / 1e3;
+    obj["p99Us"] = h.percentileNs(0.99) / 1e3;
+    return obj;
+}
+
+}
+
+QJsonObject ScanStats::toJson() const
+{
+    QMutexLocker locker(&mutex);
+    QJsonObject root;
+    root["files"] = files;
+    root["wallMs"] = wallMs;
+    if (!scanOrder.isEmpty()) {
+        root["order"] = scanOrder;
+        root["orderSortMs"] = sortMs;
+    }
+    if (!coldScans.isEmpty()) {
+        QJsonObject cold;
+        for (const auto &scan : coldScans) cold[scan.first] = scan.second;
+        root["coldHeaderScanMs"] = cold;
+    }
+
+    QJsonObject stages;
+    for (int i = 0; i < static_cast<int>(ScanStage::Count); ++i) {
+        QJsonObject stage = histogramToJson(overall.stages[i]);
+        QJsonObject formats;
+        for (auto it = byFormat.constBegin(); it != byFormat.constEnd(); ++it) {
+            if (it.value().stages[i].count() > 0)
+                formats[it.key()] = histogramToJson(it.value().stages[i]);
+        }
+        stage["byFormat"] = formats;
+        stages[scanStageName(static_cast<ScanStage>(i))] = stage;
+    }
+    root["stages"] = stages;
+
+    QJsonObject counts;
+    for (auto it = filesByFormat.constBegin(); it != filesByFormat.constEnd(); ++it)
+        counts[it.key()] = it.value();
+    root["filesByFormat"] = counts;
+    return root;
+}
+
+QString ScanStats::toText() const
+{
+    QMutexLocker locker(&mutex);
+    QString text = QString("Файлов: %1, общее время: %2 мс\n").arg(files).arg(wallMs);
+    if (!scanOrder.isEmpty())
+        text += QString("Порядок разбора: %1 (сортировка %2 мс)\n").arg(scanOrder).arg(sortMs);
+    for (int i = 0; i < coldScans.size(); ++i) {
+        const auto &scan = coldScans[i];
+        text += QString("Холодный разбор заголовков, порядок %1: %2 мс").arg(scan.first).arg(scan.second);
+        // Ускорение относительно первого замера (обычно - порядок обхода)
+        if (i > 0 && scan.second > 0)
+            text += QString(" (x%1 к %2)").arg(double(coldScans[0].second) / scan.second, 0, 'f', 2).arg(coldScans[0].first);
+        text += "\n";
+    }
+    text += "\n";
+    text += QString("%1 %2 %3 %4 %5 %6\n")
+                .arg("Этап", -12).arg("Кол-во", 8).arg("Итого, мс", 11)
+                .arg("p50, мкс", 10).arg("p95, мкс", 10).arg("p99, мкс", 10);
+
+    auto appendRow = [&text](const QString &name, const LatencyHistogram &h) {
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+                    .arg(name, -12).arg(h.count(), 8)
+                    .arg(h.totalNs() / 1e6, 11, 'f', 1)
+                    .arg(h.percentileNs(0.50) / 1e3, 10, 'f', 0)
+                    .arg(h.percentileNs(0.95) / 1e3, 10, 'f', 0)
+                    .arg(h.percentileNs(0.99) / 1e3, 10, 'f', 0);
+    };
+
+    for (int i = 0; i < static_cast<int>(ScanStage::Count); ++i)
+        appendRow(scanStageName(static_cast<ScanStage>(i)), overall.stages[i]);
+
+    QStringList formats = byFormat.keys();
+    formats.sort();
+    for (const QString &format : std::as_const(formats)) {
+        text += QString("\n[%1] файлов: %2\n").arg(format.isEmpty() ? "?" : format).arg(filesByFormat.value(format));
+        const StageHistograms &perFormat = *byFormat.constFind(format);
+        for (int i = 0; i < static_cast<int>(ScanStage::Count); ++i) {
+            const LatencyHistogram &h = perFormat.stages[i];
+            if (h.count() > 0) appendRow(scanStageName(static_cast<ScanStage>(i)), h);
+        }
+    }
+    return text;
+}
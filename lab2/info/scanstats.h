@@ -0,0 +1,89 @@
+#ifndef SCANSTATS_H
+#define SCANSTATS_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QJsonObject>
+#include <QPair>
+#include <QVector>
+#include <array>
+
+// Этапы сканирования, для которых собираются замеры
+enum class ScanStage {
+    Enumerate,   // перечисление каталога (один замер на каталог)
+    Open,        // открытие файла и определение формата
+    Header,      // чтение заголовка (размер)
+    Decode,      // полное декодирование
+    QuantTable,  // извлечение таблиц квантования JPEG
+    Hash,        // перцептивный хеш и хеш содержимого
+    Verify,      // проверка целостности (проход по всему файлу)
+    Colors,      // цветовая статистика по уменьшенному декодированию
+    Recompress,  // оценка пересжатия по выборке плиток
+    UiInsert,    // добавление строки в таблицу
+    Count
+};
+
+QString scanStageName(ScanStage stage);
+
+// Длительности этапов для одного файла, нс (0 - этап не выполнялся)
+struct StageTimings {
+    std::array<qint64, static_cast<int>(ScanStage::Count)> ns{};
+
+    qint64 &operator[](ScanStage stage) { return ns[static_cast<int>(stage)]; }
+    qint64 operator[](ScanStage stage) const { return ns[static_cast<int>(stage)]; }
+};
+
+// Гистограмма длительностей в логарифмической шкале: фиксированная память
+// при любом числе файлов, точность перцентилей около 4%
+class LatencyHistogram {
+public:
+    void add(qint64 ns);
+    void merge(const LatencyHistogram &other);
+    qint64 count() const { return samples; }
+    qint64 totalNs() const { return total; }
+    qint64 percentileNs(double p) const;
+
+private:
+    static const int kBucketsPerOctave = 16;
+    static const int kBucketCount = 64 * kBucketsPerOctave;
+
+    std::array<quint32, kBucketCount> buckets{};
+    qint64 samples = 0;
+    qint64 total = 0;
+};
+
+// Потокобезопасный сборщик статистики сканирования: итоги и p50/p95/p99
+// по каждому этапу, в целом и отдельно по форматам
+class ScanStats {
+public:
+    void clear();
+    void addSample(ScanStage stage, const QString &format, qint64 ns);
+    void addFile(const QString &format, const StageTimings &timings);
+    void setWallTime(qint64 ms);
+    // Порядок разбора (см. ScanOrder) и сколько заняла сортировка по нему
+    void setScanOrder(const QString &order, qint64 sortMs);
+    // Замер холодного разбора заголовков в одном из порядков - для сравнения порядков
+    void addColdScan(const QString &order, qint64 ms);
+
+    QJsonObject toJson() const;
+    QString toText() const;
+
+private:
+    struct StageHistograms {
+        std::array<LatencyHistogram, static_cast<int>(ScanStage::Count)> stages;
+    };
+
+    mutable QMutex mutex;
+    StageHistograms overall;
+    QHash<QString, StageHistograms> byFormat;
+    QHash<QString, qint64> filesByFormat;
+    qint64 files = 0;
+    qint64 wallMs = 0;
+    QString scanOrder;
+    qint64 sortMs = 0;
+    QVector<QPair<QString, qint64>> coldScans;  // порядок и время, мс
+};
+
+#endif // SCANSTATS_H
@@ -0,0 +1,147 @@
+#include "thumbnailcache.h"
+#include "fileview.h"
+#include "probeworker.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <memory>
+
+namespace {
+
+const int kMaxPending = 512;       // дальше - запросы для строк, давно ушедших с экрана
+const qint64 kKeyPrefix = 64 * 1024;
+
+}
+
+ThumbnailCache::ThumbnailCache(int thumbnailSize, QObject *parent)
+    : QObject(parent), size(thumbnailSize)
+{
+    cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    QDir().mkpath(cacheDir);
+    memory.setMaxCost(64 * 1024);  // ~64 МБ миниатюр в памяти
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    pool.clear();
+    pool.waitForDone();
+}
+
+void ThumbnailCache::clear()
+{
+    memory.clear();
+    stack.clear();
+    failed.clear();
+    queued.clear();
+}
+
+QImage ThumbnailCache::thumbnail(const QString &filePath, quint64 contentHash)
+{
+    if (QImage *cached = memory.object(filePath)) return *cached;
+    if (failed.contains(filePath)) return QImage();
+
+    if (!queued.contains(filePath)) {
+        queued.insert(filePath);
+        stack.append({filePath, contentHash});
+        if (stack.size() > kMaxPending) {
+            queued.remove(stack.first().filePath);
+            stack.removeFirst();
+        }
+        pump();
+    }
+    return QImage();
+}
+
+void ThumbnailCache::pump()
+{
+    while (!stack.isEmpty() && inFlight < pool.maxThreadCount()) {
+        Request request = stack.takeLast();
+        ++inFlight;
+        const int thumbSize = size;
+        const QString dir = cacheDir;
+        const int isolation = isolationTimeoutMs;
+        pool.start([this, request, thumbSize, dir, isolation]() {
+            QString failure;
+            QImage image = generate(request.filePath, request.contentHash, thumbSize, dir, isolation, &failure);
+            QMetaObject::invokeMethod(this, [this, path = request.filePath, image, failure]() {
+                onGenerated(path, image);
+                if (!failure.isEmpty()) emit probeFailed(path, failure);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void ThumbnailCache::onGenerated(const QString &filePath, const QImage &image)
+{
+    --inFlight;
+    if (queued.remove(filePath)) {
+        if (image.isNull()) {
+            failed.insert(filePath);
+        } else {
+            memory.insert(filePath, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+            emit thumbnailReady(filePath);
+        }
+    }
+    pump();
+}
+
+QString ThumbnailCache::contentKey(const QString &filePath, quint64 contentHash)
+{
+    if (contentHash != 0) return QString("%1").arg(contentHash, 16, 16, QChar('0'));
+
+    // Полный хеш содержимого не считали - адресуем по размеру, времени изменения и первым 64 КБ.
+    // Без времени файл, переписанный после первых 64 КБ с тем же размером (метаданные
+    // в конце, правка пикселей в TIFF), получил бы старую миниатюру
+    FileView view(filePath);
+    if (!view.isOpen()) return QString();
+    qint64 length = qMin(kKeyPrefix, view.size());
+    const uchar *data = view.data(0, length);
+    if (!data && length > 0) return QString();
+
+    QCryptographicHash sha1(QCryptographicHash::Sha1);
+    sha1.addData(QByteArray::number(view.size()));
+    sha1.addData(QByteArray::number(QFileInfo(filePath).lastModified().toMSecsSinceEpoch()));
+    sha1.addData(QByteArrayView(data, length));
+    return QString::fromLatin1(sha1.result().toHex().left(16));
+}
+
+QImage ThumbnailCache::generate(const QString &filePath, quint64 contentHash, int size, const QString &cacheDir,
+                                int isolationMs, QString *failure)
+{
+    QString key = contentKey(filePath, contentHash);
+    if (key.isEmpty()) return QImage();
+
+    QString dir = cacheDir + "/" + key.left(2);
+    QString cachePath = QString("%1/%2-%3.png").arg(dir, key).arg(size);
+    QImage cached(cachePath);
+    if (!cached.isNull()) return cached;
+
+    if (isolationMs > 0) {
+        // Чужой файл декодирует процесс-воркер и сам кладёт миниатюру в кэш,
+        // здесь читается только записанный им PNG. Процесс - свой у каждого потока пула
+        thread_local std::unique_ptr<ProbeProcess> process;
+        if (!process || process->timeout() != isolationMs) process = std::make_unique<ProbeProcess>(isolationMs);
+        ProbeRequest request;
+        request.filePath = filePath;
+        request.tasks = ProbeThumbnail;
+        request.thumbnailSize = size;
+        request.thumbnailPath = cachePath;
+        ImageInfo info;
+        StageTimings timings;
+        ProbeProcess::Outcome outcome = process->run(request, info, timings);
+        if (outcome == ProbeProcess::Done) return QImage(cachePath);
+        if (outcome != ProbeProcess::Unavailable) {
+            if (outcome != ProbeProcess::Cancelled) *failure = probeOutcomeName(outcome);
+            return QImage();
+        }
+    }
+
+    QImage image = decodeThumbnail(filePath, size);
+    if (image.isNull()) return QImage();
+    writeThumbnail(image, cachePath);
+    return image;
+}
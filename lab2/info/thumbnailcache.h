@@ -0,0 +1,61 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+// Миниатюры для таблицы: генерируются в фоне через QImageReader::setScaledSize
+// (JPEG декодируется сразу в 1/2, 1/4 или 1/8 размера) и сохраняются в дисковый
+// кэш, адресуемый содержимым файла. Запросы обслуживаются в порядке LIFO:
+// последние запрошенные - это строки, которые сейчас видны на экране.
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailCache(int thumbnailSize = 64, QObject *parent = nullptr);
+    ~ThumbnailCache();
+
+    // Не блокирует: вернёт миниатюру из памяти или пустое изображение
+    // и поставит файл в очередь. contentHash != 0 - готовый адрес в кэше.
+    QImage thumbnail(const QString &filePath, quint64 contentHash = 0);
+
+    void clear();
+    int thumbnailSize() const { return size; }
+    QString cacheDirectory() const { return cacheDir; }
+
+    // timeoutMs > 0 - декодировать в процессах-воркерах (см. ProbeProcess)
+    void setIsolation(int timeoutMs) { isolationTimeoutMs = timeoutMs; }
+
+signals:
+    void thumbnailReady(const QString &filePath);
+    void probeFailed(const QString &filePath, const QString &reason);  // воркер упал или завис
+
+private:
+    struct Request {
+        QString filePath;
+        quint64 contentHash;
+    };
+
+    void pump();
+    void onGenerated(const QString &filePath, const QImage &image);
+    static QString contentKey(const QString &filePath, quint64 contentHash);
+    static QImage generate(const QString &filePath, quint64 contentHash, int size, const QString &cacheDir,
+                           int isolationMs, QString *failure);
+
+    int size;
+    QString cacheDir;
+    QCache<QString, QImage> memory;  // путь -> миниатюра (стоимость - в КБ)
+    QVector<Request> stack;          // ожидающие запросы, вершина - самый свежий
+    QSet<QString> queued;            // в стеке или в работе
+    QSet<QString> failed;            // не декодируются - не запрашиваем повторно
+    int inFlight = 0;
+    int isolationTimeoutMs = 0;
+    QThreadPool pool;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,146 @@
+#include "corpus.h"
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSize>
+#include <QVector>
+
+namespace {
+
+struct SizeChoice {
+    QSize size;
+    int weight;
+};
+
+// Смесь размеров: много мелких и средних, немного крупных (как в реальных папках)
+const QVector<SizeChoice> kSizes = {
+    {QSize(64, 64), 20}, {QSize(320, 240), 25}, {QSize(640, 480), 25},
+    {QSize(1280, 958), 15}, {QSize(1920, 1080), 10}, {QSize(4000, 3000), 5}
+};
+
+// Глубины цвета: оттенки серого, палитра, truecolor, с прозрачностью
+const QVector<QImage::Format> kImageFormats = {
+    QImage::Format_Grayscale8, QImage::Format_Indexed8, QImage::Format_RGB32, QImage::Format_ARGB32
+};
+
+QSize pickSize(QRandomGenerator &rng)
+{
+    int total = 0;
+    for (const SizeChoice &c : kSizes) total += c.weight;
+    int r = rng.bounded(total);
+    for (const SizeChoice &c : kSizes) {
+        if (r < c.weight) return c.size;
+        r -= c.weight;
+    }
+    return kSizes.first().size;
+}
+
+// Градиент с шумом: хорошо сжимается, но не вырождается в пустой файл
+QImage makeImage(QRandomGenerator &rng, QSize size, QImage::Format format)
+{
+    QImage image(size, QImage::Format_ARGB32);
+    int phaseR = rng.bounded(256), phaseG = rng.bounded(256), phaseB = rng.bounded(256);
+    int noise = 8 + rng.bounded(48);
+
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            int n = rng.bounded(noise);
+            int r = (phaseR + x * 255 / size.width() + n) & 0xFF;
+            int g = (phaseG + y * 255 / size.height() + n) & 0xFF;
+            int b = (phaseB + (x + y) * 127 / (size.width() + size.height()) + n) & 0xFF;
+            int a = format == QImage::Format_ARGB32 ? 128 + (x * 127 / size.width()) : 255;
+            line[x] = qRgba(r, g, b, a);
+        }
+    }
+
+    if (format == QImage::Format_Indexed8) return image.convertToFormat(format, Qt::ThresholdDither);
+    return image.convertToFormat(format);
+}
+
+}
+
+QStringList corpusFormats()
+{
+    const QStringList wanted = {"jpg", "png", "bmp", "gif", "tif", "pcx"};
+    const QList<QByteArray> writable = QImageWriter::supportedImageFormats();
+
+    QStringList formats;
+    for (const QString &f : wanted)
+        if (writable.contains(f.toLatin1())) formats << f;
+    return formats;
+}
+
+const char kCorpusManifest[] = "infobench-corpus.json";
+
+bool isGeneratedCorpus(const QString &directory)
+{
+    return QFile::exists(QDir(directory).filePath(kCorpusManifest));
+}
+
+bool readCorpus(const CorpusOptions &options, QStringList &files)
+{
+    QDir dir(options.directory);
+    QFile file(dir.filePath(kCorpusManifest));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+
+    if (manifest["seed"].toVariant().toUInt() != options.seed) return false;
+    if (manifest["fileCount"].toInt() != options.fileCount) return false;
+    if (manifest["formats"].toVariant().toStringList() != corpusFormats()) return false;
+
+    QStringList listed;
+    for (const QJsonValue &name : manifest["files"].toArray()) {
+        QString path = dir.filePath(name.toString());
+        if (!QFile::exists(path)) return false;
+        listed << path;
+    }
+    if (listed.isEmpty()) return false;
+    files = listed;
+    return true;
+}
+
+QStringList generateCorpus(const CorpusOptions &options)
+{
+    QDir().mkpath(options.directory);
+    QDir dir(options.directory);
+
+    const QStringList formats = corpusFormats();
+    QRandomGenerator rng(options.seed);
+    QStringList files;
+
+    for (int i = 0; i < options.fileCount && !formats.isEmpty(); ++i) {
+        // Форматы по кругу - каждого примерно поровну
+        QString format = formats[i % formats.size()];
+        QSize size = pickSize(rng);
+        QImage::Format pixelFormat = kImageFormats[rng.bounded(static_cast<int>(kImageFormats.size()))];
+        if (format == "jpg" && pixelFormat == QImage::Format_ARGB32) pixelFormat = QImage::Format_RGB32;
+
+        // Раскладываем по подкаталогам, чтобы обход дерева тоже участвовал в замере
+        QString subdir = QString("d%1").arg(i % 16, 2, 10, QChar('0'));
+        dir.mkpath(subdir);
+        QString path = dir.filePath(QString("%1/img%2.%3").arg(subdir).arg(i, 6, 10, QChar('0')).arg(format));
+
+        QImageWriter writer(path, format.toLatin1());
+        if (format == "jpg") writer.setQuality(50 + rng.bounded(46));
+        if (writer.write(makeImage(rng, size, pixelFormat))) files << path;
+    }
+
+    QJsonArray names;
+    for (const QString &path : std::as_const(files)) names.append(dir.relativeFilePath(path));
+    QJsonObject manifest;
+    manifest["seed"] = static_cast<qint64>(options.seed);
+    manifest["fileCount"] = options.fileCount;
+    manifest["formats"] = QJsonArray::fromStringList(formats);
+    manifest["files"] = names;
+
+    QFile file(dir.filePath(kCorpusManifest));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(QJsonDocument(manifest).toJson(QJsonDocument::Indented));
+    return files;
+}
@@ -0,0 +1,31 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <QString>
+#include <QStringList>
+
+// Параметры синтетического набора изображений
+struct CorpusOptions {
+    QString directory;
+    int fileCount = 200;
+    quint32 seed = 42;
+};
+
+// Форматы, которые умеет записывать текущая сборка Qt (из поддерживаемых сканером)
+QStringList corpusFormats();
+
+// Имя файла-описания, который generateCorpus кладёт в каталог набора
+extern const char kCorpusManifest[];
+
+// Каталог создан generateCorpus (в нём лежит описание набора)
+bool isGeneratedCorpus(const QString &directory);
+
+// Описание набора в каталоге совпадает с options (seed, число файлов, форматы).
+// В files - файлы набора из описания, если все они на месте
+bool readCorpus(const CorpusOptions &options, QStringList &files);
+
+// Генерирует набор: при одинаковом seed содержимое файлов совпадает побайтно.
+// Записывает описание набора. Возвращает список созданных файлов.
+QStringList generateCorpus(const CorpusOptions &options);
+
+#endif // CORPUS_H
@@ -0,0 +1,22 @@
+QT       += core gui
+QT       -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Бенчмарк сканера: генерирует воспроизводимый набор изображений
+# и измеряет скорость getImageInfo (холодный/тёплый кэш, разное число потоков)
+
+include(../info/scanner.pri)
+
+SOURCES += \
+    corpus.cpp \
+    main.cpp
+
+HEADERS += \
+    corpus.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,247 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cstdio>
+#include "corpus.h"
+#include "imageinfo.h"
+#include "fileview.h"
+#include "headerprefetch.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Вытесняет файл из страничного кэша ОС (для замера "холодного" сканирования)
+bool evictFromPageCache(const QString &filePath)
+{
+#ifdef Q_OS_LINUX
+    int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY);
+    if (fd < 0) return false;
+    ::fdatasync(fd);
+    bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return ok;
+#else
+    Q_UNUSED(filePath);
+    return false;
+#endif
+}
+
+struct RunResult {
+    qint64 elapsedNs = 0;
+    int files = 0;
+};
+
+// Обычный разбор с той же работой, что и по прочитанному началу: декодируются только файлы,
+// целиком помещающиеся в буфер предварительного чтения. Иначе способы чтения
+// сравнивались бы с декодированием всех файлов
+RunResult runScan(const QStringList &files, int threads)
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &filePath : files) {
+        pool.start([filePath]() {
+            ImageInfo info = getImageHeaderInfo(filePath);
+            if (info.fileSize <= kDefaultHeaderBytes) getImageDetails(filePath, info);
+        });
+    }
+    pool.waitForDone();
+
+    return {timer.nsecsElapsed(), static_cast<int>(files.size())};
+}
+
+// Разбор по заранее прочитанным заголовкам: чтение очередью глубины depth,
+// разбор в пуле из threads потоков
+RunResult runPrefetchScan(const QStringList &files, int threads, PrefetchBackend backend, int depth)
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    QElapsedTimer timer;
+    timer.start();
+    {
+        HeaderPrefetcher prefetcher(backend, [&pool](PrefetchedHeader &&header) {
+            pool.start([header = std::move(header)]() { getImageInfoFromHeader(header); });
+        }, depth);
+        for (const QString &filePath : files) prefetcher.submit(filePath);
+        prefetcher.finish();
+    }
+    pool.waitForDone();
+
+    return {timer.nsecsElapsed(), static_cast<int>(files.size())};
+}
+
+QList<int> parseThreadCounts(const QString &value)
+{
+    QList<int> counts;
+    for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+        int n = part.trimmed().toInt();
+        if (n > 0) counts << n;
+    }
+    if (counts.isEmpty()) counts << 1 << QThread::idealThreadCount();
+    return counts;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("infobench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Бенчмарк сканера изображений на синтетическом наборе");
+    parser.addHelpOption();
+
+    QCommandLineOption corpusOption("corpus", "Каталог набора (создаётся, если пуст)", "dir",
+                                    QDir::temp().filePath("infobench-corpus"));
+    QCommandLineOption filesOption({"n", "files"}, "Число изображений в наборе", "n", "200");
+    QCommandLineOption seedOption("seed", "Начальное значение генератора", "seed", "42");
+    QCommandLineOption threadsOption({"j", "threads"}, "Список числа потоков через запятую", "list",
+                                     QString("1,2,4,%1").arg(QThread::idealThreadCount()));
+    QCommandLineOption accessOption("access", "Чтение заголовков: auto, mmap или pread", "mode", "auto");
+    QCommandLineOption ioOption("io", "Способы чтения через запятую: none (обычный разбор), pool, uring",
+                                "list", "none,pool,uring");
+    QCommandLineOption ioDepthOption("io-depth", "Глубина очереди предварительного чтения", "n", "256");
+    QCommandLineOption regenerateOption("regenerate", "Пересоздать набор, даже если он уже есть");
+    QCommandLineOption jsonOption("json", "Вывести результаты в JSON");
+    parser.addOption(corpusOption);
+    parser.addOption(filesOption);
+    parser.addOption(seedOption);
+    parser.addOption(threadsOption);
+    parser.addOption(accessOption);
+    parser.addOption(ioOption);
+    parser.addOption(ioDepthOption);
+    parser.addOption(regenerateOption);
+    parser.addOption(jsonOption);
+    parser.process(app);
+
+    setFileAccessMode(fileAccessModeFromString(parser.value(accessOption)));
+
+    CorpusOptions options;
+    options.directory = parser.value(corpusOption);
+    options.fileCount = qMax(1, parser.value(filesOption).toInt());
+    options.seed = parser.value(seedOption).toUInt();
+
+    QStringList files;
+    if (parser.isSet(regenerateOption) || !readCorpus(options, files)) {
+        // Удаляем только каталог, созданный самим бенчмарком: --corpus может указывать на чужие файлы
+        QDir dir(options.directory);
+        if (dir.exists() && !dir.isEmpty()) {
+            if (!isGeneratedCorpus(options.directory)) {
+                std::fprintf(stderr, "Каталог %s не пуст и не является набором infobench (нет %s) - "
+                                     "укажите пустой или новый каталог в --corpus\n",
+                             qPrintable(options.directory), kCorpusManifest);
+                return 1;
+            }
+            dir.removeRecursively();
+        }
+        std::fprintf(stderr, "Генерация набора: %d файлов (%s), seed=%u...\n", options.fileCount,
+                     qPrintable(corpusFormats().join(',')), options.seed);
+        files = generateCorpus(options);
+    }
+    if (files.isEmpty()) {
+        std::fprintf(stderr, "Не удалось создать набор в %s\n", qPrintable(options.directory));
+        return 1;
+    }
+    files.sort();  // одинаковый порядок обработки от запуска к запуску
+
+    qint64 totalBytes = 0;
+    for (const QString &filePath : std::as_const(files)) totalBytes += QFileInfo(filePath).size();
+
+    std::fprintf(stderr, "Набор: %lld файлов, %.1f МБ в %s\n",
+                 static_cast<long long>(files.size()), totalBytes / (1024.0 * 1024.0),
+                 qPrintable(options.directory));
+
+    bool coldSupported = evictFromPageCache(files.first());
+    const int ioDepth = qMax(1, parser.value(ioDepthOption).toInt());
+
+    QStringList ioModes;
+    for (const QString &part : parser.value(ioOption).split(',', Qt::SkipEmptyParts)) {
+        QString io = part.trimmed().toLower();
+        bool ok = io == "none";
+        if (!ok) prefetchBackendFromString(io, &ok);
+        if (!ok) {
+            std::fprintf(stderr, "Неизвестный способ чтения: %s\n", qPrintable(io));
+            return 2;
+        }
+        if (io == "uring" && !prefetchBackendAvailable(PrefetchBackend::Uring)) {
+            std::fprintf(stderr, "io_uring недоступен (нет liburing при сборке или запрещён ядром) - пропускаем\n");
+            continue;
+        }
+        ioModes << io;
+    }
+    if (ioModes.isEmpty()) ioModes << "none";
+
+    auto runOnce = [&](const QString &io, int threads) {
+        if (io == "none") return runScan(files, threads);
+        return runPrefetchScan(files, threads, prefetchBackendFromString(io), ioDepth);
+    };
+
+    QJsonArray runs;
+
+    if (!parser.isSet(jsonOption))
+        std::printf("%-6s %-8s %-6s %10s %10s %10s\n", "io", "threads", "cache", "ms", "files/s", "MB/s");
+
+    for (const QString &io : std::as_const(ioModes)) {
+        for (int threads : parseThreadCounts(parser.value(threadsOption))) {
+            for (const QString cache : {QString("cold"), QString("warm")}) {
+                if (cache == "cold") {
+                    if (!coldSupported) continue;
+                    for (const QString &filePath : std::as_const(files)) evictFromPageCache(filePath);
+                } else {
+                    runOnce(io, threads);  // прогрев
+                }
+
+                RunResult r = runOnce(io, threads);
+                double seconds = r.elapsedNs / 1e9;
+                double filesPerSec = r.files / seconds;
+                double mbPerSec = totalBytes / (1024.0 * 1024.0) / seconds;
+
+                if (parser.isSet(jsonOption)) {
+                    QJsonObject run;
+                    run["io"] = io;
+                    run["threads"] = threads;
+                    run["cache"] = cache;
+                    run["ms"] = r.elapsedNs / 1e6;
+                    run["filesPerSec"] = filesPerSec;
+                    run["mbPerSec"] = mbPerSec;
+                    runs.append(run);
+                } else {
+                    std::printf("%-6s %-8d %-6s %10.1f %10.1f %10.1f\n", qPrintable(io), threads, qPrintable(cache),
+                                r.elapsedNs / 1e6, filesPerSec, mbPerSec);
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+
+    if (!coldSupported)
+        std::fprintf(stderr, "Холодный кэш не поддерживается на этой платформе - только тёплые замеры\n");
+
+    if (parser.isSet(jsonOption)) {
+        QJsonObject root;
+        root["files"] = static_cast<int>(files.size());
+        root["bytes"] = totalBytes;
+        root["seed"] = static_cast<qint64>(options.seed);
+        root["access"] = fileAccessModeName(fileAccessMode());
+        root["ioDepth"] = ioDepth;
+        root["runs"] = runs;
+        std::printf("%s", QJsonDocument(root).toJson().constData());
+    }
+    return 0;
+}
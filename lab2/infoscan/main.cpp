@@ -0,0 +1,414 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include "imageinfo.h"
+#include "dirwalker.h"
+#include "diskorder.h"
+#include "imagehash.h"
+#include "fileview.h"
+#include "archivereader.h"
+#include "headerprefetch.h"
+#include "integritycheck.h"
+#include "crc32.h"
+#include "recordwriter.h"
+#include "scanstats.h"
+#include "probeworker.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Этот же исполняемый файл запускается процессом-воркером при --isolate
+    if (app.arguments().contains(QString::fromLatin1(kProbeWorkerArgument))) {
+        if (qEnvironmentVariableIsSet("INFO_FILE_ACCESS"))
+            setFileAccessMode(fileAccessModeFromString(qEnvironmentVariable("INFO_FILE_ACCESS")));
+        return runProbeWorker();
+    }
+    QCoreApplication::setApplicationName("infoscan");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Потоковый сканер сведений об изображениях (JSON Lines / CSV в stdout)");
+    parser.addHelpOption();
+    parser.addPositionalArgument("folder", "Папка для сканирования (с подпапками)");
+
+    QCommandLineOption formatOption({"f", "format"}, "Формат вывода: jsonl или csv", "format", "jsonl");
+    QCommandLineOption threadsOption({"j", "threads"}, "Число рабочих потоков", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption queueOption({"q", "queue"}, "Максимум файлов в обработке одновременно (0 = 4 x потоки)", "n", "0");
+    QCommandLineOption walkersOption("walkers", "Число потоков обхода каталогов", "n", "4");
+    QCommandLineOption hashOption("hash", "Считать перцептивный хеш и хеш содержимого");
+    QCommandLineOption duplicatesOption("duplicates", "Записать группы дубликатов в JSON-файл (включает --hash)", "file");
+    QCommandLineOption statsOption("stats", "Записать статистику по этапам в JSON-файл", "file");
+    QCommandLineOption accessOption("access", "Чтение заголовков: auto, mmap или pread", "mode", "auto");
+    QCommandLineOption archivesOption("archives", "Разбирать изображения внутри ZIP и TAR без распаковки на диск");
+    QCommandLineOption colorsOption("colors", "Цветовая статистика по уменьшенному декодированию: средний и медианный "
+                                              "цвет, основные цвета, перцентили яркости");
+    QCommandLineOption recompressOption("recompress", "Оценить размер после пересжатия в PNG, JPEG с качеством Q и WebP "
+                                                      "без потерь по выборке плиток", "Q");
+    QCommandLineOption jpegQualityOption("jpeg-quality", "В CSV - колонки программы-кодировщика и оценки качества JPEG "
+                                                         "(encoder, jpegQuality, quantTableSet); в JSON они есть всегда");
+    QCommandLineOption verifyOption("verify", "Проверять целостность: EOI в JPEG, CRC чанков PNG, размеры данных BMP и TIFF");
+    QCommandLineOption ioOption("io", "Предварительное чтение начала файлов: none, auto, uring или pool. Файлы длиннее "
+                                      "буфера (64 КБ) не декодируются: detailed=0, глубина и каналы - по заголовку",
+                                "backend", "none");
+    QCommandLineOption ioDepthOption("io-depth", "Глубина очереди предварительного чтения", "n", "256");
+    QCommandLineOption orderOption("order", "Порядок разбора: walk (по ходу обхода), inode или extent "
+                                            "(по физическому положению, FIEMAP) - для HDD и ленточных архивов; "
+                                            "кроме walk, разбор начинается после обхода", "order", "walk");
+    QCommandLineOption compareOrdersOption("compare-orders", "Перед сканированием замерить холодный разбор заголовков "
+                                                             "в порядке обхода и в порядке --order (файлы вытесняются из кеша)");
+    QCommandLineOption isolateOption("isolate", "Разбирать файлы в процессах-воркерах (по одному на поток): "
+                                                "падение или зависание декодера не останавливает сканирование");
+    QCommandLineOption probeTimeoutOption("probe-timeout", "Сколько ждать ответа воркера на один файл, мс", "ms", "10000");
+    parser.addOption(formatOption);
+    parser.addOption(threadsOption);
+    parser.addOption(queueOption);
+    parser.addOption(walkersOption);
+    parser.addOption(accessOption);
+    parser.addOption(archivesOption);
+    parser.addOption(verifyOption);
+    parser.addOption(jpegQualityOption);
+    parser.addOption(colorsOption);
+    parser.addOption(recompressOption);
+    parser.addOption(ioOption);
+    parser.addOption(ioDepthOption);
+    parser.addOption(orderOption);
+    parser.addOption(compareOrdersOption);
+    parser.addOption(isolateOption);
+    parser.addOption(probeTimeoutOption);
+    parser.addOption(statsOption);
+    parser.addOption(hashOption);
+    parser.addOption(duplicatesOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1 || !QFileInfo(args.first()).isDir()) {
+        std::fprintf(stderr, "Укажите существующую папку для сканирования\n");
+        return 2;
+    }
+
+    bool ok = false;
+    RecordFormat format = recordFormatFromString(parser.value(formatOption), &ok);
+    if (!ok) {
+        std::fprintf(stderr, "Неизвестный формат вывода: %s\n", qPrintable(parser.value(formatOption)));
+        return 2;
+    }
+    FileAccessMode mode = fileAccessModeFromString(parser.value(accessOption), &ok);
+    if (!ok) {
+        std::fprintf(stderr, "Неизвестный способ чтения: %s\n", qPrintable(parser.value(accessOption)));
+        return 2;
+    }
+    setFileAccessMode(mode);
+    ScanOrder order = scanOrderFromString(parser.value(orderOption), &ok);
+    if (!ok) {
+        std::fprintf(stderr, "Неизвестный порядок разбора: %s\n", qPrintable(parser.value(orderOption)));
+        return 2;
+    }
+    // Сравнивать порядок обхода с ним же бессмысленно
+    if (parser.isSet(compareOrdersOption) && order == ScanOrder::Walk) order = ScanOrder::Inode;
+
+    const bool prefetch = parser.value(ioOption).trimmed().toLower() != "none";
+    PrefetchBackend ioBackend = prefetchBackendFromString(parser.value(ioOption), &ok);
+    if (prefetch && !ok) {
+        std::fprintf(stderr, "Неизвестный способ предварительного чтения: %s\n", qPrintable(parser.value(ioOption)));
+        return 2;
+    }
+
+    int threads = qMax(1, parser.value(threadsOption).toInt());
+    int queueLimit = parser.value(queueOption).toInt();
+    if (queueLimit <= 0) queueLimit = threads * 4;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    // Ограничиваем число файлов "в полёте": обход папки ждёт, пока воркеры не освободятся,
+    // поэтому в памяти никогда не держится больше queueLimit результатов
+    QSemaphore inFlight(queueLimit);
+
+    ScanStats stats;
+
+    // Для поиска дубликатов нужны хеши всех файлов - по 16 байт плюс путь
+    const bool collectDuplicates = parser.isSet(duplicatesOption);
+    const bool hashing = parser.isSet(hashOption) || collectDuplicates;
+    QMutex hashMutex;
+    QStringList hashedPaths;
+    QVector<quint64> perceptualHashes;
+    QVector<quint64> contentHashes;
+
+    const bool verify = parser.isSet(verifyOption);
+    const bool colors = parser.isSet(colorsOption);
+    const int recompressQuality = parser.isSet(recompressOption) ? parser.value(recompressOption).toInt() : 0;
+    if (parser.isSet(recompressOption) && (recompressQuality < 1 || recompressQuality > 100)) {
+        std::fprintf(stderr, "Качество JPEG для --recompress - от 1 до 100\n");
+        return 2;
+    }
+    // Итоги оценки пересжатия: текущий объём и объём после пересжатия по форматам
+    QMutex recompressMutex;
+    qint64 recompressFiles = 0;
+    qint64 recompressCurrent = 0;
+    std::array<qint64, RecompressTargetCount> recompressCurrentFor{};
+    std::array<qint64, RecompressTargetCount> recompressTotals{};
+    auto addRecompress = [&](const ImageInfo &info) {
+        if (!info.recompress.isValid() || info.fileSize <= 0) return;
+        QMutexLocker locker(&recompressMutex);
+        ++recompressFiles;
+        recompressCurrent += info.fileSize;
+        for (int target = 0; target < RecompressTargetCount; ++target) {
+            if (info.recompress.bytes[target] < 0) continue;
+            recompressCurrentFor[target] += info.fileSize;
+            recompressTotals[target] += info.recompress.bytes[target];
+        }
+    };
+    std::atomic<qint64> corruptFiles{0};
+    if (verify) std::fprintf(stderr, "Проверка целостности, CRC32: %s\n", qPrintable(crc32Implementation()));
+
+    // С --isolate заголовок, хеши и проверка выполняются в процессе-воркере потока;
+    // файлы, на которых воркер упал или завис, отмечаются повреждёнными и перечисляются в stderr
+    const bool isolate = parser.isSet(isolateOption);
+
+    // Колонки CSV - только для включённого: отметки о падениях воркера идут в колонку целостности
+    int csvGroups = (verify || isolate ? CsvIntegrity : 0) | (parser.isSet(jpegQualityOption) ? CsvQuality : 0)
+                    | (colors ? CsvColors : 0) | (recompressQuality > 0 ? CsvRecompress : 0);
+    RecordWriter writer(stdout, format, csvGroups);
+    writer.writeHeader();
+
+    const int probeTimeoutMs = qMax(1, parser.value(probeTimeoutOption).toInt());
+    QMutex failureMutex;
+    QStringList probeFailures;
+    std::atomic<int> workerRestarts{0};
+    if (isolate && prefetch) std::fprintf(stderr, "С --isolate предварительное чтение не используется\n");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Разбор готового ImageInfo: хеши, дубликаты, запись и статистика.
+    // done - задачи ProbeTask, которые уже выполнил процесс-воркер (--isolate)
+    auto finishFile = [&](const QString &filePath, ImageInfo &info, StageTimings &timings, int done = 0) {
+        if (hashing && !(done & ProbeHash)) {
+            QElapsedTimer hashTimer;
+            hashTimer.start();
+            computeImageHashes(filePath, info);
+            timings[ScanStage::Hash] = hashTimer.nsecsElapsed();
+        }
+        if (verify && !(done & ProbeVerify)) {
+            QElapsedTimer verifyTimer;
+            verifyTimer.start();
+            verifyImageIntegrity(filePath, info);
+            timings[ScanStage::Verify] = verifyTimer.nsecsElapsed();
+        }
+        // Изображения из архива по пути "архив!/член" не декодируются - статистики у них нет
+        if (colors && !(done & ProbeColors) && !splitArchivePath(filePath)) {
+            QElapsedTimer colorTimer;
+            colorTimer.start();
+            computeColorStats(filePath, info.colors);
+            timings[ScanStage::Colors] = colorTimer.nsecsElapsed();
+        }
+        if (recompressQuality > 0 && !(done & ProbeRecompress) && !splitArchivePath(filePath)) {
+            QElapsedTimer recompressTimer;
+            recompressTimer.start();
+            estimateRecompression(filePath, recompressQuality, info.recompress);
+            timings[ScanStage::Recompress] = recompressTimer.nsecsElapsed();
+        }
+        // ImageCorrupt ставят только проверка и отметка о сбое воркера
+        if (info.flags & ImageCorrupt) corruptFiles.fetch_add(1);
+        addRecompress(info);
+        if (collectDuplicates && (info.flags & ImageHashed)) {
+            QMutexLocker locker(&hashMutex);
+            hashedPaths.append(filePath);
+            perceptualHashes.append(info.perceptualHash);
+            contentHashes.append(info.contentHash);
+        }
+        writer.write(filePath, info);
+        stats.addFile(info.format, timings);
+    };
+
+    // Разбор в процессе-воркере потока; упавший или зависший файл пишется с отметкой
+    // о сбое, а все задачи считаются выполненными - повторять их в своём процессе нельзя
+    auto probeIsolated = [&](const QString &filePath) {
+        // Свой воркер на каждый поток пула - живёт, пока жив поток
+        thread_local ProbeProcess worker(probeTimeoutMs);
+        ProbeRequest request;
+        request.filePath = filePath;
+        request.tasks = ProbeHeader | (hashing ? ProbeHash : 0) | (verify ? ProbeVerify : 0)
+                        | (colors ? ProbeColors : 0) | (recompressQuality > 0 ? ProbeRecompress : 0);
+        request.recompressQuality = recompressQuality;
+        StageTimings timings;
+        ImageInfo info;
+        ProbeProcess::Outcome outcome = worker.run(request, info, timings);
+        if (outcome == ProbeProcess::Unavailable) {
+            info = getImageInfo(filePath, &timings);
+            finishFile(filePath, info, timings);
+            return;
+        }
+        if (outcome != ProbeProcess::Done) {
+            markProbeFailure(filePath, info, outcome);
+            workerRestarts.fetch_add(1);
+            QMutexLocker locker(&failureMutex);
+            probeFailures.append(filePath + " - " + probeOutcomeName(outcome));
+        }
+        finishFile(filePath, info, timings, request.tasks);
+    };
+
+    // С --io начало файлов читается заранее большой очередью, а разбор
+    // заголовков идёт в пуле по мере готовности буферов
+    std::unique_ptr<HeaderPrefetcher> prefetcher;
+    if (prefetch && !isolate) {
+        int depth = qMax(1, parser.value(ioDepthOption).toInt());
+        if (queueLimit < depth) inFlight.release(depth - queueLimit);  // иначе очередь не заполнится
+        prefetcher = std::make_unique<HeaderPrefetcher>(ioBackend, [&](PrefetchedHeader &&header) {
+            pool.start([&, header = std::move(header)]() {
+                StageTimings timings;
+                ImageInfo info = getImageInfoFromHeader(header, &timings);
+                finishFile(header.filePath, info, timings);
+                inFlight.release();
+            });
+        }, depth);
+        std::fprintf(stderr, "Предварительное чтение: %s, глубина %d\n",
+                     qPrintable(prefetchBackendName(prefetcher->backend())), depth);
+    }
+
+    // Обход и разбор идут одновременно: найденный файл сразу уходит в пул
+    QStringList nameFilters = supportedImageNameFilters();
+    if (parser.isSet(archivesOption)) nameFilters += archiveNameFilters();
+    DirWalker walker(nameFilters, qMax(1, parser.value(walkersOption).toInt()));
+    walker.setStats(&stats);
+    auto submitFile = [&](const QString &filePath) {
+        inFlight.acquire();
+        if (isArchiveFile(filePath)) {
+            // Архив открывается один раз, его изображения пишутся как записи "архив!/член"
+            pool.start([&, filePath]() {
+                scanArchiveImages(filePath, finishFile);
+                inFlight.release();
+            });
+            return true;
+        }
+        if (prefetcher) {
+            prefetcher->submit(filePath);
+            return true;
+        }
+        if (isolate) {
+            pool.start([&, filePath]() {
+                probeIsolated(filePath);
+                inFlight.release();
+            });
+            return true;
+        }
+        pool.start([&, filePath]() {
+            StageTimings timings;
+            ImageInfo info = getImageInfo(filePath, &timings);
+            finishFile(filePath, info, timings);
+            inFlight.release();
+        });
+        return true;
+    };
+
+    if (order == ScanOrder::Walk) {
+        walker.walk(args.first(), submitFile);
+    } else {
+        // Сначала весь список, затем разбор по положению файлов на диске:
+        // на вращающихся носителях головка идёт почти подряд вместо случайных переходов
+        QMutex listMutex;
+        QStringList found;
+        walker.walk(args.first(), [&](const QString &filePath) {
+            QMutexLocker locker(&listMutex);
+            found.append(filePath);
+            return true;
+        });
+        QStringList images, archiveFiles;
+        for (const QString &filePath : std::as_const(found))
+            (isArchiveFile(filePath) ? archiveFiles : images).append(filePath);
+
+        if (parser.isSet(compareOrdersOption)) {
+            qint64 walkMs = measureColdHeaderScan(images, threads);
+            stats.addColdScan(scanOrderName(ScanOrder::Walk), walkMs);
+            std::fprintf(stderr, "Холодный разбор заголовков, порядок walk: %lld мс\n", static_cast<long long>(walkMs));
+        }
+        QElapsedTimer sortTimer;
+        sortTimer.start();
+        sortByDiskOrder(images, order);
+        stats.setScanOrder(scanOrderName(order), sortTimer.elapsed());
+        std::fprintf(stderr, "Порядок разбора: %s, сортировка %lld файлов за %lld мс\n",
+                     qPrintable(scanOrderName(order)), static_cast<long long>(images.size()),
+                     static_cast<long long>(sortTimer.elapsed()));
+        if (parser.isSet(compareOrdersOption)) {
+            qint64 sortedMs = measureColdHeaderScan(images, threads);
+            stats.addColdScan(scanOrderName(order), sortedMs);
+            std::fprintf(stderr, "Холодный разбор заголовков, порядок %s: %lld мс\n",
+                         qPrintable(scanOrderName(order)), static_cast<long long>(sortedMs));
+        }
+
+        for (const QString &filePath : std::as_const(images)) submitFile(filePath);
+        for (const QString &filePath : std::as_const(archiveFiles)) submitFile(filePath);
+    }
+
+    if (prefetcher) prefetcher->finish();
+    pool.waitForDone();
+    stats.setWallTime(timer.elapsed());
+
+    if (collectDuplicates) {
+        QVector<bool> hashed(hashedPaths.size(), true);
+        QVector<DuplicateGroup> groups = findDuplicateGroups(perceptualHashes, contentHashes, hashed, 6, threads);
+
+        QJsonArray groupsJson;
+        for (const DuplicateGroup &group : std::as_const(groups)) {
+            QJsonArray members;
+            for (int i : group.members) members.append(hashedPaths[i]);
+            QJsonObject g;
+            g["exact"] = group.exact;
+            g["maxDistance"] = group.maxDistance;
+            g["files"] = members;
+            groupsJson.append(g);
+        }
+        QFile duplicatesFile(parser.value(duplicatesOption));
+        if (duplicatesFile.open(QIODevice::WriteOnly))
+            duplicatesFile.write(QJsonDocument(groupsJson).toJson());
+        else
+            std::fprintf(stderr, "Не удалось записать дубликаты: %s\n", qPrintable(duplicatesFile.errorString()));
+        std::fprintf(stderr, "Групп дубликатов: %lld\n", static_cast<long long>(groups.size()));
+    }
+
+    if (parser.isSet(statsOption)) {
+        QFile statsFile(parser.value(statsOption));
+        if (statsFile.open(QIODevice::WriteOnly))
+            statsFile.write(QJsonDocument(stats.toJson()).toJson());
+        else
+            std::fprintf(stderr, "Не удалось записать статистику: %s\n", qPrintable(statsFile.errorString()));
+    }
+
+    std::fprintf(stderr, "Обработано %lld файлов за %lld мс (%d потоков)\n",
+                 static_cast<long long>(writer.recordCount()),
+                 static_cast<long long>(timer.elapsed()), threads);
+    if (verify) std::fprintf(stderr, "Повреждённых файлов: %lld\n", static_cast<long long>(corruptFiles.load()));
+    if (isolate) {
+        std::fprintf(stderr, "Перезапусков воркеров: %d\n", workerRestarts.load());
+        for (const QString &failure : std::as_const(probeFailures))
+            std::fprintf(stderr, "  %s\n", qPrintable(failure));
+    }
+    if (recompressFiles > 0) {
+        std::fprintf(stderr, "Оценка пересжатия, файлов: %lld, сейчас %.1f МБ\n",
+                     static_cast<long long>(recompressFiles), recompressCurrent / 1048576.0);
+        for (int target = 0; target < RecompressTargetCount; ++target) {
+            if (recompressCurrentFor[target] <= 0) continue;
+            std::fprintf(stderr, "  %s: %.1f МБ (%.1f%% от текущего)\n",
+                         qPrintable(recompressTargetName(static_cast<RecompressTarget>(target), recompressQuality)),
+                         recompressTotals[target] / 1048576.0,
+                         recompressTotals[target] * 100.0 / recompressCurrentFor[target]);
+        }
+    }
+    if (int sets = writer.quantTableSetCount())
+        std::fprintf(stderr, "Различных наборов таблиц квантования JPEG: %d\n", sets);
+    return 0;
+}